@@ -0,0 +1,152 @@
+/*
+ * Copyright (c) 2015 Tim Ruffing <tim.ruffing@mmci.uni-saarland.de>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#include "anyauthenticator.h"
+#include "wire.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+class AnyAuthenticator::Impl
+{
+public:
+    virtual ~Impl() { }
+    virtual size_t getCtLen() const = 0;
+    virtual void authenticate(token_t& t, const ct_t& ct, const st_t& st) const = 0;
+    virtual bool verify(const token_t& t, const ct_t& ct, const st_t& st) const = 0;
+    virtual void extract(const token_t& t1, const token_t& t2, const ct_t& ct, const st_t& st1, const st_t& st2) = 0;
+    virtual dpk_t getDpk() const = 0;
+    virtual dsk_t getDsk() const = 0;
+};
+
+template<size_t CtLen>
+class AnyAuthenticator::ImplFor : public AnyAuthenticator::Impl
+{
+public:
+    ImplFor(const dsk_t& dsk) : acca(dsk) { }
+    ImplFor(const dpk_t& dpk, bool precomputePk) : acca(dpk, precomputePk) { }
+
+    size_t getCtLen() const {
+        return CtLen;
+    }
+
+    void authenticate(token_t& t, const ct_t& ct, const st_t& st) const {
+        typename Acca::token_t token;
+        acca.authenticate(token, toCt(ct), st);
+        t = BasicWire<CtLen>::encodeToken(token);
+    }
+
+    bool verify(const token_t& t, const ct_t& ct, const st_t& st) const {
+        return acca.verify(BasicTokenView<CtLen>(t.data(), t.size()), toCt(ct), st);
+    }
+
+    void extract(const token_t& t1, const token_t& t2, const ct_t& ct, const st_t& st1, const st_t& st2) {
+        acca.extract(BasicTokenView<CtLen>(t1.data(), t1.size()), BasicTokenView<CtLen>(t2.data(), t2.size()), toCt(ct), st1, st2);
+    }
+
+    dpk_t getDpk() const {
+        return acca.getDpk();
+    }
+
+    dsk_t getDsk() const {
+        return acca.getDsk();
+    }
+
+private:
+    typedef BasicAuthenticator<CtLen> Acca;
+    Acca acca;
+
+    static typename Acca::ct_t toCt(const ct_t& ct) {
+        if (ct.size() != CtLen) {
+            throw std::invalid_argument("context has the wrong length");
+        }
+        typename Acca::ct_t res;
+        std::copy(ct.begin(), ct.end(), res.begin());
+        return res;
+    }
+};
+
+template<typename... Args>
+std::unique_ptr<AnyAuthenticator::Impl> AnyAuthenticator::create(size_t ctLen, const Args&... args)
+{
+    switch (ctLen) {
+#define CASE(n) case n: return std::unique_ptr<Impl>(new ImplFor<n>(args...));
+    ACCA_FOR_EACH_CT_LEN(CASE)
+#undef CASE
+    default:
+        throw std::invalid_argument("unsupported context length");
+    }
+}
+
+AnyAuthenticator::AnyAuthenticator(const dsk_t& dsk, size_t ctLen) : impl(create(ctLen, dsk)) { }
+
+AnyAuthenticator::AnyAuthenticator(const dpk_t& dpk) : AnyAuthenticator(dpk, false) { }
+
+AnyAuthenticator::AnyAuthenticator(const dpk_t& dpk, bool precomputePk) : impl(create(dpk.ctLen, dpk, precomputePk)) { }
+
+AnyAuthenticator::~AnyAuthenticator() { }
+
+bool AnyAuthenticator::supports(size_t ctLen)
+{
+    switch (ctLen) {
+#define CASE(n) case n: return true;
+    ACCA_FOR_EACH_CT_LEN(CASE)
+#undef CASE
+    default:
+        return false;
+    }
+}
+
+size_t AnyAuthenticator::getCtLen() const
+{
+    return impl->getCtLen();
+}
+
+void AnyAuthenticator::authenticate(token_t& t, const ct_t& ct, const st_t& st) const
+{
+    impl->authenticate(t, ct, st);
+}
+
+bool AnyAuthenticator::verify(const token_t& t, const ct_t& ct, const st_t& st) const
+{
+    return impl->verify(t, ct, st);
+}
+
+void AnyAuthenticator::extract(const token_t& t1, const token_t& t2, const ct_t& ct, const st_t& st1, const st_t& st2)
+{
+    impl->extract(t1, t2, ct, st1, st2);
+}
+
+AnyAuthenticator::dpk_t AnyAuthenticator::getDpk() const
+{
+    return impl->getDpk();
+}
+
+AnyAuthenticator::dsk_t AnyAuthenticator::getDsk() const
+{
+    return impl->getDsk();
+}
@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2015 Tim Ruffing <tim.ruffing@mmci.uni-saarland.de>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#ifndef ANYAUTHENTICATOR_H
+#define ANYAUTHENTICATOR_H
+
+#include "authenticator.h"
+
+#include <memory>
+#include <vector>
+
+// Authenticator for keys whose context length is only known at runtime, e.g., in a
+// verifier that serves keys of several lengths. All operations are dispatched once to
+// the BasicAuthenticator for the length of the key, so the loops over the levels of the
+// tree run with the depth fixed at compile time. See contextlength.h for the supported
+// lengths.
+//
+// Contexts must have the length of the key, and tokens are in the encoding of BasicWire.
+// Functions throw std::invalid_argument if a context has the wrong length or a token is
+// not a valid encoding for the length of the key.
+class AnyAuthenticator
+{
+public:
+    typedef std::vector<unsigned char> ct_t;
+    typedef std::vector<unsigned char> st_t;
+    typedef std::vector<unsigned char> token_t;
+
+    typedef ChameleonHash::sk_t dsk_t;
+    typedef AuthenticatorDpk dpk_t;
+
+    // Throws std::invalid_argument if ctLen is not supported.
+    AnyAuthenticator(const dsk_t& dsk, size_t ctLen);
+    AnyAuthenticator(const dpk_t& dpk);
+    AnyAuthenticator(const dpk_t& dpk, bool precomputePk);
+    ~AnyAuthenticator();
+
+    static bool supports(size_t ctLen);
+    size_t getCtLen() const;
+
+    void authenticate(token_t& t, const ct_t& ct, const st_t& st) const;
+    bool verify(const token_t& t, const ct_t& ct, const st_t& st) const;
+    void extract(const token_t& t1, const token_t& t2, const ct_t& ct, const st_t& st1, const st_t& st2);
+
+    dpk_t getDpk() const;
+    dsk_t getDsk() const;
+
+private:
+    class Impl;
+    template<size_t CtLen> class ImplFor;
+    std::unique_ptr<Impl> impl;
+
+    template<typename... Args>
+    static std::unique_ptr<Impl> create(size_t ctLen, const Args&... args);
+};
+
+#endif // ANYAUTHENTICATOR_H
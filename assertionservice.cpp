@@ -0,0 +1,689 @@
+/*
+ * Copyright (c) 2015 Tim Ruffing <tim.ruffing@mmci.uni-saarland.de>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#include "assertionservice.h"
+#include "equivocationstore.h"
+#include "keyregistry.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+typedef AssertionProtocol::bytes_t bytes_t;
+
+namespace {
+
+std::runtime_error systemError(const std::string& what)
+{
+    return std::runtime_error(what + ": " + strerror(errno));
+}
+
+void putU16(bytes_t& out, uint16_t v)
+{
+    out.push_back(v >> 8);
+    out.push_back(v);
+}
+
+void setU32(unsigned char* out, uint32_t v)
+{
+    out[0] = v >> 24;
+    out[1] = v >> 16;
+    out[2] = v >> 8;
+    out[3] = v;
+}
+
+void putU32(bytes_t& out, uint32_t v)
+{
+    out.resize(out.size() + 4);
+    setU32(&out[out.size() - 4], v);
+}
+
+uint32_t getU32(const unsigned char* in)
+{
+    return ((uint32_t) in[0] << 24) | ((uint32_t) in[1] << 16) | ((uint32_t) in[2] << 8) | in[3];
+}
+
+template<typename Container>
+void append(bytes_t& out, const Container& c)
+{
+    out.insert(out.end(), c.begin(), c.end());
+}
+
+// The length of the frame is filled in by endFrame().
+bytes_t beginFrame(uint8_t code, uint32_t id)
+{
+    bytes_t frame(AssertionProtocol::HEADER_LEN);
+    frame[4] = code;
+    setU32(&frame[5], id);
+    return frame;
+}
+
+void endFrame(bytes_t& frame)
+{
+    setU32(frame.data(), frame.size() - 4);
+}
+
+sockaddr_un address(const std::string& path)
+{
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    if (path.size() >= sizeof(addr.sun_path)) {
+        throw std::invalid_argument("socket path too long");
+    }
+    addr.sun_family = AF_UNIX;
+    memcpy(addr.sun_path, path.c_str(), path.size());
+    return addr;
+}
+
+// Reads the fields of a payload front to back.
+class Reader
+{
+public:
+    Reader(const bytes_t& b) : p(b.data()), end(b.data() + b.size()) { }
+
+    // Throws std::invalid_argument if the payload is too short.
+    const unsigned char* take(size_t n) {
+        if ((size_t) (end - p) < n) {
+            throw std::invalid_argument("truncated request");
+        }
+        const unsigned char* res = p;
+        p += n;
+        return res;
+    }
+
+    uint16_t u16() {
+        const unsigned char* in = take(2);
+        return (in[0] << 8) | in[1];
+    }
+
+    uint32_t u32() {
+        return getU32(take(4));
+    }
+
+    Authenticator::ct_t ct() {
+        Authenticator::ct_t res;
+        std::copy_n(take(res.size()), res.size(), res.begin());
+        return res;
+    }
+
+    Authenticator::dpk_t dpk() {
+        Authenticator::dpk_t res;
+        Wire::decodeDpk(res, take(Wire::DPK_LEN), Wire::DPK_LEN);
+        return res;
+    }
+
+    TokenView token() {
+        return TokenView(take(Wire::TOKEN_LEN), Wire::TOKEN_LEN);
+    }
+
+    // Statements are digested in place rather than copied out of the payload.
+    ChameleonHash::digest_t statement(size_t n) {
+        ChameleonHash::digest_t res;
+        const unsigned char* in = take(n);
+        ChameleonHash::digest(res, in, n);
+        return res;
+    }
+
+    ChameleonHash::digest_t rest() {
+        return statement(end - p);
+    }
+
+private:
+    const unsigned char* p;
+    const unsigned char* end;
+};
+
+const char* const OPCODE_NAMES[AssertionProtocol::OPCODES] = { "get_dpk", "authenticate", "verify", "extract", "stats" };
+
+}
+
+bytes_t AssertionProtocol::getDpkRequest(uint32_t id, uint16_t key)
+{
+    bytes_t frame = beginFrame(GET_DPK, id);
+    putU16(frame, key);
+    endFrame(frame);
+    return frame;
+}
+
+bytes_t AssertionProtocol::authenticateRequest(uint32_t id, uint16_t key, const Authenticator::ct_t& ct, const Authenticator::st_t& st)
+{
+    bytes_t frame = beginFrame(AUTHENTICATE, id);
+    putU16(frame, key);
+    append(frame, ct);
+    append(frame, st);
+    endFrame(frame);
+    return frame;
+}
+
+bytes_t AssertionProtocol::verifyRequest(uint32_t id, const Authenticator::dpk_t& dpk, const Authenticator::ct_t& ct, const Authenticator::token_t& t, const Authenticator::st_t& st)
+{
+    bytes_t frame = beginFrame(VERIFY, id);
+    append(frame, Wire::encodeDpk(dpk));
+    append(frame, ct);
+    append(frame, Wire::encodeToken(t));
+    append(frame, st);
+    endFrame(frame);
+    return frame;
+}
+
+bytes_t AssertionProtocol::extractRequest(uint32_t id, const Authenticator::dpk_t& dpk, const Authenticator::ct_t& ct, const Authenticator::token_t& t1, const Authenticator::token_t& t2,
+                                          const Authenticator::st_t& st1, const Authenticator::st_t& st2)
+{
+    bytes_t frame = beginFrame(EXTRACT, id);
+    append(frame, Wire::encodeDpk(dpk));
+    append(frame, ct);
+    append(frame, Wire::encodeToken(t1));
+    append(frame, Wire::encodeToken(t2));
+    putU32(frame, st1.size());
+    append(frame, st1);
+    append(frame, st2);
+    endFrame(frame);
+    return frame;
+}
+
+bytes_t AssertionProtocol::statsRequest(uint32_t id)
+{
+    bytes_t frame = beginFrame(STATS, id);
+    endFrame(frame);
+    return frame;
+}
+
+struct AssertionServer::connection_t {
+    int fd;
+    // only accessed by the event loop
+    bytes_t in;
+    bool reading;
+    bool writing;
+    // the peer has shut down its side, the connection is closed when all responses are sent
+    bool halfClosed;
+
+    // protects out, pending and closed
+    std::mutex mutex;
+    bytes_t out;
+    // requests without a response yet
+    size_t pending;
+    bool closed;
+
+    connection_t(int fd) : fd(fd), reading(true), writing(false), halfClosed(false), pending(0), closed(false) { }
+};
+
+struct AssertionServer::job_t {
+    std::shared_ptr<connection_t> conn;
+    AssertionProtocol::opcode_t op;
+    uint32_t id;
+    bytes_t payload;
+    std::chrono::steady_clock::time_point arrival;
+};
+
+AssertionServer::AssertionServer(const std::string& path, std::vector<std::shared_ptr<const Authenticator>> signers, KeyRegistry& verifiers, EquivocationStore& issued,
+                                 const config_t& config)
+    : path(path), signers(std::move(signers)), verifiers(verifiers), issued(issued), outputHighWater(config.outputHighWater), listenFd(-1), epollFd(-1), eventFd(-1), stopping(false), jobs(config.queueCapacity)
+{
+    for (const auto& signer : this->signers) {
+        dpks.push_back(signer->getDpk());
+    }
+
+    sockaddr_un addr = address(path);
+    try {
+        listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (listenFd < 0) {
+            throw systemError("cannot create socket");
+        }
+        unlink(path.c_str());
+        if (bind(listenFd, (sockaddr*) &addr, sizeof(addr)) < 0) {
+            throw systemError("cannot bind " + path);
+        }
+        if (listen(listenFd, SOMAXCONN) < 0) {
+            throw systemError("cannot listen on " + path);
+        }
+        epollFd = epoll_create1(EPOLL_CLOEXEC);
+        eventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (epollFd < 0 || eventFd < 0) {
+            throw systemError("cannot create event loop");
+        }
+        for (int fd : { listenFd, eventFd }) {
+            epoll_event ev;
+            ev.events = EPOLLIN;
+            ev.data.fd = fd;
+            if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+                throw systemError("cannot register with event loop");
+            }
+        }
+    } catch (...) {
+        for (int fd : { listenFd, epollFd, eventFd }) {
+            if (fd >= 0) {
+                close(fd);
+            }
+        }
+        throw;
+    }
+
+    unsigned n = config.workers ? config.workers : std::max(std::thread::hardware_concurrency(), 1u);
+    for (unsigned i = 0; i < n; i++) {
+        workers.emplace_back(&AssertionServer::worker, this);
+    }
+    loop = std::thread(&AssertionServer::eventLoop, this);
+}
+
+AssertionServer::~AssertionServer()
+{
+    stopping = true;
+    uint64_t one = 1;
+    if (write(eventFd, &one, sizeof(one)) < 0) {
+        // the counter is non-zero anyway
+    }
+    loop.join();
+    jobs.close();
+    for (auto& thread : workers) {
+        thread.join();
+    }
+    close(listenFd);
+    close(epollFd);
+    close(eventFd);
+    unlink(path.c_str());
+}
+
+std::string AssertionServer::getStatsJson() const
+{
+    std::ostringstream out;
+    out << "{";
+    for (size_t op = 0; op < AssertionProtocol::OPCODES; op++) {
+        const LatencyHistogram& h = latencies[op];
+        out << (op ? ", " : "") << "\"" << OPCODE_NAMES[op] << "\": {"
+            << "\"count\": " << h.count()
+            << ", \"p50_ns\": " << h.quantile(0.5)
+            << ", \"p90_ns\": " << h.quantile(0.9)
+            << ", \"p99_ns\": " << h.quantile(0.99)
+            << ", \"p999_ns\": " << h.quantile(0.999)
+            << ", \"max_ns\": " << h.max() << "}";
+    }
+    out << "}";
+    return out.str();
+}
+
+void AssertionServer::eventLoop()
+{
+    std::unordered_map<int, std::shared_ptr<connection_t>> conns;
+
+    auto closeConnection = [&](const std::shared_ptr<connection_t>& conn) {
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, conn->fd, nullptr);
+        {
+            std::lock_guard<std::mutex> lock(conn->mutex);
+            conn->closed = true;
+            conn->out.clear();
+        }
+        close(conn->fd);
+        conns.erase(conn->fd);
+    };
+
+    // returns false if the connection has been closed
+    auto flush = [&](const std::shared_ptr<connection_t>& conn) {
+        std::unique_lock<std::mutex> lock(conn->mutex);
+        size_t sent = 0;
+        while (sent < conn->out.size()) {
+            ssize_t n = ::send(conn->fd, conn->out.data() + sent, conn->out.size() - sent, MSG_NOSIGNAL);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                    break;
+                }
+                lock.unlock();
+                closeConnection(conn);
+                return false;
+            }
+            sent += n;
+        }
+        conn->out.erase(conn->out.begin(), conn->out.begin() + sent);
+        size_t outSize = conn->out.size();
+        size_t pending = conn->pending;
+        lock.unlock();
+
+        if (conn->halfClosed && outSize == 0 && pending == 0) {
+            closeConnection(conn);
+            return false;
+        }
+        // Stop reading while the client does not keep up with the responses, so that
+        // out does not grow without bound.
+        bool reading = !conn->halfClosed && outSize <= outputHighWater;
+        bool writing = outSize > 0;
+        if (reading != conn->reading || writing != conn->writing) {
+            epoll_event ev;
+            ev.events = (reading ? (uint32_t) (EPOLLIN | EPOLLRDHUP) : 0u) | (writing ? (uint32_t) EPOLLOUT : 0u);
+            ev.data.fd = conn->fd;
+            epoll_ctl(epollFd, EPOLL_CTL_MOD, conn->fd, &ev);
+            conn->reading = reading;
+            conn->writing = writing;
+        }
+        return true;
+    };
+
+    // returns false if the connection has been closed
+    auto receive = [&](const std::shared_ptr<connection_t>& conn) {
+        unsigned char buf[65536];
+        for (;;) {
+            ssize_t n = recv(conn->fd, buf, sizeof(buf), 0);
+            if (n > 0) {
+                conn->in.insert(conn->in.end(), buf, buf + n);
+                continue;
+            }
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                break;
+            }
+            if (n == 0) {
+                // the requests received so far are still answered
+                conn->halfClosed = true;
+                break;
+            }
+            closeConnection(conn);
+            return false;
+        }
+
+        size_t pos = 0;
+        bytes_t& in = conn->in;
+        while (in.size() - pos >= 4) {
+            uint32_t len = getU32(&in[pos]);
+            if (len < AssertionProtocol::HEADER_LEN - 4 || len > AssertionProtocol::MAX_FRAME_LEN) {
+                // the stream cannot be resynchronized
+                closeConnection(conn);
+                return false;
+            }
+            if (in.size() - pos - 4 < len) {
+                break;
+            }
+            job_ptr job(new job_t);
+            job->conn = conn;
+            job->op = (AssertionProtocol::opcode_t) in[pos + 4];
+            job->id = getU32(&in[pos + 5]);
+            job->payload.assign(in.begin() + pos + AssertionProtocol::HEADER_LEN, in.begin() + pos + 4 + len);
+            job->arrival = std::chrono::steady_clock::now();
+            {
+                std::lock_guard<std::mutex> lock(conn->mutex);
+                conn->pending++;
+            }
+            // blocks if the workers fall behind
+            jobs.push(job);
+            pos += 4 + len;
+        }
+        in.erase(in.begin(), in.begin() + pos);
+        return true;
+    };
+
+    epoll_event events[64];
+    while (!stopping) {
+        int n = epoll_wait(epollFd, events, 64, -1);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        for (int i = 0; i < n; i++) {
+            int fd = events[i].data.fd;
+            if (fd == listenFd) {
+                int client;
+                while ((client = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+                    epoll_event ev;
+                    ev.events = EPOLLIN | EPOLLRDHUP;
+                    ev.data.fd = client;
+                    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, client, &ev) < 0) {
+                        close(client);
+                        continue;
+                    }
+                    conns[client] = std::make_shared<connection_t>(client);
+                }
+            } else if (fd == eventFd) {
+                uint64_t count;
+                if (read(eventFd, &count, sizeof(count)) < 0) {
+                    // spurious wakeup
+                }
+                std::vector<std::shared_ptr<connection_t>> readyConns;
+                {
+                    std::lock_guard<std::mutex> lock(readyMutex);
+                    readyConns.swap(ready);
+                }
+                for (auto& conn : readyConns) {
+                    if (!conn->closed) {
+                        flush(conn);
+                    }
+                }
+            } else {
+                auto it = conns.find(fd);
+                if (it == conns.end()) {
+                    continue;
+                }
+                std::shared_ptr<connection_t> conn = it->second;
+                if ((events[i].events & (EPOLLIN | EPOLLRDHUP)) && !receive(conn)) {
+                    continue;
+                }
+                if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+                    closeConnection(conn);
+                    continue;
+                }
+                // also updates the events after receiving
+                flush(conn);
+            }
+        }
+    }
+
+    while (!conns.empty()) {
+        closeConnection(conns.begin()->second);
+    }
+}
+
+void AssertionServer::worker()
+{
+    job_ptr job;
+    while (jobs.pop(job)) {
+        bytes_t payload;
+        AssertionProtocol::status_t status;
+        try {
+            status = handle(*job, payload);
+        } catch (const std::invalid_argument&) {
+            status = AssertionProtocol::BAD_REQUEST;
+            payload.clear();
+        } catch (const std::exception&) {
+            status = AssertionProtocol::INTERNAL_ERROR;
+            payload.clear();
+        }
+        respond(*job, status, payload);
+        job.reset();
+    }
+}
+
+AssertionProtocol::status_t AssertionServer::handle(job_t& job, bytes_t& payload)
+{
+    Reader r(job.payload);
+    switch (job.op) {
+    case AssertionProtocol::GET_DPK:
+    case AssertionProtocol::AUTHENTICATE: {
+        uint16_t key = r.u16();
+        if (key >= signers.size()) {
+            return AssertionProtocol::UNKNOWN_KEY;
+        }
+        if (job.op == AssertionProtocol::GET_DPK) {
+            payload = Wire::encodeDpk(dpks[key]);
+            return AssertionProtocol::OK;
+        }
+        Authenticator::ct_t ct = r.ct();
+        ChameleonHash::digest_t stDigest = r.rest();
+        Authenticator::token_t t;
+        signers[key]->authenticate(t, ct, stDigest);
+        bytes_t token(Wire::TOKEN_LEN);
+        Wire::encodeToken(token.data(), t);
+        // The token is recorded on disk before it is released. It is only discarded if a
+        // token for a different statement has been issued, which the store checks atomically.
+        ChameleonHash::digest_t otherDigest;
+        bytes_t other;
+        if (issued.detectVerified(otherDigest, other, dpks[key], ct, stDigest, TokenView(token.data(), token.size()))) {
+            return AssertionProtocol::EQUIVOCATION;
+        }
+        // also if the same token was recorded by another worker that has not synced yet,
+        // concurrent workers share the write-back
+        issued.sync();
+        payload.swap(token);
+        return AssertionProtocol::OK;
+    }
+    case AssertionProtocol::VERIFY: {
+        Authenticator::dpk_t dpk = r.dpk();
+        Authenticator::ct_t ct = r.ct();
+        TokenView t = r.token();
+        std::shared_ptr<const Authenticator> verifier = verifiers.get(dpk);
+        payload.push_back(verifier->verify(t, ct, r.rest()));
+        return AssertionProtocol::OK;
+    }
+    case AssertionProtocol::EXTRACT: {
+        Authenticator::dpk_t dpk = r.dpk();
+        Authenticator::ct_t ct = r.ct();
+        TokenView t1 = r.token();
+        TokenView t2 = r.token();
+        ChameleonHash::digest_t d1 = r.statement(r.u32());
+        ChameleonHash::digest_t d2 = r.rest();
+        Authenticator acca(dpk);
+        try {
+            acca.extract(t1, t2, ct, d1, d2);
+        } catch (const std::invalid_argument&) {
+            return AssertionProtocol::NOT_EXTRACTABLE;
+        }
+        Authenticator::dsk_t dsk = acca.getDsk();
+        payload.assign(dsk.begin(), dsk.end());
+        return AssertionProtocol::OK;
+    }
+    case AssertionProtocol::STATS: {
+        std::string json = getStatsJson();
+        payload.assign(json.begin(), json.end());
+        return AssertionProtocol::OK;
+    }
+    default:
+        return AssertionProtocol::BAD_REQUEST;
+    }
+}
+
+void AssertionServer::respond(job_t& job, AssertionProtocol::status_t status, const bytes_t& payload)
+{
+    bytes_t frame = beginFrame(status, job.id);
+    append(frame, payload);
+    endFrame(frame);
+
+    if (job.op < AssertionProtocol::OPCODES) {
+        uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - job.arrival).count();
+        latencies[job.op].record(ns);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(job.conn->mutex);
+        job.conn->pending--;
+        if (job.conn->closed) {
+            return;
+        }
+        append(job.conn->out, frame);
+    }
+    {
+        std::lock_guard<std::mutex> lock(readyMutex);
+        ready.push_back(job.conn);
+    }
+    uint64_t one = 1;
+    if (write(eventFd, &one, sizeof(one)) < 0) {
+        // the counter is non-zero anyway
+    }
+}
+
+AssertionClient::AssertionClient(const std::string& path)
+{
+    sockaddr_un addr = address(path);
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        throw systemError("cannot create socket");
+    }
+    if (connect(fd, (sockaddr*) &addr, sizeof(addr)) < 0) {
+        std::runtime_error e = systemError("cannot connect to " + path);
+        close(fd);
+        throw e;
+    }
+}
+
+AssertionClient::~AssertionClient()
+{
+    close(fd);
+}
+
+void AssertionClient::send(const bytes_t& request)
+{
+    size_t sent = 0;
+    while (sent < request.size()) {
+        ssize_t n = ::send(fd, request.data() + sent, request.size() - sent, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw systemError("cannot send request");
+        }
+        sent += n;
+    }
+}
+
+void AssertionClient::receive(AssertionProtocol::response_t& response)
+{
+    unsigned char buf[65536];
+    for (;;) {
+        if (in.size() >= AssertionProtocol::HEADER_LEN) {
+            uint32_t len = getU32(in.data());
+            if (len < AssertionProtocol::HEADER_LEN - 4) {
+                throw std::runtime_error("malformed response");
+            }
+            if (in.size() >= 4 + len) {
+                response.status = (AssertionProtocol::status_t) in[4];
+                response.id = getU32(&in[5]);
+                response.payload.assign(in.begin() + AssertionProtocol::HEADER_LEN, in.begin() + 4 + len);
+                in.erase(in.begin(), in.begin() + 4 + len);
+                return;
+            }
+        }
+        ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            throw n == 0 ? std::runtime_error("connection closed by server") : systemError("cannot receive response");
+        }
+        in.insert(in.end(), buf, buf + n);
+    }
+}
@@ -0,0 +1,177 @@
+/*
+ * Copyright (c) 2015 Tim Ruffing <tim.ruffing@mmci.uni-saarland.de>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#ifndef ASSERTIONSERVICE_H
+#define ASSERTIONSERVICE_H
+
+#include "authenticator.h"
+#include "boundedqueue.h"
+#include "latencyhistogram.h"
+#include "wire.h"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class EquivocationStore;
+class KeyRegistry;
+
+// Binary protocol of the assertion service over a stream socket. Requests and responses
+// are frames of the form
+//  - length of the rest of the frame (4 bytes, big-endian),
+//  - opcode (requests) or status (responses), 1 byte,
+//  - request id chosen by the client (4 bytes), which is echoed in the response,
+//  - payload.
+// Clients may pipeline requests; responses can arrive in any order. The payloads are
+//  - GET_DPK: key index (2 bytes) -> encoded dpk,
+//  - AUTHENTICATE: key index (2 bytes), ct, st -> encoded token, or status EQUIVOCATION
+//    if a token for a different statement in ct has been issued under the key before,
+//  - VERIFY: encoded dpk, ct, encoded token, st -> 1 byte (1 iff valid),
+//  - EXTRACT: encoded dpk, ct, two encoded tokens, length of st1 (4 bytes), st1, st2 -> dsk,
+//  - STATS: empty -> latency histograms as JSON.
+// Keys are encoded with Wire, and ct is CT_LEN bytes long.
+struct AssertionProtocol
+{
+    enum opcode_t : uint8_t { GET_DPK, AUTHENTICATE, VERIFY, EXTRACT, STATS, OPCODES };
+    enum status_t : uint8_t { OK, BAD_REQUEST, UNKNOWN_KEY, NOT_EXTRACTABLE, INTERNAL_ERROR, EQUIVOCATION };
+
+    static const size_t HEADER_LEN = 9;
+    static const size_t MAX_FRAME_LEN = 1 << 20;
+
+    typedef std::vector<unsigned char> bytes_t;
+
+    struct response_t {
+        uint32_t id;
+        status_t status;
+        bytes_t payload;
+    };
+
+    static bytes_t getDpkRequest(uint32_t id, uint16_t key);
+    static bytes_t authenticateRequest(uint32_t id, uint16_t key, const Authenticator::ct_t& ct, const Authenticator::st_t& st);
+    static bytes_t verifyRequest(uint32_t id, const Authenticator::dpk_t& dpk, const Authenticator::ct_t& ct, const Authenticator::token_t& t, const Authenticator::st_t& st);
+    static bytes_t extractRequest(uint32_t id, const Authenticator::dpk_t& dpk, const Authenticator::ct_t& ct, const Authenticator::token_t& t1, const Authenticator::token_t& t2,
+                                  const Authenticator::st_t& st1, const Authenticator::st_t& st2);
+    static bytes_t statsRequest(uint32_t id);
+};
+
+// Serves the assertion protocol on a Unix domain socket. A single thread runs an epoll
+// event loop that accepts connections and reads and writes frames, and complete requests
+// are handed to worker threads through a bounded queue. The signers (which should use
+// tree caches) and the verifiers in the key registry, including the precomputed tables
+// for their keys, are thus shared by all clients. Every issued token is recorded in an
+// EquivocationStore and written back to disk before it is sent, so the server never signs
+// two statements in the same context, even across crashes. That would reveal the secret
+// key to anyone who asks for both. Linux only.
+class AssertionServer
+{
+public:
+    struct config_t {
+        // 0 means one worker per core
+        unsigned workers;
+        size_t queueCapacity;
+        // no requests are read from a connection while more bytes of responses than this
+        // wait to be sent to it
+        size_t outputHighWater;
+
+        config_t() : workers(0), queueCapacity(4096), outputHighWater(1 << 20) { }
+    };
+
+    // Listens on path, which is removed first if it exists. The signers are addressed by
+    // their index in the AUTHENTICATE and GET_DPK requests. Issued tokens are recorded in
+    // issued. verifiers and issued must outlive the server.
+    AssertionServer(const std::string& path, std::vector<std::shared_ptr<const Authenticator>> signers, KeyRegistry& verifiers, EquivocationStore& issued,
+                    const config_t& config);
+    // Stops the event loop and the workers and closes all connections.
+    ~AssertionServer();
+    AssertionServer(const AssertionServer&) = delete;
+    AssertionServer& operator=(const AssertionServer&) = delete;
+
+    // Time from the arrival of a request until its response is ready, per opcode.
+    const LatencyHistogram& getLatencies(AssertionProtocol::opcode_t op) const {
+        return latencies[op];
+    }
+    std::string getStatsJson() const;
+
+private:
+    struct connection_t;
+    struct job_t;
+    typedef std::unique_ptr<job_t> job_ptr;
+
+    std::string path;
+    std::vector<std::shared_ptr<const Authenticator>> signers;
+    std::vector<Authenticator::dpk_t> dpks;
+    KeyRegistry& verifiers;
+    EquivocationStore& issued;
+    std::array<LatencyHistogram, AssertionProtocol::OPCODES> latencies;
+    size_t outputHighWater;
+
+    int listenFd;
+    int epollFd;
+    // wakes up the event loop when responses are ready or the server stops
+    int eventFd;
+    std::atomic<bool> stopping;
+
+    // connections with new responses, protected by readyMutex
+    std::mutex readyMutex;
+    std::vector<std::shared_ptr<connection_t>> ready;
+
+    BoundedQueue<job_ptr> jobs;
+    std::thread loop;
+    std::vector<std::thread> workers;
+
+    void eventLoop();
+    void worker();
+    AssertionProtocol::status_t handle(job_t& job, AssertionProtocol::bytes_t& payload);
+    void respond(job_t& job, AssertionProtocol::status_t status, const AssertionProtocol::bytes_t& payload);
+};
+
+// Blocking client for the assertion protocol. Requests can be pipelined by sending several
+// of them before receiving the responses. Throws std::runtime_error on I/O errors.
+class AssertionClient
+{
+public:
+    AssertionClient(const std::string& path);
+    ~AssertionClient();
+    AssertionClient(const AssertionClient&) = delete;
+    AssertionClient& operator=(const AssertionClient&) = delete;
+
+    // Sends a request built with AssertionProtocol.
+    void send(const AssertionProtocol::bytes_t& request);
+    // Waits for the next response.
+    void receive(AssertionProtocol::response_t& response);
+
+private:
+    int fd;
+    AssertionProtocol::bytes_t in;
+};
+
+#endif // ASSERTIONSERVICE_H
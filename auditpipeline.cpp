@@ -0,0 +1,184 @@
+/*
+ * Copyright (c) 2015 Tim Ruffing <tim.ruffing@mmci.uni-saarland.de>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#include "auditpipeline.h"
+#include "equivocationstore.h"
+#include "keyregistry.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <assert.h>
+
+AuditPipeline::AuditPipeline(KeyRegistry& keys, EquivocationStore& store, const config_t& config, std::function<void(const equivocation_t&)> onEquivocation)
+    : keys(keys), store(store), onEquivocation(onEquivocation), malformed(0), invalid(0), equivocations(0), errors(0),
+      start(std::chrono::steady_clock::now()), closed(false)
+{
+    for (size_t s = 0; s < STAGES; s++) {
+        queues[s].reset(new BoundedQueue<item_ptr>(config.queueCapacity));
+        stages[s].items = 0;
+        stages[s].maxQueueDepth = 0;
+    }
+    for (size_t s = 0; s < STAGES; s++) {
+        unsigned n = config.threads[s] ? config.threads[s] : std::max(std::thread::hardware_concurrency(), 1u);
+        stages[s].running = n;
+        for (unsigned i = 0; i < n; i++) {
+            threads.emplace_back(&AuditPipeline::worker, this, (stage_t) s);
+        }
+    }
+}
+
+AuditPipeline::~AuditPipeline()
+{
+    close();
+}
+
+void AuditPipeline::submit(assertion_t&& a)
+{
+    if (closed) {
+        throw std::logic_error("pipeline is closed");
+    }
+    item_ptr item(new item_t);
+    item->a = std::move(a);
+    push(HASH, item);
+}
+
+void AuditPipeline::close()
+{
+    if (closed) {
+        return;
+    }
+    closed = true;
+    // every stage closes the queue of the next stage when its last thread exits
+    queues[HASH]->close();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+AuditPipeline::stats_t AuditPipeline::getStats() const
+{
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    stats_t res;
+    for (size_t s = 0; s < STAGES; s++) {
+        stage_stats_t& st = res.stages[s];
+        st.items = stages[s].items;
+        st.itemsPerSecond = seconds > 0 ? st.items / seconds : 0;
+        st.queueDepth = queues[s]->size();
+        st.maxQueueDepth = stages[s].maxQueueDepth;
+    }
+    res.malformed = malformed;
+    res.invalid = invalid;
+    res.equivocations = equivocations;
+    res.errors = errors;
+    return res;
+}
+
+void AuditPipeline::push(stage_t stage, item_ptr& item)
+{
+    BoundedQueue<item_ptr>& queue = *queues[stage];
+    queue.push(item);
+
+    size_t depth = queue.size();
+    std::atomic<size_t>& maxDepth = stages[stage].maxQueueDepth;
+    size_t old = maxDepth.load(std::memory_order_relaxed);
+    while (depth > old && !maxDepth.compare_exchange_weak(old, depth, std::memory_order_relaxed)) { }
+}
+
+void AuditPipeline::worker(stage_t stage)
+{
+    item_ptr item;
+    while (queues[stage]->pop(item)) {
+        bool forward;
+        try {
+            forward = process(stage, *item);
+        } catch (const std::exception&) {
+            // e.g., a failed extraction or a full disk, which must not stop the stage
+            errors++;
+            forward = false;
+        }
+        stages[stage].items++;
+        if (forward && stage + 1 < STAGES) {
+            push((stage_t) (stage + 1), item);
+        }
+        item.reset();
+    }
+    if (--stages[stage].running == 0 && stage + 1 < STAGES) {
+        queues[stage + 1]->close();
+    }
+}
+
+bool AuditPipeline::process(stage_t stage, item_t& item)
+{
+    const assertion_t& a = item.a;
+    switch (stage) {
+    case HASH:
+        try {
+            Wire::decodeDpk(item.dpk, a.dpk.data(), a.dpk.size());
+            TokenView(a.token.data(), a.token.size());
+        } catch (const std::invalid_argument&) {
+            malformed++;
+            return false;
+        }
+        ChameleonHash::digest(item.stDigest, a.st);
+        // the statement is not needed anymore
+        item.a.st = Authenticator::st_t();
+        return true;
+
+    case VERIFY: {
+        std::shared_ptr<const Authenticator> verifier;
+        try {
+            verifier = keys.get(item.dpk);
+        } catch (const std::invalid_argument&) {
+            // not a valid point
+            malformed++;
+            return false;
+        }
+        if (!verifier->verify(TokenView(a.token.data(), a.token.size()), a.ct, item.stDigest)) {
+            invalid++;
+            return false;
+        }
+        return true;
+    }
+
+    case DETECT:
+        return store.detectVerified(item.otherDigest, item.other, item.dpk, a.ct, item.stDigest, TokenView(a.token.data(), a.token.size()));
+
+    case EXTRACT: {
+        Authenticator acca(item.dpk);
+        acca.extract(TokenView(item.other.data(), item.other.size()), TokenView(a.token.data(), a.token.size()), a.ct, item.otherDigest, item.stDigest);
+        equivocations++;
+        if (onEquivocation) {
+            onEquivocation(equivocation_t{item.dpk, a.ct, acca.getDsk()});
+        }
+        return true;
+    }
+
+    default:
+        assert(false);
+        return false;
+    }
+}
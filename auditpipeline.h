@@ -0,0 +1,147 @@
+/*
+ * Copyright (c) 2015 Tim Ruffing <tim.ruffing@mmci.uni-saarland.de>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#ifndef AUDITPIPELINE_H
+#define AUDITPIPELINE_H
+
+#include "authenticator.h"
+#include "boundedqueue.h"
+#include "wire.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+class EquivocationStore;
+class KeyRegistry;
+
+// Audits a stream of assertions in four stages, which run on their own threads
+// and are connected by bounded lock-free queues:
+//  1. hash: parses the encoded key and token and computes the statement digest,
+//  2. verify: verifies the token with a verifier from the key registry,
+//  3. detect: records the assertion in the equivocation store and looks for a conflict,
+//  4. extract: extracts the secret key from two conflicting assertions.
+// Hashing large statements thus overlaps with the EC-heavy verification. If a stage
+// falls behind, its input queue fills up and the stages before it block, down to submit().
+class AuditPipeline
+{
+public:
+    struct assertion_t {
+        Wire::bytes_t dpk;
+        Authenticator::ct_t ct;
+        Authenticator::st_t st;
+        Wire::bytes_t token;
+    };
+
+    struct equivocation_t {
+        Authenticator::dpk_t dpk;
+        Authenticator::ct_t ct;
+        Authenticator::dsk_t dsk;
+    };
+
+    enum stage_t { HASH, VERIFY, DETECT, EXTRACT, STAGES };
+
+    struct config_t {
+        // number of threads per stage, 0 means one thread per core
+        std::array<unsigned, STAGES> threads;
+        // capacity of the input queue of each stage
+        size_t queueCapacity;
+
+        config_t() : threads{{1, 0, 1, 1}}, queueCapacity(1024) { }
+    };
+
+    struct stage_stats_t {
+        uint64_t items;
+        double itemsPerSecond;
+        size_t queueDepth;
+        size_t maxQueueDepth;
+    };
+
+    struct stats_t {
+        std::array<stage_stats_t, STAGES> stages;
+        uint64_t malformed;
+        uint64_t invalid;
+        uint64_t equivocations;
+        // assertions dropped because a stage threw an exception
+        uint64_t errors;
+    };
+
+    // onEquivocation is called from the threads of the extract stage.
+    AuditPipeline(KeyRegistry& keys, EquivocationStore& store, const config_t& config, std::function<void(const equivocation_t&)> onEquivocation);
+    // Closes the pipeline and waits until all submitted assertions have been processed.
+    ~AuditPipeline();
+
+    // Blocks if the pipeline is full. Must not be called after close().
+    void submit(assertion_t&& a);
+    // Signals the end of the stream and waits until all submitted assertions have been processed.
+    void close();
+
+    stats_t getStats() const;
+
+private:
+    struct item_t {
+        assertion_t a;
+        Authenticator::dpk_t dpk;
+        ChameleonHash::digest_t stDigest;
+        // the conflicting assertion found by the detect stage
+        ChameleonHash::digest_t otherDigest;
+        Wire::bytes_t other;
+    };
+    typedef std::unique_ptr<item_t> item_ptr;
+
+    struct stage_info_t {
+        std::atomic<uint64_t> items;
+        std::atomic<size_t> maxQueueDepth;
+        // threads of the stage that are still running
+        std::atomic<unsigned> running;
+    };
+
+    KeyRegistry& keys;
+    EquivocationStore& store;
+    std::function<void(const equivocation_t&)> onEquivocation;
+    // queues[s] is the input queue of stage s
+    std::array<std::unique_ptr<BoundedQueue<item_ptr>>, STAGES> queues;
+    std::array<stage_info_t, STAGES> stages;
+    std::atomic<uint64_t> malformed;
+    std::atomic<uint64_t> invalid;
+    std::atomic<uint64_t> equivocations;
+    std::atomic<uint64_t> errors;
+    std::vector<std::thread> threads;
+    std::chrono::steady_clock::time_point start;
+    bool closed;
+
+    void worker(stage_t stage);
+    void push(stage_t stage, item_ptr& item);
+    // Processes item in stage and returns whether it goes on to the next stage.
+    bool process(stage_t stage, item_t& item);
+};
+
+#endif // AUDITPIPELINE_H
@@ -26,77 +26,270 @@
 
 #include "authenticator.h"
 #include "chameleonhash.h"
+#include "instrumentation.h"
+#include "multiproof.h"
 #include "node.h"
 #include "prf.h"
+#include "treecache.h"
+#include "verifiednodecache.h"
+#include "wire.h"
+#include "workstealingpool.h"
 
+#include <algorithm>
 #include <exception>
 #include <assert.h>
 
-Authenticator::Authenticator(const Authenticator::dsk_t& dsk) : dsk(dsk), ch(dsk), hasSecretKey_(true) {
-     Prf prf(dsk, true);
+template<size_t CtLen> const size_t BasicAuthenticator<CtLen>::CT_LEN;
+template<size_t CtLen> const size_t BasicAuthenticator<CtLen>::DEPTH;
+template<size_t CtLen> const size_t BasicAuthenticator<CtLen>::TOKEN_LEN;
+template<size_t CtLen> const size_t BasicAuthenticator<CtLen>::AUTHENTICATE_CHUNK;
+
+namespace {
+
+// Access to the levels of a token, which is either a token_t or a TokenView.
+// For a token_t, a reference into the token is returned and buf is not used.
+template<size_t CtLen>
+inline const ChameleonHash::rand_t& tokenR(const BasicToken<CtLen>& t, size_t level, ChameleonHash::rand_t&)
+{
+    return t.rs[level];
+}
+
+template<size_t CtLen>
+inline const ChameleonHash::rand_t& tokenR(const BasicTokenView<CtLen>& t, size_t level, ChameleonHash::rand_t& buf)
+{
+    t.getR(buf, level);
+    return buf;
+}
+
+template<size_t CtLen>
+inline const ChameleonHash::hash_t& tokenCh(const BasicToken<CtLen>& t, size_t level, ChameleonHash::hash_t&)
+{
+    return t.chs[level];
+}
+
+template<size_t CtLen>
+inline const ChameleonHash::hash_t& tokenCh(const BasicTokenView<CtLen>& t, size_t level, ChameleonHash::hash_t& buf)
+{
+    t.getCh(buf, level);
+    return buf;
+}
+
+// The verified node cache stores token_t only, views bypass it.
+template<size_t CtLen>
+inline bool cacheContains(BasicVerifiedNodeCache<CtLen>& cache, const BasicToken<CtLen>& t, size_t level, const BasicNode<CtLen>& node, const ChameleonHash::digest_t& x)
+{
+    return cache.contains(t, level, node, x);
+}
+
+template<size_t CtLen>
+inline bool cacheContains(BasicVerifiedNodeCache<CtLen>&, const BasicTokenView<CtLen>&, size_t, const BasicNode<CtLen>&, const ChameleonHash::digest_t&)
+{
+    return false;
+}
+
+template<size_t CtLen>
+inline void cacheInsert(BasicVerifiedNodeCache<CtLen>& cache, const BasicToken<CtLen>& t, const std::array<unsigned char, CtLen>& ct, const std::array<ChameleonHash::digest_t, CtLen * 8>& xs)
+{
+    cache.insert(t, ct, xs);
+}
+
+template<size_t CtLen>
+inline void cacheInsert(BasicVerifiedNodeCache<CtLen>&, const BasicTokenView<CtLen>&, const std::array<unsigned char, CtLen>&, const std::array<ChameleonHash::digest_t, CtLen * 8>&) { }
+
+}
+
+template<size_t CtLen>
+BasicAuthenticator<CtLen>::BasicAuthenticator(const dsk_t& dsk) : dsk(dsk), ch(dsk), prf(dsk, CT_LEN), hasSecretKey_(true) {
      ChameleonHash::digest_t x;
      ChameleonHash::rand_t r;
 
      ChameleonHash::hash_t left, right;
      Node node = Node::leftChildOfRoot();
 
-     prf.getX(x, node);
-     prf.getR(r, node);
+     prf.getXR(x, r, node);
      ch.ch(left, x, r);
 
      node.moveToSibling();
 
-     prf.getX(x, node);
-     prf.getR(r, node);
+     prf.getXR(x, r, node);
      ch.ch(right, x, r);
 
      ChameleonHash::digest(rootDigest, left, right);
 }
 
-Authenticator::Authenticator(const Authenticator::dpk_t& dpk) : rootDigest(dpk.rootDigest), ch(dpk.chpk), hasSecretKey_(false) { }
+template<size_t CtLen>
+BasicAuthenticator<CtLen>::BasicAuthenticator(const dpk_t& dpk) : BasicAuthenticator(dpk, false) { }
+
+template<size_t CtLen>
+BasicAuthenticator<CtLen>::BasicAuthenticator(const dpk_t& dpk, bool precomputePk)
+    : rootDigest(dpk.rootDigest), ch(dpk.chpk, precomputePk), prf(dsk_t(), CT_LEN), hasSecretKey_(false)
+{
+    if (dpk.ctLen != CT_LEN) {
+        throw std::invalid_argument("key is for a different context length");
+    }
+}
+
 
+template<size_t CtLen>
+void BasicAuthenticator<CtLen>::authenticate(token_t& t, const ct_t& ct, const st_t& st) const
+{
+    ChameleonHash::digest_t stDigest;
+    ChameleonHash::digest(stDigest, st);
+    authenticate(t, ct, stDigest);
+}
 
-void Authenticator::authenticate(token_t& t, const Authenticator::ct_t& ct, const Authenticator::st_t& st)
+template<size_t CtLen>
+void BasicAuthenticator<CtLen>::authenticate(token_t& t, const ct_t& ct, const ChameleonHash::digest_t& stDigest) const
 {
+    ACCA_OPERATION(AUTHENTICATE);
     if (!hasSecretKey_) {
         throw std::logic_error("cannot authenticate without secret key");
     }
-    Prf prf(dsk, true);
-    ChameleonHash::digest_t prfX, subTreeX, sibX;
-    ChameleonHash::rand_t prfR, subTreeR, sibR;
-    ChameleonHash::hash_t chash, sibchash;
+    path_t path;
+    computePath(path, ct, 0, 2*DEPTH);
+    finishToken(t, path, ct, stDigest);
+}
+
+template<size_t CtLen>
+void BasicAuthenticator<CtLen>::precompute(handle_t& h, const ct_t& ct) const
+{
+    ACCA_OPERATION(PRECOMPUTE);
+    if (!hasSecretKey_) {
+        throw std::logic_error("cannot authenticate without secret key");
+    }
+    h.ct = ct;
+    computePath(h.path, ct, 0, 2*DEPTH);
+}
+
+template<size_t CtLen>
+void BasicAuthenticator<CtLen>::authenticate(token_t& t, const handle_t& h, const st_t& st) const
+{
+    ChameleonHash::digest_t stDigest;
+    ChameleonHash::digest(stDigest, st);
+    authenticate(t, h, stDigest);
+}
+
+template<size_t CtLen>
+void BasicAuthenticator<CtLen>::authenticate(token_t& t, const handle_t& h, const ChameleonHash::digest_t& stDigest) const
+{
+    ACCA_OPERATION(AUTHENTICATE);
+    if (!hasSecretKey_) {
+        throw std::logic_error("cannot authenticate without secret key");
+    }
+    finishToken(t, h.path, h.ct, stDigest);
+}
+
+template<size_t CtLen>
+void BasicAuthenticator<CtLen>::authenticate(token_t& t, const ct_t& ct, const st_t& st, WorkStealingPool& team) const
+{
+    ChameleonHash::digest_t stDigest;
+    ChameleonHash::digest(stDigest, st);
+    authenticate(t, ct, stDigest, team);
+}
+
+template<size_t CtLen>
+void BasicAuthenticator<CtLen>::authenticate(token_t& t, const ct_t& ct, const ChameleonHash::digest_t& stDigest, WorkStealingPool& team) const
+{
+    ACCA_OPERATION(AUTHENTICATE);
+    if (!hasSecretKey_) {
+        throw std::logic_error("cannot authenticate without secret key");
+    }
+    path_t path;
+    // a few chunks per thread, so that threads finishing early can steal work
+    const size_t chunks = std::min<size_t>(4 * team.size(), DEPTH);
+    team.parallelFor(chunks, [&](size_t c) {
+        computePath(path, ct, 2*DEPTH * c / chunks, 2*DEPTH * (c+1) / chunks);
+    });
+    finishToken(t, path, ct, stDigest);
+}
+
+template<size_t CtLen>
+void BasicAuthenticator<CtLen>::authenticate(extended_token_t& t, const ct_t& ct, const st_t& st) const
+{
+    ChameleonHash::digest_t stDigest;
+    ChameleonHash::digest(stDigest, st);
+    authenticate(t, ct, stDigest);
+}
+
+template<size_t CtLen>
+void BasicAuthenticator<CtLen>::authenticate(extended_token_t& t, const ct_t& ct, const ChameleonHash::digest_t& stDigest) const
+{
+    ACCA_OPERATION(AUTHENTICATE);
+    if (!hasSecretKey_) {
+        throw std::logic_error("cannot authenticate without secret key");
+    }
+    path_t path;
+    computePath(path, ct, 0, 2*DEPTH);
+    finishToken(t.token, path, ct, stDigest);
+    for (size_t i = 0; i < DEPTH; i++) {
+        t.pathChs[i] = path.chashes[2*i];
+    }
+}
+
+template<size_t CtLen>
+void BasicAuthenticator<CtLen>::computePath(path_t& path, const ct_t& ct, size_t begin, size_t end) const
+{
+    ACCA_PHASE(PHASE_PATH);
+    // The hashes on the levels covered by the tree cache are not computed but looked up.
+    const size_t uncached = DEPTH - (treeCache ? treeCache->getLevels() : 0);
 
     Node node(ct);
-    ChameleonHash::digest(subTreeX, st);
-    auto rOut = t.rs.begin();
-    auto chOut = t.chs.begin();
-
-    bool first = true;
-    while (!node.isRoot()) {
-        prf.getX(prfX, node);
-        prf.getR(prfR, node);
-        ch.ch(chash, prfX, prfR);
-        ch.collision(prfX, prfR, subTreeX, subTreeR);
-
-        if (first) {
-            ChameleonHash::randomOracle(chash, chash, subTreeR);
-            first = false;
+    for (size_t i = 0; i < begin / 2; i++) {
+        node.moveToParent();
+    }
+    // the nodes of the entries [begin, computedEnd) in the order of the entries
+    const size_t computedEnd = std::max(begin, std::min(end, 2*uncached));
+    std::vector<Node> nodes;
+    nodes.reserve(computedEnd - begin);
+    for (size_t j = begin; j < end; j++) {
+        bool sibling = j % 2;
+        if (sibling) {
+            node.moveToSibling();
         }
+        if (j < computedEnd) {
+            nodes.push_back(node);
+        } else {
+            // the PRF values of the path node are needed anyway to compute the collision
+            if (!sibling) {
+                prf.getXR(path.xs[j], path.rs[j], node);
+            }
+            assert(j / 2 >= uncached);
+            treeCache->get(path.chashes[j], node);
+        }
+        if (sibling) {
+            node.moveToSibling();
+            node.moveToParent();
+        }
+    }
 
-        node.moveToSibling();
+    prf.getXRs(path.xs.data() + begin, path.rs.data() + begin, nodes.data(), nodes.size());
+    ch.ch(path.chashes.data() + begin, path.xs.data() + begin, path.rs.data() + begin, nodes.size());
+}
+
+template<size_t CtLen>
+void BasicAuthenticator<CtLen>::finishToken(token_t& t, const path_t& path, const ct_t& ct, const ChameleonHash::digest_t& stDigest) const
+{
+    ACCA_PHASE(PHASE_CHAIN);
+    ChameleonHash::digest_t subTreeX = stDigest;
+    ChameleonHash::rand_t subTreeR;
 
-        prf.getX(sibX, node);
-        prf.getR(sibR, node);
-        ch.ch(sibchash, sibX, sibR);
+    Node node(ct);
+    for (size_t i = 0; i < DEPTH; i++) {
+        ChameleonHash::hash_t chash = path.chashes[2*i];
+        const ChameleonHash::hash_t& sibchash = path.chashes[2*i+1];
+        ch.collision(path.xs[2*i], path.rs[2*i], subTreeX, subTreeR);
 
-        *(rOut++) = subTreeR;
-        *(chOut++) = sibchash;
+        if (i == 0) {
+            ChameleonHash::randomOracle(chash, chash, subTreeR);
+        }
 
+        t.rs[i] = subTreeR;
+        t.chs[i] = sibchash;
 
         if (node.isLeftChild()) {
-            ChameleonHash::digest(subTreeX, sibchash, chash);
-        } else {
             ChameleonHash::digest(subTreeX, chash, sibchash);
+        } else {
+            ChameleonHash::digest(subTreeX, sibchash, chash);
         }
 
         node.moveToParent();
@@ -104,85 +297,664 @@ void Authenticator::authenticate(token_t& t, const Authenticator::ct_t& ct, cons
     assert(subTreeX == rootDigest);
 }
 
-bool Authenticator::verify(const Authenticator::token_t& t, const Authenticator::ct_t& ct, const Authenticator::st_t& st)
+template<size_t CtLen>
+void BasicAuthenticator<CtLen>::finishTokens(token_t* ts, const path_t* paths, const ct_t* cts, const ChameleonHash::digest_t* stDigests, size_t n) const
 {
-    return verifyWithLog(t, ct, st, nullptr);
+    ACCA_PHASE(PHASE_CHAIN);
+    std::vector<ChameleonHash::digest_t> subTreeXs(stDigests, stDigests + n), pathXs(n);
+    std::vector<ChameleonHash::rand_t> subTreeRs(n), pathRs(n);
+    std::vector<ChameleonHash::hash_t> lefts(n), rights(n);
+    std::vector<Node> nodes;
+    nodes.reserve(n);
+    for (size_t k = 0; k < n; k++) {
+        nodes.emplace_back(cts[k]);
+    }
+
+    for (size_t i = 0; i < DEPTH; i++) {
+        for (size_t k = 0; k < n; k++) {
+            pathXs[k] = paths[k].xs[2*i];
+            pathRs[k] = paths[k].rs[2*i];
+            lefts[k] = paths[k].chashes[2*i];
+        }
+        ch.collision(pathXs.data(), pathRs.data(), subTreeXs.data(), subTreeRs.data(), n);
+
+        if (i == 0) {
+            ChameleonHash::randomOracle(rights.data(), lefts.data(), subTreeRs.data(), n);
+            lefts.swap(rights);
+        }
+
+        for (size_t k = 0; k < n; k++) {
+            const ChameleonHash::hash_t& sibchash = paths[k].chashes[2*i+1];
+            ts[k].rs[i] = subTreeRs[k];
+            ts[k].chs[i] = sibchash;
+            if (nodes[k].isLeftChild()) {
+                rights[k] = sibchash;
+            } else {
+                rights[k] = lefts[k];
+                lefts[k] = sibchash;
+            }
+            nodes[k].moveToParent();
+        }
+        ChameleonHash::digest(subTreeXs.data(), lefts.data(), rights.data(), n);
+    }
+    for (size_t k = 0; k < n; k++) {
+        assert(subTreeXs[k] == rootDigest);
+    }
+}
+
+template<size_t CtLen>
+void BasicAuthenticator<CtLen>::authenticateChunks(token_t* ts, const ct_t* cts, const st_t* sts, size_t n, WorkStealingPool* pool) const
+{
+    ACCA_OPERATION(AUTHENTICATE_BATCH);
+    if (!hasSecretKey_) {
+        throw std::logic_error("cannot authenticate without secret key");
+    }
+    std::vector<path_t> paths(n);
+    std::vector<ChameleonHash::digest_t> stDigests(n);
+    auto path = [&](size_t k) {
+        computePath(paths[k], cts[k], 0, 2*DEPTH);
+        ChameleonHash::digest(stDigests[k], sts[k]);
+    };
+    // the chains are cheap compared to the paths, but profit from the bulk collisions
+    const size_t chunks = (n + AUTHENTICATE_CHUNK - 1) / AUTHENTICATE_CHUNK;
+    auto chain = [&](size_t c) {
+        size_t i = c * AUTHENTICATE_CHUNK;
+        finishTokens(ts + i, &paths[i], cts + i, &stDigests[i], std::min(AUTHENTICATE_CHUNK, n - i));
+    };
+    if (pool) {
+        pool->parallelFor(n, path);
+        pool->parallelFor(chunks, chain);
+    } else {
+        for (size_t k = 0; k < n; k++) {
+            path(k);
+        }
+        for (size_t c = 0; c < chunks; c++) {
+            chain(c);
+        }
+    }
+}
+
+template<size_t CtLen>
+bool BasicAuthenticator<CtLen>::verify(const token_t& t, const ct_t& ct, const st_t& st) const
+{
+    ACCA_OPERATION(VERIFY);
+    ChameleonHash::digest_t stDigest;
+    ChameleonHash::digest(stDigest, st);
+    return verifyWithLog(t, ct, stDigest, nullptr);
 }
 
+template<size_t CtLen>
+bool BasicAuthenticator<CtLen>::verify(const token_t& t, const ct_t& ct, const ChameleonHash::digest_t& stDigest) const
+{
+    ACCA_OPERATION(VERIFY);
+    return verifyWithLog(t, ct, stDigest, nullptr);
+}
 
-bool Authenticator::verifyWithLog(const Authenticator::token_t& t, const Authenticator::ct_t& ct, const Authenticator::st_t& st, log_t* log)
+template<size_t CtLen>
+bool BasicAuthenticator<CtLen>::verify(const TokenView& t, const ct_t& ct, const st_t& st) const
 {
-    ChameleonHash::digest_t subTreeX;
+    ACCA_OPERATION(VERIFY);
+    ChameleonHash::digest_t stDigest;
+    ChameleonHash::digest(stDigest, st);
+    return verifyWithLog(t, ct, stDigest, nullptr);
+}
+
+template<size_t CtLen>
+bool BasicAuthenticator<CtLen>::verify(const TokenView& t, const ct_t& ct, const ChameleonHash::digest_t& stDigest) const
+{
+    ACCA_OPERATION(VERIFY);
+    return verifyWithLog(t, ct, stDigest, nullptr);
+}
+
+template<size_t CtLen>
+bool BasicAuthenticator<CtLen>::verify(const extended_token_t& t, const ct_t& ct, const st_t& st) const
+{
+    ChameleonHash::digest_t stDigest;
+    ChameleonHash::digest(stDigest, st);
+    return verify(t, ct, stDigest);
+}
+
+template<size_t CtLen>
+bool BasicAuthenticator<CtLen>::verify(const extended_token_t& t, const ct_t& ct, const ChameleonHash::digest_t& stDigest) const
+{
+    ACCA_OPERATION(VERIFY);
+    ChameleonHash::digest_t subTreeX = stDigest;
+    std::array<ChameleonHash::digest_t, DEPTH> xs;
+    // levels whose chameleon hashes have to be checked, all below a node in the verified node cache
+    size_t levels = DEPTH;
+
+    Node node(ct);
+    for (size_t level = 0; level < DEPTH; level++) {
+        if (verifiedNodes && verifiedNodes->contains(t.token, level, node, subTreeX)) {
+            levels = level;
+            break;
+        }
+        xs[level] = subTreeX;
+
+        ChameleonHash::hash_t chash = t.pathChs[level];
+        const ChameleonHash::hash_t& sibchash = t.token.chs[level];
+        if (level == 0) {
+            ChameleonHash::randomOracle(chash, chash, t.token.rs[level]);
+        }
+        if (node.isLeftChild()) {
+            ChameleonHash::digest(subTreeX, chash, sibchash);
+        } else {
+            ChameleonHash::digest(subTreeX, sibchash, chash);
+        }
+        node.moveToParent();
+    }
+    if (levels == DEPTH && subTreeX != rootDigest) {
+        return false;
+    }
+
+    // the path is consistent with the root, so it remains to check that the given
+    // chameleon hashes are the ones of the digests on the path
+    if (!ch.verify(t.pathChs.data(), xs.data(), t.token.rs.data(), levels)) {
+        return false;
+    }
+    if (verifiedNodes && levels == DEPTH) {
+        verifiedNodes->insert(t.token, ct, xs);
+    }
+    return true;
+}
+
+template<size_t CtLen>
+template<typename Token>
+bool BasicAuthenticator<CtLen>::verifyWithLog(const Token& t, const ct_t& ct, const ChameleonHash::digest_t& stDigest, log_t* log) const
+{
+    ChameleonHash::digest_t subTreeX = stDigest;
     ChameleonHash::hash_t chash;
+    ChameleonHash::rand_t rBuf;
+    ChameleonHash::hash_t sibchashBuf;
+    // digests of the nodes on the path, only needed for the verified node cache
+    std::array<ChameleonHash::digest_t, DEPTH> xs;
+    // the log needs the full path
+    const bool useCache = verifiedNodes && !log;
 
     Node node(ct);
-    ChameleonHash::digest(subTreeX, st);
-    auto rIt =  t.rs.begin();
-    auto sibchashIt = t.chs.begin();
+    for (size_t level = 0; level < DEPTH; level++) {
+        if (useCache) {
+            if (cacheContains(*verifiedNodes, t, level, node, subTreeX)) {
+                return true;
+            }
+            xs[level] = subTreeX;
+        }
 
-    bool first = true;
-    while(!node.isRoot()) { // stop after the hash in the root
-        ch.ch(chash, subTreeX, *rIt);
+        const ChameleonHash::rand_t& r = tokenR(t, level, rBuf);
+        const ChameleonHash::hash_t& sibchash = tokenCh(t, level, sibchashBuf);
+        ch.ch(chash, subTreeX, r);
 
         if (log) {
             log->chs.push_back(chash);
             log->xs.push_back(subTreeX);
         }
 
-        if (first) {
-            ChameleonHash::randomOracle(chash, chash, *rIt);
-            first = false;
+        if (level == 0) {
+            ChameleonHash::randomOracle(chash, chash, r);
         }
 
         // compute hash of the parent of node
         if (node.isLeftChild()) {
-            ChameleonHash::digest(subTreeX, chash, *sibchashIt);
+            ChameleonHash::digest(subTreeX, chash, sibchash);
         } else {
-            ChameleonHash::digest(subTreeX, *sibchashIt, chash);
+            ChameleonHash::digest(subTreeX, sibchash, chash);
+        }
+
+        node.moveToParent();
+    }
+    assert(node.isRoot());
+    if (subTreeX != rootDigest) {
+        return false;
+    }
+    if (useCache) {
+        cacheInsert(*verifiedNodes, t, ct, xs);
+    }
+    return true;
+}
+
+template<size_t CtLen>
+std::vector<bool> BasicAuthenticator<CtLen>::verifyBatch(const std::vector<token_t>& ts, const std::vector<ct_t>& cts, const std::vector<st_t>& sts) const
+{
+    ACCA_OPERATION(VERIFY_BATCH);
+    if (ts.size() != cts.size() || ts.size() != sts.size()) {
+        throw std::invalid_argument("batch sizes differ");
+    }
+    size_t n = ts.size();
+
+    std::vector<bool> valid(n, true);
+    // tokens accepted early because of the verified node cache
+    std::vector<bool> done(n, false);
+    std::vector<std::array<ChameleonHash::digest_t, DEPTH>> pathXs(verifiedNodes ? n : 0);
+    std::vector<Node> nodes;
+    std::vector<ChameleonHash::digest_t> subTreeXs(n);
+    nodes.reserve(n);
+    for (size_t i = 0; i < n; i++) {
+        nodes.emplace_back(cts[i]);
+        ChameleonHash::digest(subTreeXs[i], sts[i]);
+    }
+
+    // indices of tokens that are still valid, and their points on the current level
+    std::vector<size_t> active;
+    std::vector<secp256k1_gej_t> points;
+    std::vector<ChameleonHash::hash_t> chashes, lefts, rights;
+    std::vector<ChameleonHash::rand_t> rands;
+    std::vector<ChameleonHash::digest_t> parentXs;
+    active.reserve(n);
+    points.reserve(n);
+    chashes.reserve(n);
+
+    for (size_t level = 0; level < DEPTH; level++) {
+        active.clear();
+        points.clear();
+        for (size_t i = 0; i < n; i++) {
+            if (!valid[i] || done[i]) {
+                continue;
+            }
+            if (verifiedNodes) {
+                if (verifiedNodes->contains(ts[i], level, nodes[i], subTreeXs[i])) {
+                    done[i] = true;
+                    continue;
+                }
+                pathXs[i][level] = subTreeXs[i];
+            }
+            secp256k1_gej_t point;
+            try {
+                ch.chJacobian(point, subTreeXs[i], ts[i].rs[level]);
+            } catch (const std::invalid_argument&) {
+                // randomness out of range, the token cannot be valid
+                valid[i] = false;
+                continue;
+            }
+            active.push_back(i);
+            points.push_back(point);
+        }
+
+        size_t m = active.size();
+        chashes.resize(m);
+        ChameleonHash::serialize(chashes.data(), points.data(), points.size());
+
+        if (level == 0) {
+            rands.resize(m);
+            for (size_t j = 0; j < m; j++) {
+                rands[j] = ts[active[j]].rs[level];
+            }
+            ChameleonHash::randomOracle(chashes.data(), chashes.data(), rands.data(), m);
+        }
+
+        // compute the hashes of the parents of the nodes
+        lefts.resize(m);
+        rights.resize(m);
+        for (size_t j = 0; j < m; j++) {
+            size_t i = active[j];
+            if (nodes[i].isLeftChild()) {
+                lefts[j] = chashes[j];
+                rights[j] = ts[i].chs[level];
+            } else {
+                lefts[j] = ts[i].chs[level];
+                rights[j] = chashes[j];
+            }
+        }
+        parentXs.resize(m);
+        ChameleonHash::digest(parentXs.data(), lefts.data(), rights.data(), m);
+        for (size_t j = 0; j < m; j++) {
+            size_t i = active[j];
+            subTreeXs[i] = parentXs[j];
+            nodes[i].moveToParent();
+        }
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        if (!valid[i] || done[i]) {
+            continue;
+        }
+        assert(nodes[i].isRoot());
+        valid[i] = (subTreeXs[i] == rootDigest);
+        if (valid[i] && verifiedNodes) {
+            verifiedNodes->insert(ts[i], cts[i], pathXs[i]);
+        }
+    }
+    return valid;
+}
+
+template<size_t CtLen>
+void BasicAuthenticator<CtLen>::authenticateMulti(MultiProof& proof, const std::vector<ct_t>& cts, const std::vector<st_t>& sts) const
+{
+    if (cts.size() != sts.size()) {
+        throw std::invalid_argument("batch sizes differ");
+    }
+    std::vector<token_t> ts(cts.size());
+    authenticateChunks(ts.data(), cts.data(), sts.data(), cts.size(), nullptr);
+    MultiProof::fromTokens(proof, ts, cts);
+}
+
+template<size_t CtLen>
+bool BasicAuthenticator<CtLen>::verifyMulti(const MultiProof& proof, const std::vector<ct_t>& cts, const std::vector<st_t>& sts) const
+{
+    ACCA_OPERATION(VERIFY_BATCH);
+    typedef typename MultiProof::level_t level_t;
+    if (cts.size() != sts.size()) {
+        throw std::invalid_argument("batch sizes differ");
+    }
+    if (cts.empty()) {
+        throw std::invalid_argument("no assertions");
+    }
+    const size_t n = cts.size();
+    std::vector<size_t> leaves;
+    std::vector<level_t> levels = MultiProof::layout(leaves, cts);
+
+    size_t rsLen = 2 * n, chsLen = n;
+    for (size_t level = 1; level < DEPTH; level++) {
+        const level_t& lv = levels[level];
+        rsLen += level >= 2 ? lv.nodes.size() : 0;
+        chsLen += std::count(lv.siblings.begin(), lv.siblings.end(), level_t::NONE);
+    }
+    if (proof.rs.size() != rsLen || proof.chs.size() != chsLen) {
+        return false;
+    }
+    const ChameleonHash::rand_t* rs = proof.rs.data();
+    const ChameleonHash::hash_t* chs = proof.chs.data();
+
+    std::vector<ChameleonHash::digest_t> xs(n);
+    std::vector<ChameleonHash::hash_t> chashes(n), lefts, rights;
+    try {
+        // levels 0 and 1 have an entry for every assertion
+        for (size_t i = 0; i < n; i++) {
+            ChameleonHash::digest(xs[i], sts[i]);
+        }
+        ch.ch(chashes.data(), xs.data(), rs, n);
+        ChameleonHash::randomOracle(chashes.data(), chashes.data(), rs, n);
+        lefts.resize(n);
+        rights.resize(n);
+        for (size_t i = 0; i < n; i++) {
+            if (levels[0].nodes[leaves[i]].isLeftChild()) {
+                lefts[i] = chashes[i];
+                rights[i] = chs[i];
+            } else {
+                lefts[i] = chs[i];
+                rights[i] = chashes[i];
+            }
+        }
+        ChameleonHash::digest(xs.data(), lefts.data(), rights.data(), n);
+        ch.ch(chashes.data(), xs.data(), rs + n, n);
+        rs += 2 * n;
+        chs += n;
+
+        // from level 1 on, every path node has a single hash
+        std::vector<ChameleonHash::hash_t> nodeChashes(levels[1].nodes.size());
+        std::vector<bool> seen(nodeChashes.size(), false);
+        for (size_t i = 0; i < n; i++) {
+            size_t j = levels[0].parents[leaves[i]];
+            if (seen[j] && nodeChashes[j] != chashes[i]) {
+                return false;
+            }
+            nodeChashes[j] = chashes[i];
+            seen[j] = true;
         }
 
-        rIt++;
-        sibchashIt++;
+        std::vector<size_t> computed;
+        for (size_t level = 1; level < DEPTH; level++) {
+            const level_t& lv = levels[level];
+            const size_t m = lv.nodes.size();
+            if (level >= 2) {
+                nodeChashes.resize(m);
+                ch.ch(nodeChashes.data(), xs.data(), rs, m);
+                rs += m;
+            }
+
+            // the digest of a parent is computed only once if both children are path nodes
+            computed.clear();
+            lefts.clear();
+            rights.clear();
+            for (size_t j = 0; j < m; j++) {
+                size_t sibling = lv.siblings[j];
+                if (sibling != level_t::NONE && sibling < j) {
+                    continue;
+                }
+                const ChameleonHash::hash_t& sibchash = sibling == level_t::NONE ? *chs++ : nodeChashes[sibling];
+                if (lv.nodes[j].isLeftChild()) {
+                    lefts.push_back(nodeChashes[j]);
+                    rights.push_back(sibchash);
+                } else {
+                    lefts.push_back(sibchash);
+                    rights.push_back(nodeChashes[j]);
+                }
+                computed.push_back(j);
+            }
+            std::vector<ChameleonHash::digest_t> parentXs(computed.size());
+            ChameleonHash::digest(parentXs.data(), lefts.data(), rights.data(), computed.size());
+            xs.resize(level + 1 < DEPTH ? levels[level + 1].nodes.size() : 1);
+            for (size_t k = 0; k < computed.size(); k++) {
+                xs[lv.parents[computed[k]]] = parentXs[k];
+            }
+        }
+    } catch (const std::invalid_argument&) {
+        // randomness out of range
+        return false;
+    }
+    return xs[0] == rootDigest;
+}
+
+template<size_t CtLen>
+void BasicAuthenticator<CtLen>::authenticateMany(std::vector<token_t>& ts, const std::vector<ct_t>& cts, const std::vector<st_t>& sts, WorkStealingPool& pool) const
+{
+    if (cts.size() != sts.size()) {
+        throw std::invalid_argument("batch sizes differ");
+    }
+    ts.resize(cts.size());
+    authenticateChunks(ts.data(), cts.data(), sts.data(), cts.size(), &pool);
+}
+
+template<size_t CtLen>
+std::vector<bool> BasicAuthenticator<CtLen>::verifyMany(const std::vector<token_t>& ts, const std::vector<ct_t>& cts, const std::vector<st_t>& sts, WorkStealingPool& pool) const
+{
+    if (ts.size() != cts.size() || ts.size() != sts.size()) {
+        throw std::invalid_argument("batch sizes differ");
+    }
+    // std::vector<bool> does not allow concurrent writes to different elements
+    std::vector<char> valid(ts.size());
+    pool.parallelFor(ts.size(), [&](size_t i) {
+        valid[i] = verify(ts[i], cts[i], sts[i]);
+    });
+    return std::vector<bool>(valid.begin(), valid.end());
+}
+
+template<size_t CtLen>
+void BasicAuthenticator<CtLen>::extract(const token_t& t1, const token_t& t2, const ct_t& ct, const st_t& st1, const st_t& st2)
+{
+    ACCA_OPERATION(EXTRACT);
+    ChameleonHash::digest_t d1, d2;
+    ChameleonHash::digest(d1, st1);
+    ChameleonHash::digest(d2, st2);
+    extractFrom(t1, t2, ct, d1, d2);
+}
+
+template<size_t CtLen>
+void BasicAuthenticator<CtLen>::extract(const TokenView& t1, const TokenView& t2, const ct_t& ct, const st_t& st1, const st_t& st2)
+{
+    ACCA_OPERATION(EXTRACT);
+    ChameleonHash::digest_t d1, d2;
+    ChameleonHash::digest(d1, st1);
+    ChameleonHash::digest(d2, st2);
+    extractFrom(t1, t2, ct, d1, d2);
+}
+
+template<size_t CtLen>
+void BasicAuthenticator<CtLen>::extract(const TokenView& t1, const TokenView& t2, const ct_t& ct, const ChameleonHash::digest_t& d1, const ChameleonHash::digest_t& d2)
+{
+    ACCA_OPERATION(EXTRACT);
+    extractFrom(t1, t2, ct, d1, d2);
+}
+
+template<size_t CtLen>
+template<typename Token>
+void BasicAuthenticator<CtLen>::extractFrom(const Token& t1, const Token& t2, const ct_t& ct, const ChameleonHash::digest_t& d1, const ChameleonHash::digest_t& d2)
+{
+    // Tokens by an honest signer collide on the leaf level. Try this first, it does not
+    // need any chameleon hash evaluations.
+    ChameleonHash::rand_t r1Buf, r2Buf;
+    if (!ch.tryExtract(d1, tokenR(t1, 0, r1Buf), d2, tokenR(t2, 0, r2Buf))) {
+        findCollision(t1, t2, ct, d1, d2);
+    }
+    hasSecretKey_ = true;
+}
+
+template<size_t CtLen>
+template<typename Token>
+void BasicAuthenticator<CtLen>::findCollision(const Token& t1, const Token& t2, const ct_t& ct, const ChameleonHash::digest_t& d1, const ChameleonHash::digest_t& d2)
+{
+    // Walk up both paths in lockstep until they collide. The tokens need not verify,
+    // since an extracted key is checked against the public key anyway.
+    std::array<ChameleonHash::digest_t, 2> xs = {{ d1, d2 }};
+    std::array<ChameleonHash::rand_t, 2> rs;
+    std::array<ChameleonHash::hash_t, 2> chashes, sibchashes, lefts, rights;
+
+    Node node(ct);
+    for (size_t level = 0; level < DEPTH; level++) {
+        rs[0] = tokenR(t1, level, rs[0]);
+        rs[1] = tokenR(t2, level, rs[1]);
+        if (xs[0] == xs[1] && rs[0] == rs[1]) {
+            // the paths have merged, so there cannot be a collision further up
+            break;
+        }
+        ch.ch(chashes.data(), xs.data(), rs.data(), 2);
+        if (chashes[0] == chashes[1]) {
+            ch.extract(xs[0], rs[0], xs[1], rs[1]);
+            return;
+        }
+
+        if (level == 0) {
+            ChameleonHash::randomOracle(chashes.data(), chashes.data(), rs.data(), 2);
+        }
+        sibchashes[0] = tokenCh(t1, level, sibchashes[0]);
+        sibchashes[1] = tokenCh(t2, level, sibchashes[1]);
+        if (node.isLeftChild()) {
+            lefts = chashes;
+            rights = sibchashes;
+        } else {
+            lefts = sibchashes;
+            rights = chashes;
+        }
+        ChameleonHash::digest(xs.data(), lefts.data(), rights.data(), 2);
         node.moveToParent();
     }
-    assert(sibchashIt == t.chs.end());
-    assert(rIt == t.rs.end());
-    return (subTreeX == rootDigest);
+    throw std::invalid_argument("t1 and t2 do not contain a collision");
+}
+
+template<size_t CtLen>
+std::vector<bool> BasicAuthenticator<CtLen>::extractBatch(std::vector<dsk_t>& dsks, const std::vector<dpk_t>& dpks, const std::vector<TokenView>& t1s, const std::vector<TokenView>& t2s,
+                                                          const std::vector<ct_t>& cts, const std::vector<ChameleonHash::digest_t>& d1s, const std::vector<ChameleonHash::digest_t>& d2s)
+{
+    return extractBatchFrom(dsks, dpks, t1s, t2s, cts, d1s, d2s);
 }
 
-void Authenticator::extract(const Authenticator::token_t& t1, const Authenticator::token_t& t2, const Authenticator::ct_t& ct, const Authenticator::st_t& st1, const Authenticator::st_t& st2)
+template<size_t CtLen>
+std::vector<bool> BasicAuthenticator<CtLen>::extractBatch(std::vector<dsk_t>& dsks, const std::vector<dpk_t>& dpks, const std::vector<token_t>& t1s, const std::vector<token_t>& t2s,
+                                                          const std::vector<ct_t>& cts, const std::vector<st_t>& st1s, const std::vector<st_t>& st2s)
 {
-    log_t log1, log2;
-    if (!verifyWithLog(t1, ct, st1, &log1)) {
-        throw std::invalid_argument("t1 does not verify");
+    if (st1s.size() != st2s.size()) {
+        throw std::invalid_argument("batch sizes differ");
     }
-    if (!verifyWithLog(t2, ct, st2, &log2)) {
-        throw std::invalid_argument("t2 does not verify");
+    std::vector<ChameleonHash::digest_t> d1s(st1s.size()), d2s(st2s.size());
+    for (size_t i = 0; i < st1s.size(); i++) {
+        ChameleonHash::digest(d1s[i], st1s[i]);
+        ChameleonHash::digest(d2s[i], st2s[i]);
     }
+    return extractBatchFrom(dsks, dpks, t1s, t2s, cts, d1s, d2s);
+}
 
-    for (int i = 0; i < DEPTH; i++) {
-        // check for collision
-        if ((log1.xs[i] != log2.xs[i] || t1.rs[i] != t2.rs[i]) && log1.chs[i] == log2.chs[i]) {
-            ch.extract(log1.xs[i], t1.rs[i], log2.xs[i], t2.rs[i]);
+template<size_t CtLen>
+template<typename Token>
+std::vector<bool> BasicAuthenticator<CtLen>::extractBatchFrom(std::vector<dsk_t>& dsks, const std::vector<dpk_t>& dpks, const std::vector<Token>& t1s, const std::vector<Token>& t2s,
+                                                              const std::vector<ct_t>& cts, const std::vector<ChameleonHash::digest_t>& d1s, const std::vector<ChameleonHash::digest_t>& d2s)
+{
+    ACCA_OPERATION(EXTRACT);
+    size_t n = dpks.size();
+    if (t1s.size() != n || t2s.size() != n || cts.size() != n || d1s.size() != n || d2s.size() != n) {
+        throw std::invalid_argument("batch sizes differ");
+    }
+    dsks.assign(n, dsk_t());
+    std::vector<bool> ok(n, false);
+
+    // candidates for the leaf level and their inputs
+    std::vector<size_t> indices;
+    std::vector<BasicAuthenticator> accas;
+    std::vector<ChameleonHash*> chs;
+    std::vector<ChameleonHash::rand_t> r1s, r2s;
+    std::vector<ChameleonHash::digest_t> cd1s, cd2s;
+    accas.reserve(n);
+    for (size_t i = 0; i < n; i++) {
+        try {
+            accas.emplace_back(dpks[i]);
+        } catch (const std::invalid_argument&) {
+            // invalid key or other context length
+            continue;
         }
-        if (!ch.hasSecretKey()) {
-            throw std::runtime_error("t1 and t2 are not extractable even though they both verify. This state should be computationally infeasible to reach.");
+        indices.push_back(i);
+        r1s.emplace_back();
+        r2s.emplace_back();
+        r1s.back() = tokenR(t1s[i], 0, r1s.back());
+        r2s.back() = tokenR(t2s[i], 0, r2s.back());
+        cd1s.push_back(d1s[i]);
+        cd2s.push_back(d2s[i]);
+    }
+    // pointers are taken only now since accas does not grow any more
+    for (BasicAuthenticator& acca : accas) {
+        chs.push_back(&acca.ch);
+    }
+
+    // all leaf-level extractions share a single scalar inversion
+    std::vector<bool> leafOk = ChameleonHash::tryExtract(chs.data(), cd1s.data(), r1s.data(), cd2s.data(), r2s.data(), chs.size());
+    for (size_t j = 0; j < indices.size(); j++) {
+        size_t i = indices[j];
+        BasicAuthenticator& acca = accas[j];
+        if (!leafOk[j]) {
+            try {
+                acca.findCollision(t1s[i], t2s[i], cts[i], d1s[i], d2s[i]);
+            } catch (const std::invalid_argument&) {
+                continue;
+            }
         }
-        hasSecretKey_ = true;
+        acca.hasSecretKey_ = true;
+        dsks[i] = acca.getDsk();
+        ok[i] = true;
     }
+    return ok;
 }
 
+template<size_t CtLen>
+void BasicAuthenticator<CtLen>::setTreeCache(std::shared_ptr<const TreeCache> cache)
+{
+    if (cache && cache->getRootDigest() != rootDigest) {
+        throw std::invalid_argument("tree cache belongs to a different key");
+    }
+    treeCache = cache;
+}
+
+template<size_t CtLen>
+void BasicAuthenticator<CtLen>::setVerifiedNodeCache(std::shared_ptr<VerifiedNodeCache> cache)
+{
+    if (cache && cache->getRootDigest() != rootDigest) {
+        throw std::invalid_argument("verified node cache belongs to a different key");
+    }
+    verifiedNodes = cache;
+}
 
-Authenticator::dpk_t Authenticator::getDpk()
+template<size_t CtLen>
+typename BasicAuthenticator<CtLen>::dpk_t BasicAuthenticator<CtLen>::getDpk() const
 {
     dpk_t dpk;
     dpk.chpk = ch.getPk(true);
     dpk.rootDigest = rootDigest;
+    dpk.ctLen = CT_LEN;
     return dpk;
 }
 
-Authenticator::dsk_t Authenticator::getDsk()
+template<size_t CtLen>
+typename BasicAuthenticator<CtLen>::dsk_t BasicAuthenticator<CtLen>::getDsk() const
 {
     return ch.getSk();
 }
 
+#define INSTANTIATE(n) template class BasicAuthenticator<n>;
+ACCA_FOR_EACH_CT_LEN(INSTANTIATE)
+#undef INSTANTIATE
@@ -28,58 +28,214 @@
 #define AUTHENTICATOR_H
 
 #include "chameleonhash.h"
+#include "contextlength.h"
 #include "prf.h"
 
-class Authenticator
+#include <memory>
+
+template<size_t CtLen> class BasicMultiProof;
+template<size_t CtLen> class BasicNode;
+template<size_t CtLen> class BasicStreamingVerifier;
+template<size_t CtLen> class BasicTokenView;
+template<size_t CtLen> class BasicTreeCache;
+template<size_t CtLen> class BasicVerifiedNodeCache;
+class WorkStealingPool;
+
+// The public key is the same type for all context lengths, so that keys of different
+// lengths can be stored and transmitted uniformly. The length is part of the key.
+struct AuthenticatorDpk {
+    ChameleonHash::pk_t chpk;
+    ChameleonHash::digest_t rootDigest;
+    // length of contexts in bytes
+    size_t ctLen;
+};
+
+template<size_t CtLen>
+struct BasicToken {
+    std::array<ChameleonHash::hash_t, CtLen * 8> chs;
+    std::array<ChameleonHash::rand_t, CtLen * 8> rs;
+};
+
+// A token together with the chameleon hashes of the nodes on the path of its context (on the
+// leaf level before the random oracle). They make the token DEPTH * HASH_LEN bytes larger but
+// allow to verify all levels with a single multi-scalar multiplication.
+template<size_t CtLen>
+struct BasicExtendedToken {
+    BasicToken<CtLen> token;
+    std::array<ChameleonHash::hash_t, CtLen * 8> pathChs;
+};
+
+// The authenticator for contexts of CtLen bytes, see contextlength.h for the supported
+// lengths. Authenticator is the one for the length configured in cmake, and
+// AnyAuthenticator selects the length at runtime.
+template<size_t CtLen>
+class BasicAuthenticator
 {
 public:
-    // Length of context in bytes. This is configurable via the ACCA_CT_LEN variable in cmake.
-    static const size_t CT_LEN = ACCA_CT_LEN;
+    typedef BasicMultiProof<CtLen> MultiProof;
+    typedef BasicNode<CtLen> Node;
+    typedef BasicTokenView<CtLen> TokenView;
+    typedef BasicTreeCache<CtLen> TreeCache;
+    typedef BasicVerifiedNodeCache<CtLen> VerifiedNodeCache;
+
+    // Length of context in bytes.
+    static const size_t CT_LEN = CtLen;
 
     // Depth is number of non-root levels.
     static const size_t DEPTH = CT_LEN * 8;
 
-    // Authentication tokens are 4160 bytes long. By compressing the sign bytes into bit vectors,
-    // we could additionally save 60 bits.
+    // Size of token_t in bytes. The wire encoding in wire.h packs the sign bytes of the
+    // chameleon hashes into a bit vector.
     static const size_t TOKEN_LEN = DEPTH * (ChameleonHash::HASH_LEN + ChameleonHash::RAND_LEN);
 
     typedef std::array<unsigned char, CT_LEN> ct_t;
     typedef std::vector<unsigned char> st_t;
 
     typedef ChameleonHash::sk_t dsk_t;
-    struct dpk_t {
-        ChameleonHash::pk_t chpk;
-        ChameleonHash::digest_t rootDigest;
+    typedef AuthenticatorDpk dpk_t;
+    typedef BasicToken<CtLen> token_t;
+    typedef BasicExtendedToken<CtLen> extended_token_t;
+
+    // The values on the path of a context that do not depend on the statement.
+    // Entry 2*i belongs to the node on level i of the path (counted from the leaf),
+    // entry 2*i+1 to its sibling.
+    struct path_t {
+        std::array<ChameleonHash::digest_t, 2*DEPTH> xs;
+        std::array<ChameleonHash::rand_t, 2*DEPTH> rs;
+        std::array<ChameleonHash::hash_t, 2*DEPTH> chashes;
     };
 
-    struct token_t {
-        std::array<ChameleonHash::hash_t, DEPTH> chs;
-        std::array<ChameleonHash::rand_t, DEPTH> rs;
+    // Everything authenticate() computes for a context before the statement is known,
+    // which includes all of the elliptic curve work, see precompute(). A handle contains
+    // the PRF outputs of the leaf, from which the secret key can be computed together with
+    // any token for its context. Handles are thus as secret as the secret key: never log,
+    // serialize or share them.
+    struct handle_t {
+        ct_t ct;
+        path_t path;
     };
 
-    Authenticator(const Authenticator::dsk_t& dsk);
-    Authenticator(const Authenticator::dpk_t& dpk);
-
-    void authenticate(token_t& t, const ct_t& ct, const st_t &st);
-    bool verify(const token_t& t, const ct_t& ct, const st_t &st);
+    BasicAuthenticator(const dsk_t& dsk);
+    // Throws std::invalid_argument if dpk is a key for a different context length.
+    BasicAuthenticator(const dpk_t& dpk);
+    // If precomputePk is set, verification uses a precomputed table for the public key.
+    // This costs about 85 KB of memory but makes verification considerably faster.
+    BasicAuthenticator(const dpk_t& dpk, bool precomputePk);
+
+    // authenticate() and verify() are const and reentrant, so a single instance can be
+    // used by several threads at once.
+    void authenticate(token_t& t, const ct_t& ct, const st_t &st) const;
+    bool verify(const token_t& t, const ct_t& ct, const st_t &st) const;
+    // Same as above for a statement given by its digest, e.g., computed by a MessageDigester
+    // from a large statement that is never copied into an st_t.
+    void authenticate(token_t& t, const ct_t& ct, const ChameleonHash::digest_t& stDigest) const;
+    bool verify(const token_t& t, const ct_t& ct, const ChameleonHash::digest_t& stDigest) const;
+    // Verifies an encoded token in place. Views do not use the verified node cache.
+    bool verify(const TokenView& t, const ct_t& ct, const st_t &st) const;
+    bool verify(const TokenView& t, const ct_t& ct, const ChameleonHash::digest_t& stDigest) const;
+    // Offline/online signing: precompute() does the expensive part of authenticate() for a
+    // context ahead of time, and authenticating a statement with the handle needs only scalar
+    // arithmetic and hashing. A handle can be used any number of times. As with authenticate(),
+    // authenticating two different statements for the same context reveals the secret key.
+    // A handle is key material, see handle_t.
+    void precompute(handle_t& h, const ct_t& ct) const;
+    void authenticate(token_t& t, const handle_t& h, const st_t &st) const;
+    void authenticate(token_t& t, const handle_t& h, const ChameleonHash::digest_t& stDigest) const;
+    // Latency mode: the chameleon hashes on the path are computed in parallel by the
+    // threads of team, and only the short chain of collisions and digests runs on the
+    // calling thread. The team should be small and pinned, see WorkStealingPool.
+    void authenticate(token_t& t, const ct_t& ct, const st_t &st, WorkStealingPool& team) const;
+    void authenticate(token_t& t, const ct_t& ct, const ChameleonHash::digest_t& stDigest, WorkStealingPool& team) const;
+    // Extended tokens: verify() first checks the digests on the path up to the root, which is
+    // cheap, and then all chameleon hashes on the path at once, see ChameleonHash::verify().
+    // The plain token t.token can be verified as usual.
+    void authenticate(extended_token_t& t, const ct_t& ct, const st_t &st) const;
+    void authenticate(extended_token_t& t, const ct_t& ct, const ChameleonHash::digest_t& stDigest) const;
+    bool verify(const extended_token_t& t, const ct_t& ct, const st_t &st) const;
+    bool verify(const extended_token_t& t, const ct_t& ct, const ChameleonHash::digest_t& stDigest) const;
+    // Verifies many tokens at once by processing them level by level, which allows to share
+    // the field inversions needed to serialize chameleon hashes. Returns the result for each token.
+    std::vector<bool> verifyBatch(const std::vector<token_t>& ts, const std::vector<ct_t>& cts, const std::vector<st_t>& sts) const;
+    // Authenticates several statements and combines the tokens into a single proof, see multiproof.h.
+    void authenticateMulti(MultiProof& proof, const std::vector<ct_t>& cts, const std::vector<st_t>& sts) const;
+    // Verifies a proof for all given assertions at once. Every shared path node is evaluated
+    // only once, and the hashes on each level share a single field inversion.
+    bool verifyMulti(const MultiProof& proof, const std::vector<ct_t>& cts, const std::vector<st_t>& sts) const;
+
+    // Authenticates or verifies many statements, distributed over the threads of pool.
+    void authenticateMany(std::vector<token_t>& ts, const std::vector<ct_t>& cts, const std::vector<st_t>& sts, WorkStealingPool& pool) const;
+    std::vector<bool> verifyMany(const std::vector<token_t>& ts, const std::vector<ct_t>& cts, const std::vector<st_t>& sts, WorkStealingPool& pool) const;
     void extract(const token_t& t1, const token_t& t2, const ct_t& ct, const st_t& st1, const st_t& st2);
+    void extract(const TokenView& t1, const TokenView& t2, const ct_t& ct, const st_t& st1, const st_t& st2);
+    // Same as above for statements given by their digests, see ChameleonHash::digest.
+    void extract(const TokenView& t1, const TokenView& t2, const ct_t& ct, const ChameleonHash::digest_t& d1, const ChameleonHash::digest_t& d2);
+    // Extracts the secret keys for many pairs of tokens at once, the i-th pair under dpks[i].
+    // Pairs that collide on the leaf level share a single scalar inversion. Returns for each
+    // pair whether extraction succeeded, and in this case the secret key in dsks[i].
+    static std::vector<bool> extractBatch(std::vector<dsk_t>& dsks, const std::vector<dpk_t>& dpks, const std::vector<TokenView>& t1s, const std::vector<TokenView>& t2s,
+                                          const std::vector<ct_t>& cts, const std::vector<ChameleonHash::digest_t>& d1s, const std::vector<ChameleonHash::digest_t>& d2s);
+    static std::vector<bool> extractBatch(std::vector<dsk_t>& dsks, const std::vector<dpk_t>& dpks, const std::vector<token_t>& t1s, const std::vector<token_t>& t2s,
+                                          const std::vector<ct_t>& cts, const std::vector<st_t>& st1s, const std::vector<st_t>& st2s);
+
+    // Use precomputed chameleon hashes of the top levels of the tree when authenticating.
+    // The cache must have been created for the key of this authenticator.
+    void setTreeCache(std::shared_ptr<const TreeCache> cache);
 
-    Authenticator::dpk_t getDpk();
-    Authenticator::dsk_t getDsk();
+    // Let verify() stop early when it reaches a node that is known to be valid from
+    // an earlier verification. The cache must have been created for the key of this authenticator.
+    void setVerifiedNodeCache(std::shared_ptr<VerifiedNodeCache> cache);
+
+    dpk_t getDpk() const;
+    dsk_t getDsk() const;
 
 
 private:
+    // Statements per chunk in authenticateMany() and authenticateMulti(), a multiple of
+    // the lanes of ScalarMulti.
+    static const size_t AUTHENTICATE_CHUNK = 16;
+
+    friend class BasicStreamingVerifier<CtLen>;
+
     dsk_t dsk;
     ChameleonHash::digest_t rootDigest;
 
     ChameleonHash ch;
+    // keyed once, computePath() is called for every authentication
+    Prf prf;
     bool hasSecretKey_;
+    std::shared_ptr<const TreeCache> treeCache;
+    std::shared_ptr<VerifiedNodeCache> verifiedNodes;
+
+    // Computes the entries [begin, end) of path. The PRF values of siblings on
+    // levels covered by the tree cache are not computed.
+    void computePath(path_t& path, const ct_t& ct, size_t begin, size_t end) const;
+    void finishToken(token_t& t, const path_t& path, const ct_t& ct, const ChameleonHash::digest_t& stDigest) const;
+    // Same as finishToken() for n tokens, which are processed level by level, so that the
+    // collisions and digests of a level are computed by the bulk functions of ChameleonHash.
+    void finishTokens(token_t* ts, const path_t* paths, const ct_t* cts, const ChameleonHash::digest_t* stDigests, size_t n) const;
+    // Authenticates n statements. The paths are computed with one task per statement on
+    // pool, or on the calling thread if pool is null, and then the chains of chunks of
+    // AUTHENTICATE_CHUNK statements with finishTokens().
+    void authenticateChunks(token_t* ts, const ct_t* cts, const st_t* sts, size_t n, WorkStealingPool* pool) const;
 
     struct log_t {
         std::vector<ChameleonHash::hash_t> chs;
         std::vector<ChameleonHash::digest_t> xs;
     };
-    bool verifyWithLog(const token_t& t, const ct_t& ct, const st_t &st, log_t* log);
+    // Token is token_t or TokenView. Statements are given by their digests.
+    template<typename Token>
+    bool verifyWithLog(const Token& t, const ct_t& ct, const ChameleonHash::digest_t& stDigest, log_t* log) const;
+    template<typename Token>
+    void extractFrom(const Token& t1, const Token& t2, const ct_t& ct, const ChameleonHash::digest_t& d1, const ChameleonHash::digest_t& d2);
+    // Extracts the key from the lowest level on which the paths of t1 and t2 collide.
+    template<typename Token>
+    void findCollision(const Token& t1, const Token& t2, const ct_t& ct, const ChameleonHash::digest_t& d1, const ChameleonHash::digest_t& d2);
+    template<typename Token>
+    static std::vector<bool> extractBatchFrom(std::vector<dsk_t>& dsks, const std::vector<dpk_t>& dpks, const std::vector<Token>& t1s, const std::vector<Token>& t2s,
+                                              const std::vector<ct_t>& cts, const std::vector<ChameleonHash::digest_t>& d1s, const std::vector<ChameleonHash::digest_t>& d2s);
 };
 
+// The context length of Authenticator is configurable via the ACCA_CT_LEN variable in cmake.
+typedef BasicAuthenticator<ACCA_CT_LEN> Authenticator;
+
 #endif // AUTHENTICATOR_H
@@ -0,0 +1,228 @@
+/*
+ * Copyright (c) 2015 Tim Ruffing <tim.ruffing@mmci.uni-saarland.de>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#include "batchscheduler.h"
+#include "workstealingpool.h"
+
+#include <algorithm>
+#include <exception>
+#include <iterator>
+#include <stdexcept>
+
+BatchScheduler::BatchScheduler(const Authenticator& acca, WorkStealingPool& pool, const config_t& config)
+    : acca(acca), pool(pool), config(config), batches(0), stopping(false)
+{
+    if (config.maxBatch == 0) {
+        throw std::invalid_argument("maxBatch must be positive");
+    }
+    for (size_t k = 0; k < KINDS; k++) {
+        limits[k] = 1;
+        processed[k] = 0;
+    }
+    dispatcher = std::thread(&BatchScheduler::dispatch, this);
+}
+
+BatchScheduler::~BatchScheduler()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wakeup.notify_one();
+    dispatcher.join();
+}
+
+std::future<Authenticator::token_t> BatchScheduler::submitAuthenticate(const Authenticator::ct_t& ct, const Authenticator::st_t& st)
+{
+    request_t request;
+    request.ct = ct;
+    request.st = st;
+    std::future<Authenticator::token_t> res = request.token.get_future();
+    submit(AUTHENTICATE, std::move(request));
+    return res;
+}
+
+std::future<bool> BatchScheduler::submitVerify(const Authenticator::token_t& t, const Authenticator::ct_t& ct, const Authenticator::st_t& st)
+{
+    request_t request;
+    request.t = t;
+    request.ct = ct;
+    request.st = st;
+    std::future<bool> res = request.valid.get_future();
+    submit(VERIFY, std::move(request));
+    return res;
+}
+
+BatchScheduler::stats_t BatchScheduler::getStats() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    stats_t res;
+    res.authentications = processed[AUTHENTICATE];
+    res.verifications = processed[VERIFY];
+    res.batches = batches;
+    res.authenticateLimit = limits[AUTHENTICATE];
+    res.verifyLimit = limits[VERIFY];
+    return res;
+}
+
+void BatchScheduler::submit(kind_t kind, request_t&& request)
+{
+    request.arrival = std::chrono::steady_clock::now();
+    bool notify;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (stopping) {
+            throw std::logic_error("scheduler is stopping");
+        }
+        pending[kind].push_back(std::move(request));
+        // the dispatcher only needs to wake up for the first request or a full batch
+        notify = pending[kind].size() == 1 || pending[kind].size() == limits[kind];
+    }
+    if (notify) {
+        wakeup.notify_one();
+    }
+}
+
+void BatchScheduler::dispatch()
+{
+    std::vector<request_t> batch;
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+
+        // choose the kind whose oldest request arrived first among the ready ones
+        int ready = -1;
+        for (size_t k = 0; k < KINDS; k++) {
+            if (pending[k].empty()) {
+                continue;
+            }
+            std::chrono::steady_clock::time_point due = pending[k].front().arrival + config.maxDelay;
+            if (stopping || pending[k].size() >= limits[k] || due <= now) {
+                if (ready < 0 || pending[k].front().arrival < pending[ready].front().arrival) {
+                    ready = k;
+                }
+            } else {
+                deadline = std::min(deadline, due);
+            }
+        }
+
+        if (ready < 0) {
+            if (stopping) {
+                return;
+            }
+            if (deadline == std::chrono::steady_clock::time_point::max()) {
+                wakeup.wait(lock);
+            } else {
+                wakeup.wait_until(lock, deadline);
+            }
+            continue;
+        }
+
+        kind_t kind = (kind_t) ready;
+        std::deque<request_t>& queue = pending[kind];
+        size_t limit = limits[kind];
+        size_t n = std::min(queue.size(), limit);
+        batch.clear();
+        for (size_t i = 0; i < n; i++) {
+            batch.push_back(std::move(queue.front()));
+            queue.pop_front();
+        }
+
+        // adapt the limit for the next batch
+        if (!queue.empty()) {
+            limits[kind] = std::min(2 * limit, config.maxBatch);
+        } else if (n < limit) {
+            limits[kind] = std::max(limit / 2, (size_t) 1);
+        }
+
+        lock.unlock();
+        process(kind, batch);
+        lock.lock();
+    }
+}
+
+void BatchScheduler::process(kind_t kind, std::vector<request_t>& batch)
+{
+    size_t n = batch.size();
+    std::vector<Authenticator::token_t> ts(kind == VERIFY ? n : 0);
+    std::vector<Authenticator::ct_t> cts(n);
+    std::vector<Authenticator::st_t> sts(n);
+    for (size_t i = 0; i < n; i++) {
+        if (kind == VERIFY) {
+            ts[i] = std::move(batch[i].t);
+        }
+        cts[i] = batch[i].ct;
+        sts[i] = std::move(batch[i].st);
+    }
+
+    // results of verification in the order of the batch
+    std::vector<bool> results;
+    std::exception_ptr error;
+    try {
+        if (kind == AUTHENTICATE) {
+            acca.authenticateMany(ts, cts, sts, pool);
+        } else {
+            // every thread of the pool verifies a contiguous chunk with shared inversions
+            size_t chunks = std::min((size_t) pool.size(), n);
+            std::vector<std::vector<bool>> valid(chunks);
+            pool.parallelFor(chunks, [&](size_t c) {
+                size_t begin = n * c / chunks, end = n * (c + 1) / chunks;
+                valid[c] = acca.verifyBatch(
+                    std::vector<Authenticator::token_t>(std::make_move_iterator(ts.begin() + begin), std::make_move_iterator(ts.begin() + end)),
+                    std::vector<Authenticator::ct_t>(cts.begin() + begin, cts.begin() + end),
+                    std::vector<Authenticator::st_t>(std::make_move_iterator(sts.begin() + begin), std::make_move_iterator(sts.begin() + end)));
+            });
+            for (size_t c = 0; c < chunks; c++) {
+                results.insert(results.end(), valid[c].begin(), valid[c].end());
+            }
+        }
+    } catch (...) {
+        error = std::current_exception();
+    }
+
+    // count the batch before any caller can see its results, so that the stats
+    // include the requests of every fulfilled future
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        processed[kind] += n;
+        batches++;
+    }
+    for (size_t i = 0; i < n; i++) {
+        if (error) {
+            if (kind == AUTHENTICATE) {
+                batch[i].token.set_exception(error);
+            } else {
+                batch[i].valid.set_exception(error);
+            }
+        } else if (kind == AUTHENTICATE) {
+            batch[i].token.set_value(ts[i]);
+        } else {
+            batch[i].valid.set_value(results[i]);
+        }
+    }
+}
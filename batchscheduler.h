@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) 2015 Tim Ruffing <tim.ruffing@mmci.uni-saarland.de>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#ifndef BATCHSCHEDULER_H
+#define BATCHSCHEDULER_H
+
+#include "authenticator.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class WorkStealingPool;
+
+// Collects authenticate and verify requests that arrive one at a time into batches,
+// which are processed by the batched operations of Authenticator on a worker pool.
+// A batch is closed when it reaches the current batch limit or when its oldest request
+// has waited for maxDelay. The limit adapts to the load: it doubles whenever requests are
+// left over after a batch has been taken and halves whenever a batch is closed by the
+// deadline below the limit.
+// Under light load, the limit thus drops to one and requests are processed immediately,
+// and under heavy load, requests arriving during a batch make up the next one.
+class BatchScheduler
+{
+public:
+    struct config_t {
+        // upper bound for the batch limit
+        size_t maxBatch;
+        // how long a request may wait for its batch to fill up
+        std::chrono::microseconds maxDelay;
+
+        config_t() : maxBatch(256), maxDelay(200) { }
+    };
+
+    struct stats_t {
+        uint64_t authentications;
+        uint64_t verifications;
+        uint64_t batches;
+        // current batch limits
+        size_t authenticateLimit;
+        size_t verifyLimit;
+    };
+
+    // acca and pool must outlive the scheduler. The dispatcher thread of the scheduler
+    // calls pool.parallelFor(), so other users of the pool are serialized with it.
+    BatchScheduler(const Authenticator& acca, WorkStealingPool& pool, const config_t& config);
+    // Processes all pending requests and stops the dispatcher thread.
+    ~BatchScheduler();
+    BatchScheduler(const BatchScheduler&) = delete;
+    BatchScheduler& operator=(const BatchScheduler&) = delete;
+
+    // Exceptions thrown by the batched operations are delivered through the futures.
+    std::future<Authenticator::token_t> submitAuthenticate(const Authenticator::ct_t& ct, const Authenticator::st_t& st);
+    std::future<bool> submitVerify(const Authenticator::token_t& t, const Authenticator::ct_t& ct, const Authenticator::st_t& st);
+
+    stats_t getStats() const;
+
+private:
+    enum kind_t { AUTHENTICATE, VERIFY, KINDS };
+
+    struct request_t {
+        Authenticator::token_t t;
+        Authenticator::ct_t ct;
+        Authenticator::st_t st;
+        std::chrono::steady_clock::time_point arrival;
+        std::promise<Authenticator::token_t> token;
+        std::promise<bool> valid;
+    };
+
+    const Authenticator& acca;
+    WorkStealingPool& pool;
+    const config_t config;
+
+    // protects the following members
+    mutable std::mutex mutex;
+    std::condition_variable wakeup;
+    std::deque<request_t> pending[KINDS];
+    size_t limits[KINDS];
+    uint64_t processed[KINDS];
+    uint64_t batches;
+    bool stopping;
+
+    std::thread dispatcher;
+
+    void submit(kind_t kind, request_t&& request);
+    void dispatch();
+    void process(kind_t kind, std::vector<request_t>& batch);
+};
+
+#endif // BATCHSCHEDULER_H
@@ -0,0 +1,175 @@
+/*
+ * Copyright (c) 2015 Tim Ruffing <tim.ruffing@mmci.uni-saarland.de>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#ifndef BOUNDEDQUEUE_H
+#define BOUNDEDQUEUE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <utility>
+
+// A bounded lock-free multi-producer multi-consumer queue. Every cell carries a
+// sequence number that tells producers and consumers whether it is free or filled
+// for their round, so push and pop need a single compare-and-swap each
+// (D. Vyukov's bounded MPMC queue).
+//
+// The blocking push and pop spin for a short while and then back off with short
+// sleeps, which gives backpressure to producers if consumers are slow. close() must
+// be called after all pushes have returned. Afterwards, pop fails once the queue is empty.
+template<typename T>
+class BoundedQueue
+{
+public:
+    // The capacity is rounded up to a power of two.
+    BoundedQueue(size_t capacity) : enqueuePos(0), dequeuePos(0), closed(false) {
+        size_t size = 2;
+        while (size < capacity) {
+            size *= 2;
+        }
+        mask = size - 1;
+        cells.reset(new cell_t[size]);
+        for (size_t i = 0; i < size; i++) {
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+    bool tryPush(T& value) {
+        size_t pos = enqueuePos.load(std::memory_order_relaxed);
+        for (;;) {
+            cell_t& cell = cells[pos & mask];
+            size_t seq = cell.sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t) seq - (intptr_t) pos;
+            if (diff == 0) {
+                if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    cell.value = std::move(value);
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                // full
+                return false;
+            } else {
+                pos = enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool tryPop(T& value) {
+        size_t pos = dequeuePos.load(std::memory_order_relaxed);
+        for (;;) {
+            cell_t& cell = cells[pos & mask];
+            size_t seq = cell.sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t) seq - (intptr_t) (pos + 1);
+            if (diff == 0) {
+                if (dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    value = std::move(cell.value);
+                    cell.sequence.store(pos + mask + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                // empty
+                return false;
+            } else {
+                pos = dequeuePos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Blocks while the queue is full. Returns false if the queue has been closed.
+    bool push(T& value) {
+        for (unsigned spins = 0; !closed.load(std::memory_order_acquire); spins++) {
+            if (tryPush(value)) {
+                return true;
+            }
+            backoff(spins);
+        }
+        return false;
+    }
+
+    // Blocks while the queue is empty. Returns false if the queue has been closed and is empty.
+    bool pop(T& value) {
+        for (unsigned spins = 0; ; spins++) {
+            if (tryPop(value)) {
+                return true;
+            }
+            if (closed.load(std::memory_order_acquire)) {
+                // elements pushed before close() are visible now
+                return tryPop(value);
+            }
+            backoff(spins);
+        }
+    }
+
+    void close() {
+        closed.store(true, std::memory_order_release);
+    }
+
+    // Approximate number of elements.
+    size_t size() const {
+        size_t enq = enqueuePos.load(std::memory_order_relaxed);
+        size_t deq = dequeuePos.load(std::memory_order_relaxed);
+        return enq > deq ? enq - deq : 0;
+    }
+
+    size_t capacity() const {
+        return mask + 1;
+    }
+
+private:
+    struct cell_t {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    std::unique_ptr<cell_t[]> cells;
+    size_t mask;
+    // Padding keeps producers and consumers on separate cache lines. (alignas would
+    // need an aligned operator new, which C++11 does not guarantee.)
+    char pad0[64];
+    std::atomic<size_t> enqueuePos;
+    char pad1[64 - sizeof(std::atomic<size_t>)];
+    std::atomic<size_t> dequeuePos;
+    char pad2[64 - sizeof(std::atomic<size_t>)];
+    std::atomic<bool> closed;
+
+    static void backoff(unsigned spins) {
+        if (spins < 64) {
+            std::this_thread::yield();
+        } else {
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+    }
+};
+
+#endif // BOUNDEDQUEUE_H
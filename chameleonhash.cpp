@@ -25,20 +25,32 @@
  */
 
 #include "chameleonhash.h"
+#include "fixedbasetable.h"
+#include "instrumentation.h"
+#include "scalarmulti.h"
+#include "sha256.h"
+#include "sha256multi.h"
 
 #include <vector>
 #include <algorithm>
+#include <mutex>
 
 void ChameleonHash::initialize()
 {
     // the following two initialization functions
-    // ensure already by themselves that they do their work only once
-    secp256k1_ecmult_gen_start();
-    secp256k1_ecmult_start();
+    // ensure already by themselves that they do their work only once,
+    // but they must not run concurrently
+    static std::once_flag initialized;
+    std::call_once(initialized, []() {
+        secp256k1_ecmult_gen_start();
+        secp256k1_ecmult_start();
+    });
 }
 
 
-ChameleonHash::ChameleonHash(const pk_t& pk) : hasSecretKey_(false)
+ChameleonHash::ChameleonHash(const pk_t& pk) : ChameleonHash(pk, false) { }
+
+ChameleonHash::ChameleonHash(const pk_t& pk, bool precomputePk) : hasSecretKey_(false)
 {
     secp256k1_ge_t pkge;
 
@@ -51,6 +63,10 @@ ChameleonHash::ChameleonHash(const pk_t& pk) : hasSecretKey_(false)
     }
 
     secp256k1_gej_set_ge(&this->pk, &pkge);
+
+    if (precomputePk) {
+        pkTable = std::make_shared<FixedBaseTable>(this->pk);
+    }
 }
 
 
@@ -64,14 +80,18 @@ ChameleonHash::ChameleonHash(const sk_t &sk) : hasSecretKey_(true)
     }
     // compute public key
     secp256k1_ecmult_gen(&this->pk, &this->sk);
+    ACCA_COUNT(EC_MULT_GEN, 1);
 
     secp256k1_scalar_inverse(&this->skInv, &this->sk);
+    ACCA_COUNT(INVERSIONS, 1);
 }
 
-ChameleonHash::pk_t ChameleonHash::getPk(bool compressed)
+ChameleonHash::pk_t ChameleonHash::getPk(bool compressed) const
 {
     secp256k1_ge_t pkge;
-    secp256k1_ge_set_gej_var(&pkge, &this->pk);
+    // secp256k1_ge_set_gej_var modifies its input
+    secp256k1_gej_t pkgej = this->pk;
+    secp256k1_ge_set_gej_var(&pkge, &pkgej);
 
     pk_t res;
     res.resize(65);
@@ -81,7 +101,7 @@ ChameleonHash::pk_t ChameleonHash::getPk(bool compressed)
     return res;
 }
 
-ChameleonHash::sk_t ChameleonHash::getSk()
+ChameleonHash::sk_t ChameleonHash::getSk() const
 {
     if (!hasSecretKey_) {
         throw std::logic_error("no secret key available");
@@ -93,8 +113,35 @@ ChameleonHash::sk_t ChameleonHash::getSk()
 
 
 
-void ChameleonHash::ch(hash_t& res, const digest_t& m, const rand_t& r)
+void ChameleonHash::ch(hash_t& res, const digest_t& m, const rand_t& r) const
+{
+    secp256k1_gej_t resgej;
+    secp256k1_ge_t resge;
+
+    int hash_len = 0;
+
+    chJacobian(resgej, m, r);
+    ACCA_PHASE(PHASE_SERIALIZE);
+    secp256k1_ge_set_gej(&resge, &resgej);
+    ACCA_COUNT(INVERSIONS, 1);
+
+    if (!secp256k1_eckey_pubkey_serialize(&resge, res.data(), &hash_len, 1) || hash_len != HASH_LEN) {
+        throw std::logic_error("cannot serialize chameleon hash");
+    }
+}
+
+void ChameleonHash::ch(hash_t* res, const digest_t* ms, const rand_t* rs, size_t n) const
 {
+    std::vector<secp256k1_gej_t> points(n);
+    for (size_t i = 0; i < n; i++) {
+        chJacobian(points[i], ms[i], rs[i]);
+    }
+    serialize(res, points.data(), n);
+}
+
+void ChameleonHash::chJacobian(secp256k1_gej_t& res, const digest_t& m, const rand_t& r) const
+{
+    ACCA_PHASE(PHASE_EC_MULT);
     // m cannot overflow, this is ensured by the public ch() method
     secp256k1_scalar_t ms;
     secp256k1_scalar_set_b32(&ms, m.data(), nullptr);
@@ -107,28 +154,173 @@ void ChameleonHash::ch(hash_t& res, const digest_t& m, const rand_t& r)
         throw std::invalid_argument("overflow in randomness");
     }
 
-    secp256k1_gej_t resgej;
-    secp256k1_ge_t resge;
-
-    int hash_len = 0;
-
     if (this->hasSecretKey_) {
         // now we (ab)use the rs variable to compute the result
         secp256k1_scalar_mul(&rs, &rs, &this->sk);
         secp256k1_scalar_add(&rs, &rs, &ms);
-        secp256k1_ecmult_gen(&resgej, &rs);
+        secp256k1_ecmult_gen(&res, &rs);
+        ACCA_COUNT(EC_MULT_GEN, 1);
+    }
+    else if (pkTable) {
+        // two fixed-base multiplications are faster than secp256k1_ecmult,
+        // which has to build a table for pk on every call
+        secp256k1_gej_t gm;
+        pkTable->mul(res, rs);
+        secp256k1_ecmult_gen(&gm, &ms);
+        secp256k1_gej_add_var(&res, &res, &gm);
+        ACCA_COUNT(EC_MULT, 1);
+        ACCA_COUNT(EC_MULT_GEN, 1);
     }
     else {
-        secp256k1_ecmult(&resgej, &this->pk, &rs, &ms);
+        secp256k1_ecmult(&res, &this->pk, &rs, &ms);
+        ACCA_COUNT(EC_MULT, 1);
     }
-    secp256k1_ge_set_gej(&resge, &resgej);
+}
 
-    if (!secp256k1_eckey_pubkey_serialize(&resge, res.data(), &hash_len, 1) || hash_len != HASH_LEN) {
-        throw std::logic_error("cannot serialize chameleon hash");
+void ChameleonHash::serialize(hash_t* res, const secp256k1_gej_t* points, size_t n)
+{
+    // secp256k1_ge_set_all_gej_var shares one inversion among all points (Montgomery's trick).
+    // It is not constant-time but all chameleon hashes end up in public tokens anyway.
+    if (n == 0) {
+        return;
+    }
+    ACCA_PHASE(PHASE_SERIALIZE);
+    std::vector<secp256k1_ge_t> ges(n);
+    secp256k1_ge_set_all_gej_var(n, ges.data(), points);
+    ACCA_COUNT(INVERSIONS, 1);
+
+    for (size_t i = 0; i < n; i++) {
+        int hash_len = 0;
+        if (!secp256k1_eckey_pubkey_serialize(&ges[i], res[i].data(), &hash_len, 1) || hash_len != HASH_LEN) {
+            throw std::logic_error("cannot serialize chameleon hash");
+        }
+    }
+}
+
+namespace {
+// Coefficients of the random linear combination in ChameleonHash::verify(). With 128 bits,
+// a combination of invalid hashes passes with probability at most 2^-128.
+const size_t COEFF_LEN = 16;
+typedef std::array<unsigned char, COEFF_LEN> coeff_t;
+
+// res = zs[0]*points[0] + ... + zs[n-1]*points[n-1] with Strauss' method: every point gets
+// a table of its first 15 multiples, and all points share the doublings of a walk over the
+// 4-bit windows of the (big-endian) coefficients.
+void multiMul(secp256k1_gej_t& res, const secp256k1_ge_t* points, const coeff_t* zs, size_t n)
+{
+    const size_t WINDOW_BITS = 4;
+    const size_t ENTRIES = (1 << WINDOW_BITS) - 1;
+    std::vector<secp256k1_gej_t> multiples(n * ENTRIES);
+    for (size_t i = 0; i < n; i++) {
+        // multiple[j-1] = j * points[i]
+        secp256k1_gej_t* multiple = &multiples[i * ENTRIES];
+        secp256k1_gej_set_ge(&multiple[0], &points[i]);
+        for (size_t j = 1; j < ENTRIES; j++) {
+            secp256k1_gej_add_ge_var(&multiple[j], &multiple[j-1], &points[i]);
+        }
+    }
+    // normalize all entries using a single field inversion
+    std::vector<secp256k1_ge_t> table(multiples.size());
+    secp256k1_ge_set_all_gej_var(table.size(), table.data(), multiples.data());
+    ACCA_COUNT(INVERSIONS, 1);
+
+    secp256k1_gej_set_infinity(&res);
+    for (size_t w = 2 * COEFF_LEN; w-- > 0;) {
+        if (!secp256k1_gej_is_infinity(&res)) {
+            for (size_t j = 0; j < WINDOW_BITS; j++) {
+                secp256k1_gej_double_var(&res, &res);
+            }
+        }
+        for (size_t i = 0; i < n; i++) {
+            unsigned int bits = (zs[i][COEFF_LEN - 1 - w/2] >> (WINDOW_BITS * (w % 2))) & 0xF;
+            if (bits) {
+                secp256k1_gej_add_ge_var(&res, &res, &table[i * ENTRIES + bits - 1]);
+            }
+        }
+    }
+}
+}
+
+bool ChameleonHash::verify(const hash_t* chs, const digest_t* ms, const rand_t* rs, size_t n) const
+{
+    if (n == 0) {
+        return true;
+    }
+    // The coefficients z_i are derived from all inputs, so they are fixed only after the
+    // inputs are. Then sum z_i*ch_i == (sum z_i*m_i)*G + (sum z_i*r_i)*pk implies
+    // ch_i == m_i*G + r_i*pk for all i, except with negligible probability.
+    Sha256 seedHash;
+    for (size_t i = 0; i < n; i++) {
+        seedHash.write(chs[i].data(), HASH_LEN);
+        seedHash.write(ms[i].data(), MESG_LEN);
+        seedHash.write(rs[i].data(), RAND_LEN);
     }
+    unsigned char seed[Sha256::OUT_LEN];
+    seedHash.finalize(seed);
+
+    std::vector<secp256k1_ge_t> points(n);
+    std::vector<coeff_t> zs(n);
+    secp256k1_scalar_t mSum, rSum;
+    secp256k1_scalar_set_int(&mSum, 0);
+    secp256k1_scalar_set_int(&rSum, 0);
+    for (size_t i = 0; i < n; i++) {
+        // reject everything that serialize() cannot output
+        hash_t encoding;
+        int hash_len = 0;
+        if (!secp256k1_eckey_pubkey_parse(&points[i], chs[i].data(), HASH_LEN)) {
+            return false;
+        }
+        secp256k1_ge_t point = points[i];
+        if (!secp256k1_eckey_pubkey_serialize(&point, encoding.data(), &hash_len, 1) || hash_len != HASH_LEN || encoding != chs[i]) {
+            return false;
+        }
+
+        int overflow;
+        secp256k1_scalar_t m, r, z;
+        // as in chJacobian(), digests are reduced silently
+        secp256k1_scalar_set_b32(&m, ms[i].data(), nullptr);
+        secp256k1_scalar_set_b32(&r, rs[i].data(), &overflow);
+        if (overflow) {
+            return false;
+        }
+
+        unsigned char index[8], zb32[32] = { 0 };
+        for (size_t j = 0; j < 8; j++) {
+            index[j] = (uint64_t) i >> (56 - 8*j);
+        }
+        Sha256 zHash;
+        zHash.write(seed, sizeof(seed));
+        zHash.write(index, sizeof(index));
+        unsigned char zFull[Sha256::OUT_LEN];
+        zHash.finalize(zFull);
+        std::copy(zFull, zFull + COEFF_LEN, zs[i].begin());
+        std::copy(zs[i].begin(), zs[i].end(), zb32 + 32 - COEFF_LEN);
+        secp256k1_scalar_set_b32(&z, zb32, nullptr);
+
+        secp256k1_scalar_mul(&m, &m, &z);
+        secp256k1_scalar_add(&mSum, &mSum, &m);
+        secp256k1_scalar_mul(&r, &r, &z);
+        secp256k1_scalar_add(&rSum, &rSum, &r);
+    }
+
+    secp256k1_gej_t lhs, rhs;
+    {
+        ACCA_PHASE(PHASE_EC_MULT);
+        multiMul(lhs, points.data(), zs.data(), n);
+        ACCA_COUNT(EC_MULT, 1);
+    }
+    digest_t mBytes;
+    rand_t rBytes;
+    secp256k1_scalar_get_b32(mBytes.data(), &mSum);
+    secp256k1_scalar_get_b32(rBytes.data(), &rSum);
+    chJacobian(rhs, mBytes, rBytes);
+
+    secp256k1_gej_neg(&rhs, &rhs);
+    secp256k1_gej_add_var(&lhs, &lhs, &rhs);
+    return secp256k1_gej_is_infinity(&lhs);
 }
 
-void ChameleonHash::ch(hash_t& res, const mesg_t& m, const rand_t& r)
+void ChameleonHash::ch(hash_t& res, const mesg_t& m, const rand_t& r) const
 {
     digest_t d;
     digest(d, m);
@@ -158,48 +350,110 @@ void ChameleonHash::extract(const mesg_t& m1, const rand_t& r1, const digest_t&
 
 void ChameleonHash::extract(const digest_t& d1, const rand_t& r1, const digest_t& d2, const rand_t& r2)
 {
-    // verify that the input is indeed a collision
-    hash_t ch1, ch2;
-    ch(ch1, d1, r1);
-    ch(ch2, d2, r2);
-    if ((r1 == r2 && d1 == d2) || ch1 != ch2) {
+    if (!tryExtract(d1, r1, d2, r2)) {
         throw std::invalid_argument("not a collision");
     }
+}
 
-    // Overflows in the following secp256k1_scalar_set_b32 calls
-    // would have been already caught by ch() evaluation above.
-
-    // d1+sk*r1 == d2+sk*r2 ==> 1/sk = (r1-r2)/(d2-d1)
-    secp256k1_scalar_t tmp;
-    secp256k1_scalar_t r1s;
-
-    // set this->sk_inv = 1/(d2-d1)
-    secp256k1_scalar_set_b32(&this->skInv, d1.data(), nullptr);
-    secp256k1_scalar_negate(&this->skInv, &this->skInv);
-    secp256k1_scalar_set_b32(&tmp, d2.data(), nullptr);
-    secp256k1_scalar_add(&this->skInv, &this->skInv, &tmp);
-    secp256k1_scalar_inverse_var(&this->skInv, &this->skInv);
-
-    // set tmp = r2-r1
-    secp256k1_scalar_set_b32(&tmp, r2.data(), nullptr);
-    secp256k1_scalar_negate(&tmp, &tmp);
-    secp256k1_scalar_set_b32(&r1s, r1.data(), nullptr);
-    secp256k1_scalar_add(&tmp, &tmp, &r1s);
-
-    // set this->sk_inv = (r1-r2)/(d2-d1)
-    secp256k1_scalar_mul(&this->skInv, &this->skInv, &tmp);
+bool ChameleonHash::tryExtract(const digest_t& d1, const rand_t& r1, const digest_t& d2, const rand_t& r2)
+{
+    ChameleonHash* self = this;
+    return tryExtract(&self, &d1, &r1, &d2, &r2, 1)[0];
+}
 
-    // set this->sk = 1/sk_inv
-    secp256k1_scalar_inverse(&this->sk, &this->skInv);
+std::vector<bool> ChameleonHash::tryExtract(ChameleonHash* const* chs, const digest_t* d1s, const rand_t* r1s, const digest_t* d2s, const rand_t* r2s, size_t n)
+{
+    // d1+sk*r1 == d2+sk*r2 ==> sk = (d1-d2)/(r2-r1) and 1/sk = (r2-r1)/(d1-d2)
+    std::vector<bool> ok(n, false);
+    std::vector<size_t> candidates;
+    // num and den of every candidate, inverted in place
+    std::vector<secp256k1_scalar_t> fractions;
+    std::vector<secp256k1_scalar_t> nums, dens;
+    for (size_t i = 0; i < n; i++) {
+        secp256k1_scalar_t num, den, tmp;
+        int overflow;
+        secp256k1_scalar_set_b32(&num, d1s[i].data(), nullptr);
+        secp256k1_scalar_set_b32(&tmp, d2s[i].data(), nullptr);
+        secp256k1_scalar_negate(&tmp, &tmp);
+        secp256k1_scalar_add(&num, &num, &tmp);
+
+        secp256k1_scalar_set_b32(&den, r2s[i].data(), &overflow);
+        if (overflow) {
+            continue;
+        }
+        secp256k1_scalar_set_b32(&tmp, r1s[i].data(), &overflow);
+        if (overflow) {
+            continue;
+        }
+        secp256k1_scalar_negate(&tmp, &tmp);
+        secp256k1_scalar_add(&den, &den, &tmp);
+
+        // equal inputs or equal randomness cannot be a collision
+        if (secp256k1_scalar_is_zero(&num) || secp256k1_scalar_is_zero(&den)) {
+            continue;
+        }
+        candidates.push_back(i);
+        nums.push_back(num);
+        dens.push_back(den);
+    }
+    fractions.insert(fractions.end(), nums.begin(), nums.end());
+    fractions.insert(fractions.end(), dens.begin(), dens.end());
+    invertAll(fractions.data(), fractions.size());
+
+    const size_t m = candidates.size();
+    for (size_t j = 0; j < m; j++) {
+        ChameleonHash& ch = *chs[candidates[j]];
+        secp256k1_scalar_t sk, skInv;
+        secp256k1_scalar_mul(&sk, &nums[j], &fractions[m + j]);
+        secp256k1_scalar_mul(&skInv, &dens[j], &fractions[j]);
+
+        // check sk*G == pk
+        secp256k1_gej_t check, negPk;
+        secp256k1_ecmult_gen(&check, &sk);
+        ACCA_COUNT(EC_MULT_GEN, 1);
+        secp256k1_gej_neg(&negPk, &ch.pk);
+        secp256k1_gej_add_var(&check, &check, &negPk);
+        if (!secp256k1_gej_is_infinity(&check)) {
+            continue;
+        }
+        ch.sk = sk;
+        ch.skInv = skInv;
+        ch.hasSecretKey_ = true;
+        ok[candidates[j]] = true;
+    }
+    return ok;
+}
 
-    hasSecretKey_ = true;
+void ChameleonHash::invertAll(secp256k1_scalar_t* xs, size_t n)
+{
+    if (n == 0) {
+        return;
+    }
+    // prefixes[i] = xs[0] * ... * xs[i]
+    std::vector<secp256k1_scalar_t> prefixes(n);
+    prefixes[0] = xs[0];
+    for (size_t i = 1; i < n; i++) {
+        secp256k1_scalar_mul(&prefixes[i], &prefixes[i-1], &xs[i]);
+    }
+    secp256k1_scalar_t inv;
+    secp256k1_scalar_inverse_var(&inv, &prefixes[n-1]);
+    ACCA_COUNT(INVERSIONS, 1);
+    // now inv = 1/(xs[0] * ... * xs[i])
+    for (size_t i = n - 1; i > 0; i--) {
+        secp256k1_scalar_t xInv;
+        secp256k1_scalar_mul(&xInv, &inv, &prefixes[i-1]);
+        secp256k1_scalar_mul(&inv, &inv, &xs[i]);
+        xs[i] = xInv;
+    }
+    xs[0] = inv;
 }
 
-void ChameleonHash::collision(const ChameleonHash::digest_t& d1, const ChameleonHash::rand_t& r1, const ChameleonHash::digest_t& d2, ChameleonHash::rand_t& r2)
+void ChameleonHash::collision(const ChameleonHash::digest_t& d1, const ChameleonHash::rand_t& r1, const ChameleonHash::digest_t& d2, ChameleonHash::rand_t& r2) const
 {
     if (!hasSecretKey()) {
         throw std::logic_error("no secret key available");
     }
+    ACCA_PHASE(PHASE_COLLISION);
 
     // r2 = (d1-d2+sk*r1)/sk = (d1-d2)/sk + r1
 
@@ -231,7 +485,31 @@ void ChameleonHash::collision(const ChameleonHash::digest_t& d1, const Chameleon
     secp256k1_scalar_get_b32(r2.data(), &rs2);
 }
 
-void ChameleonHash::collision(const ChameleonHash::mesg_t& m1, const ChameleonHash::rand_t& r1, const ChameleonHash::mesg_t& m2, ChameleonHash::rand_t& r2)
+void ChameleonHash::collision(const digest_t* d1s, const rand_t* r1s, const digest_t* d2s, rand_t* r2s, size_t n) const
+{
+    if (!hasSecretKey()) {
+        throw std::logic_error("no secret key available");
+    }
+    ACCA_PHASE(PHASE_COLLISION);
+
+    for (size_t i = 0; i < n; i++) {
+        if (!ScalarMulti::isBelowOrder(d1s[i])) {
+            throw std::domain_error("overflow for digest of message 1");
+        }
+        if (!ScalarMulti::isBelowOrder(d2s[i])) {
+            throw std::domain_error("overflow for digest of message 2");
+        }
+        if (!ScalarMulti::isBelowOrder(r1s[i])) {
+            throw std::domain_error("overflow for randomness 1");
+        }
+    }
+    // r2 = (d1-d2)/sk + r1
+    ScalarMulti::scalar_t skInvBytes;
+    secp256k1_scalar_get_b32(skInvBytes.data(), &skInv);
+    ScalarMulti::subMulAdd(r2s, d1s, d2s, skInvBytes, r1s, n);
+}
+
+void ChameleonHash::collision(const ChameleonHash::mesg_t& m1, const ChameleonHash::rand_t& r1, const ChameleonHash::mesg_t& m2, ChameleonHash::rand_t& r2) const
 {
     digest_t d1, d2;
     digest(d1, m1);
@@ -239,14 +517,14 @@ void ChameleonHash::collision(const ChameleonHash::mesg_t& m1, const ChameleonHa
     collision(d1, r1, d2, r2);
 }
 
-void ChameleonHash::collision(const ChameleonHash::mesg_t& m1, const ChameleonHash::rand_t& r1, const ChameleonHash::digest_t& d2, ChameleonHash::rand_t& r2)
+void ChameleonHash::collision(const ChameleonHash::mesg_t& m1, const ChameleonHash::rand_t& r1, const ChameleonHash::digest_t& d2, ChameleonHash::rand_t& r2) const
 {
     digest_t d1;
     digest(d1, m1);
     collision(d1, r1, d2, r2);
 }
 
-void ChameleonHash::collision(const ChameleonHash::digest_t& d1, const ChameleonHash::rand_t& r1, const ChameleonHash::mesg_t& m2, ChameleonHash::rand_t& r2)
+void ChameleonHash::collision(const ChameleonHash::digest_t& d1, const ChameleonHash::rand_t& r1, const ChameleonHash::mesg_t& m2, ChameleonHash::rand_t& r2) const
 {
     digest_t d2;
     digest(d2, m2);
@@ -256,40 +534,99 @@ void ChameleonHash::collision(const ChameleonHash::digest_t& d1, const Chameleon
 
 void ChameleonHash::digest(digest_t &digest, const mesg_t &m)
 {
-    secp256k1_sha256_t sha;
-    secp256k1_scalar_t ms;
+    ChameleonHash::digest(digest, m.data(), m.size());
+}
 
-    const unsigned char* in = m.data();
-    size_t size = m.size();
+void ChameleonHash::digest(digest_t& digest, const unsigned char* m, size_t len)
+{
+    ACCA_PHASE(PHASE_DIGEST);
+    Sha256 sha;
+    sha.write(m, len);
+    sha.finalize(digest.data());
+    reduceDigest(digest);
+}
 
+void ChameleonHash::reduceDigest(digest_t& digest)
+{
+    secp256k1_scalar_t ms;
     int overflow;
-    do {
-        secp256k1_sha256_initialize(&sha);
-        secp256k1_sha256_write(&sha, in, size);
-        secp256k1_sha256_finalize(&sha, digest.data());
+    secp256k1_scalar_set_b32(&ms, digest.data(), &overflow);
+    while (overflow) {
+        ACCA_COUNT(DIGEST_RETRIES, 1);
+        Sha256 sha;
+        sha.write(digest.data(), digest.size());
+        sha.finalize(digest.data());
         secp256k1_scalar_set_b32(&ms, digest.data(), &overflow);
-        in = digest.data();
-        size = digest.size();
     }
-    while(overflow);
 }
 
 void ChameleonHash::digest(digest_t& digest, const ChameleonHash::hash_t& in1, const ChameleonHash::hash_t& in2)
 {
-    secp256k1_sha256_t hash;
-    secp256k1_sha256_initialize(&hash);
-    secp256k1_sha256_write(&hash, in1.data(), in1.size());
-    secp256k1_sha256_write(&hash, in2.data(), in2.size());
-    secp256k1_sha256_finalize(&hash, digest.data());
+    ACCA_PHASE(PHASE_DIGEST);
+    Sha256 hash;
+    hash.write(in1.data(), in1.size());
+    hash.write(in2.data(), in2.size());
+    hash.finalize(digest.data());
+}
+
+void ChameleonHash::digest(digest_t* res, const hash_t* in1, const hash_t* in2, size_t n)
+{
+    ACCA_PHASE(PHASE_DIGEST);
+    const size_t MSG_LEN = 2 * HASH_LEN;
+    std::vector<unsigned char> msgs(n * MSG_LEN);
+    std::vector<const unsigned char*> msgPtrs(n);
+    for (size_t i = 0; i < n; i++) {
+        unsigned char* msg = msgs.data() + i*MSG_LEN;
+        std::copy(in1[i].begin(), in1[i].end(), msg);
+        std::copy(in2[i].begin(), in2[i].end(), msg + HASH_LEN);
+        msgPtrs[i] = msg;
+    }
+
+    static_assert(MESG_LEN == Sha256Multi::OUT_LEN, "wrong digest length");
+    std::vector<unsigned char> out(n * MESG_LEN);
+    Sha256Multi::hash(out.data(), Sha256Multi::initial(), msgPtrs.data(), MSG_LEN, n);
+    for (size_t i = 0; i < n; i++) {
+        std::copy_n(out.data() + i*MESG_LEN, MESG_LEN, res[i].begin());
+    }
+}
+
+void ChameleonHash::randomOracle(hash_t* out, const hash_t* in1, const rand_t* in2, size_t n)
+{
+    static const Sha256Multi::hmac_key_t keyed = [] {
+        Sha256Multi::hmac_key_t key;
+        unsigned char k[] = "RandomOracleGRandomOracleGRandom";
+        Sha256Multi::hmacKey(key, k, 32);
+        return key;
+    }();
+    ACCA_PHASE(PHASE_DIGEST);
+
+    const size_t MSG_LEN = HASH_LEN + RAND_LEN;
+    std::vector<unsigned char> msgs(n * MSG_LEN);
+    std::vector<const unsigned char*> msgPtrs(n);
+    for (size_t i = 0; i < n; i++) {
+        unsigned char* msg = msgs.data() + i*MSG_LEN;
+        std::copy(in1[i].begin(), in1[i].end(), msg);
+        std::copy(in2[i].begin(), in2[i].end(), msg + HASH_LEN);
+        msgPtrs[i] = msg;
+    }
+
+    std::vector<unsigned char> res(n * Sha256Multi::OUT_LEN);
+    Sha256Multi::hmac(res.data(), keyed, msgPtrs.data(), MSG_LEN, n);
+    for (size_t i = 0; i < n; i++) {
+        std::copy_n(res.data() + i*Sha256Multi::OUT_LEN, Sha256Multi::OUT_LEN, out[i].begin());
+        out[i][32] = '\0';
+    }
 }
 
 void ChameleonHash::randomOracle(hash_t& out, const hash_t& in1, const rand_t& in2)
 {
-    secp256k1_hmac_sha256_t hmac;
-    unsigned char key[] = "RandomOracleGRandomOracleGRandom";
-    secp256k1_hmac_sha256_initialize(&hmac, key, 32);
-    secp256k1_hmac_sha256_write(&hmac, in1.data(), in1.size());
-    secp256k1_hmac_sha256_write(&hmac, in2.data(), in2.size());
-    secp256k1_hmac_sha256_finalize(&hmac, out.data());
+    // The key is constant, so the keyed state is computed only once.
+    static const unsigned char key[] = "RandomOracleGRandomOracleGRandom";
+    static const HmacSha256 keyed(key, 32);
+    ACCA_PHASE(PHASE_DIGEST);
+    HmacSha256 hmac = keyed;
+    hmac.write(in1.data(), in1.size());
+    hmac.write(in2.data(), in2.size());
+    hmac.finalize(out.data());
     out[32] = '\0';
 }
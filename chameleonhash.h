@@ -49,8 +49,12 @@
 #include "secp256k1/src/hash_impl.h"
 
 #include <array>
+#include <memory>
 #include <vector>
 
+class FixedBaseTable;
+class MessageDigester;
+
 class ChameleonHash
 {
 public:
@@ -72,37 +76,78 @@ public:
 
     ChameleonHash(const sk_t& sk);
     ChameleonHash(const pk_t& pk);
-    bool hasSecretKey() {
+    // If precomputePk is set, a FixedBaseTable for the public key is computed,
+    // which speeds up the evaluation of the chameleon hash on the public-key path.
+    ChameleonHash(const pk_t& pk, bool precomputePk);
+    bool hasSecretKey() const {
         return hasSecretKey_;
     }
 
-    pk_t getPk(bool compressed);
-    sk_t getSk();
-
-    void ch(hash_t& res, const mesg_t& m, const rand_t& r);
-    void ch(hash_t& res, const digest_t& m, const rand_t& r);
-
+    pk_t getPk(bool compressed) const;
+    sk_t getSk() const;
+
+    void ch(hash_t& res, const mesg_t& m, const rand_t& r) const;
+    void ch(hash_t& res, const digest_t& m, const rand_t& r) const;
+
+    // Computes n chameleon hashes at once. All points are computed first and then
+    // serialized together, which needs only a single field inversion.
+    void ch(hash_t* res, const digest_t* ms, const rand_t* rs, size_t n) const;
+
+    // Computes the chameleon hash without normalizing the resulting point,
+    // which is left in Jacobian coordinates. Use serialize() to obtain hash_t values.
+    void chJacobian(secp256k1_gej_t& res, const digest_t& m, const rand_t& r) const;
+    // Serializes n points in Jacobian coordinates using a single field inversion.
+    static void serialize(hash_t* res, const secp256k1_gej_t* points, size_t n);
+    // Checks chs[i] == ch(ms[i], rs[i]) for all i with a single randomized multi-scalar
+    // multiplication, which is much faster than evaluating the n hashes. Returns false if
+    // a check fails or if some chs[i] is not a canonical encoding of a point.
+    bool verify(const hash_t* chs, const digest_t* ms, const rand_t* rs, size_t n) const;
+
+    // Extracts the secret key from a collision, i.e., from two different pairs (d1, r1) and
+    // (d2, r2) with the same hash, and throws std::invalid_argument if they are not a collision.
+    // The hash is not evaluated; instead, the extracted key is checked against the public key.
     void extract(const digest_t& d1, const rand_t& r1, const digest_t& d2, const rand_t& r2);
     void extract(const mesg_t& m1, const rand_t& r1, const digest_t& d2, const rand_t& r2);
     void extract(const digest_t& d1, const rand_t& r1, const mesg_t& m2, const rand_t& r2);
     void extract(const mesg_t& m1, const rand_t& r1, const mesg_t& m2, const rand_t& r2);
-
-    void collision(const digest_t& d1, const rand_t& r1, const digest_t& d2, rand_t& r2);
-    void collision(const digest_t& d1, const rand_t& r1, const mesg_t& m2, rand_t& r2);
-    void collision(const mesg_t& m1, const rand_t& r1, const digest_t& d2, rand_t& r2);
-    void collision(const mesg_t& m1, const rand_t& r1, const mesg_t& m2, rand_t& r2);
+    // Same as extract but returns false instead of throwing.
+    bool tryExtract(const digest_t& d1, const rand_t& r1, const digest_t& d2, const rand_t& r2);
+    // Same as tryExtract for n collisions, the i-th one under the key of chs[i]. All scalar
+    // inversions are shared (Montgomery's trick). Returns the result for each collision.
+    static std::vector<bool> tryExtract(ChameleonHash* const* chs, const digest_t* d1s, const rand_t* r1s, const digest_t* d2s, const rand_t* r2s, size_t n);
+
+    void collision(const digest_t& d1, const rand_t& r1, const digest_t& d2, rand_t& r2) const;
+    void collision(const digest_t& d1, const rand_t& r1, const mesg_t& m2, rand_t& r2) const;
+    void collision(const mesg_t& m1, const rand_t& r1, const digest_t& d2, rand_t& r2) const;
+    void collision(const mesg_t& m1, const rand_t& r1, const mesg_t& m2, rand_t& r2) const;
+    // Bulk version of the above for n collisions under this key, using the SIMD kernels of
+    // ScalarMulti. r2s may alias r1s.
+    void collision(const digest_t* d1s, const rand_t* r1s, const digest_t* d2s, rand_t* r2s, size_t n) const;
 
     static void digest(digest_t& digest, const mesg_t& m);
+    // Same as above for a message in a buffer owned by the caller, which is not copied.
+    static void digest(digest_t& digest, const unsigned char* m, size_t len);
     static void digest(digest_t& digest, const hash_t& in1, const hash_t& in2);
     static void randomOracle(ChameleonHash::hash_t& out, const ChameleonHash::hash_t& in1, const ChameleonHash::rand_t& in2);
+    // Bulk versions of the above for n inputs, using multi-buffer hashing.
+    // The outputs may alias the inputs.
+    static void digest(digest_t* res, const hash_t* in1, const hash_t* in2, size_t n);
+    static void randomOracle(hash_t* out, const hash_t* in1, const rand_t* in2, size_t n);
 
 private:
+    friend class MessageDigester;
+
     secp256k1_gej_t pk;
+    std::shared_ptr<const FixedBaseTable> pkTable;
     secp256k1_scalar_t sk;
     secp256k1_scalar_t skInv;
     bool hasSecretKey_;
 
     static void initialize();
+    // Rehashes a message digest until it is a valid scalar.
+    static void reduceDigest(digest_t& digest);
+    // Replaces every scalar by its inverse using a single inversion. All must be non-zero.
+    static void invertAll(secp256k1_scalar_t* xs, size_t n);
 };
 
 #endif // CHAMELEONHASH_H
@@ -0,0 +1,43 @@
+/*
+ * Copyright (c) 2015 Tim Ruffing <tim.ruffing@mmci.uni-saarland.de>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#ifndef CONTEXTLENGTH_H
+#define CONTEXTLENGTH_H
+
+// The classes that depend on the length of contexts are templates on that length in
+// bytes, e.g., BasicAuthenticator. They are instantiated for 2, 3, 4 and 8 bytes, i.e.,
+// trees of depth 16, 24, 32 and 64, and for the length ACCA_CT_LEN configured in cmake,
+// which is the length of the plain typedefs such as Authenticator.
+//
+// ACCA_FOR_EACH_CT_LEN(X) expands to X(n) for every instantiated length n.
+#if ACCA_CT_LEN == 2 || ACCA_CT_LEN == 3 || ACCA_CT_LEN == 4 || ACCA_CT_LEN == 8
+#define ACCA_FOR_EACH_CT_LEN(X) X(2) X(3) X(4) X(8)
+#else
+#define ACCA_FOR_EACH_CT_LEN(X) X(2) X(3) X(4) X(8) X(ACCA_CT_LEN)
+#endif
+
+#endif // CONTEXTLENGTH_H
@@ -0,0 +1,399 @@
+/*
+ * Copyright (c) 2015 Tim Ruffing <tim.ruffing@mmci.uni-saarland.de>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#include "equivocationstore.h"
+#include "keyregistry.h"
+#include "sha256.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+const size_t EquivocationStore::RECORD_LEN = ChameleonHash::MESG_LEN + Authenticator::CT_LEN + ChameleonHash::MESG_LEN + Wire::TOKEN_LEN;
+
+namespace {
+
+const unsigned char LOG_MAGIC[8] = {'A', 'C', 'C', 'A', 'E', 'Q', 'L', 'G'};
+const unsigned char INDEX_MAGIC[8] = {'A', 'C', 'C', 'A', 'E', 'Q', 'I', 'X'};
+const unsigned char BLOOM_MAGIC[8] = {'A', 'C', 'C', 'A', 'E', 'Q', 'B', 'F'};
+
+const size_t INITIAL_RECORDS = 1024;
+// must be a power of two
+const size_t INITIAL_SLOTS = 1024;
+const size_t SLOT_LEN = 16;
+// 10 bits per entry and 7 hash functions give a false positive rate of about 1%
+const size_t BLOOM_BITS_PER_ENTRY = 10;
+const size_t BLOOM_HASHES = 7;
+const size_t MIN_BLOOM_BYTES = 1024;
+
+void writeUint32(unsigned char* out, uint32_t x)
+{
+    for (size_t i = 0; i < 4; i++) {
+        out[i] = (x >> (8 * (3 - i))) & 0xFF;
+    }
+}
+
+uint32_t readUint32(const unsigned char* in)
+{
+    uint32_t x = 0;
+    for (size_t i = 0; i < 4; i++) {
+        x = (x << 8) | in[i];
+    }
+    return x;
+}
+
+void writeUint64(unsigned char* out, uint64_t x)
+{
+    writeUint32(out, x >> 32);
+    writeUint32(out + 4, x & 0xFFFFFFFF);
+}
+
+uint64_t readUint64(const unsigned char* in)
+{
+    return (uint64_t) readUint32(in) << 32 | readUint32(in + 4);
+}
+
+std::string makeDirectory(const std::string& dir)
+{
+    if (mkdir(dir.c_str(), 0755) < 0 && errno != EEXIST) {
+        throw std::runtime_error("cannot create " + dir + ": " + strerror(errno));
+    }
+    return dir;
+}
+
+MappedFile openOrCreate(const std::string& path, size_t size)
+{
+    if (access(path.c_str(), F_OK) == 0) {
+        return MappedFile::openReadWrite(path);
+    }
+    return MappedFile::create(path, size);
+}
+
+// Writes the header of a new file, which is still all zeros, or checks the header
+// of an existing file. Returns true if the file is new.
+bool initHeader(MappedFile& file, const unsigned char* magic)
+{
+    unsigned char* header = file.data();
+    if (file.size() < EquivocationStore::HEADER_LEN) {
+        throw std::invalid_argument("equivocation store file is truncated");
+    }
+    if (std::all_of(header, header + sizeof LOG_MAGIC, [](unsigned char c) { return c == 0; })) {
+        memcpy(header, magic, sizeof LOG_MAGIC);
+        writeUint32(header + 8, EquivocationStore::VERSION);
+        return true;
+    }
+    if (memcmp(header, magic, sizeof LOG_MAGIC) != 0) {
+        throw std::invalid_argument("not an equivocation store file");
+    }
+    if (readUint32(header + 8) != EquivocationStore::VERSION) {
+        throw std::invalid_argument("unsupported equivocation store version");
+    }
+    return false;
+}
+
+size_t bloomBytes(size_t expectedEntries)
+{
+    size_t bytes = (expectedEntries * BLOOM_BITS_PER_ENTRY + 7) / 8;
+    return std::max(MIN_BLOOM_BYTES, (bytes + 7) / 8 * 8);
+}
+
+}
+
+EquivocationStore::EquivocationStore(const std::string& dir, size_t expectedEntries, KeyRegistry& verifiers)
+    : verifiers(verifiers), synced(0),
+      log(openOrCreate(makeDirectory(dir) + "/log", HEADER_LEN + INITIAL_RECORDS * RECORD_LEN)),
+      index(openOrCreate(dir + "/index", HEADER_LEN + INITIAL_SLOTS * SLOT_LEN)),
+      bloom(openOrCreate(dir + "/bloom", HEADER_LEN + bloomBytes(expectedEntries)))
+{
+    if (initHeader(log, LOG_MAGIC)) {
+        writeUint32(log.data() + 12, Authenticator::CT_LEN);
+    } else if (readUint32(log.data() + 12) != Authenticator::CT_LEN) {
+        throw std::invalid_argument("equivocation store was created for a different context length");
+    }
+    records = readUint64(log.data() + 16);
+    if (HEADER_LEN + records * RECORD_LEN > log.size()) {
+        throw std::invalid_argument("equivocation store log is truncated");
+    }
+
+    if (initHeader(index, INDEX_MAGIC)) {
+        writeUint64(index.data() + 16, INITIAL_SLOTS);
+    }
+    indexCapacity = readUint64(index.data() + 16);
+    indexEntries = readUint64(index.data() + 24);
+    if (indexCapacity == 0 || (indexCapacity & (indexCapacity - 1)) != 0
+            || HEADER_LEN + indexCapacity * SLOT_LEN != index.size()) {
+        throw std::invalid_argument("equivocation store index is corrupted");
+    }
+
+    if (initHeader(bloom, BLOOM_MAGIC)) {
+        writeUint64(bloom.data() + 16, (bloom.size() - HEADER_LEN) * 8);
+    }
+    bloomBits = readUint64(bloom.data() + 16);
+    if (bloomBits == 0 || HEADER_LEN + bloomBits / 8 != bloom.size()) {
+        throw std::invalid_argument("equivocation store Bloom filter is corrupted");
+    }
+
+    if (indexEntries != records || readUint64(bloom.data() + 24) != records) {
+        rebuild();
+    }
+}
+
+bool EquivocationStore::ingest(Authenticator::dsk_t& dsk, const Authenticator::dpk_t& dpk, const Authenticator::ct_t& ct, const ChameleonHash::digest_t& stDigest, const TokenView& t)
+{
+    ChameleonHash::digest_t otherDigest;
+    Wire::bytes_t other;
+    check(dpk, ct, stDigest, t);
+    if (!detectVerified(otherDigest, other, dpk, ct, stDigest, t)) {
+        return false;
+    }
+    Authenticator acca(dpk);
+    acca.extract(TokenView(other.data(), other.size()), t, ct, otherDigest, stDigest);
+    dsk = acca.getDsk();
+    return true;
+}
+
+bool EquivocationStore::detect(ChameleonHash::digest_t& otherDigest, Wire::bytes_t& other, const Authenticator::dpk_t& dpk, const Authenticator::ct_t& ct, const ChameleonHash::digest_t& stDigest, const TokenView& t)
+{
+    check(dpk, ct, stDigest, t);
+    return detectVerified(otherDigest, other, dpk, ct, stDigest, t);
+}
+
+bool EquivocationStore::detectVerified(ChameleonHash::digest_t& otherDigest, Wire::bytes_t& other, const Authenticator::dpk_t& dpk, const Authenticator::ct_t& ct, const ChameleonHash::digest_t& stDigest, const TokenView& t)
+{
+    key_id_t id = keyId(dpk);
+    fingerprint_t fp = fingerprint(id, ct);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    uint64_t r = find(id, ct, fp);
+    if (r == records) {
+        append(id, ct, stDigest, t, fp);
+        return false;
+    }
+
+    const unsigned char* rec = record(r) + id.size() + ct.size();
+    std::copy(rec, rec + otherDigest.size(), otherDigest.begin());
+    if (otherDigest == stDigest) {
+        // the same assertion again
+        return false;
+    }
+    // copy the token, the mapping may move when other threads append
+    rec += otherDigest.size();
+    other.assign(rec, rec + Wire::TOKEN_LEN);
+    return true;
+}
+
+bool EquivocationStore::ingest(Authenticator::dsk_t& dsk, const Authenticator::dpk_t& dpk, const Authenticator::ct_t& ct, const Authenticator::st_t& st, const Authenticator::token_t& t)
+{
+    ChameleonHash::digest_t stDigest;
+    ChameleonHash::digest(stDigest, st);
+    Wire::bytes_t enc = Wire::encodeToken(t);
+    return ingest(dsk, dpk, ct, stDigest, TokenView(enc.data(), enc.size()));
+}
+
+size_t EquivocationStore::size()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return records;
+}
+
+void EquivocationStore::sync()
+{
+    uint64_t target;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        target = records;
+    }
+    std::lock_guard<std::mutex> syncLock(syncMutex);
+    if (synced >= target) {
+        // written back by a call that was running when this one was made
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    target = records;
+    log.sync();
+    index.sync();
+    bloom.sync();
+    synced = target;
+}
+
+void EquivocationStore::check(const Authenticator::dpk_t& dpk, const Authenticator::ct_t& ct, const ChameleonHash::digest_t& stDigest, const TokenView& t)
+{
+    if (!verifiers.get(dpk)->verify(t, ct, stDigest)) {
+        throw std::invalid_argument("token does not verify");
+    }
+}
+
+EquivocationStore::key_id_t EquivocationStore::keyId(const Authenticator::dpk_t& dpk)
+{
+    Wire::bytes_t enc = Wire::encodeDpk(dpk);
+    key_id_t id;
+    Sha256 hash;
+    hash.write(enc.data(), enc.size());
+    hash.finalize(id.data());
+    return id;
+}
+
+EquivocationStore::fingerprint_t EquivocationStore::fingerprint(const key_id_t& id, const Authenticator::ct_t& ct)
+{
+    fingerprint_t fp;
+    Sha256 hash;
+    hash.write(id.data(), id.size());
+    hash.write(ct.data(), ct.size());
+    hash.finalize(fp.data());
+    return fp;
+}
+
+uint64_t EquivocationStore::find(const key_id_t& id, const Authenticator::ct_t& ct, const fingerprint_t& fp)
+{
+    if (!bloomContains(fp)) {
+        return records;
+    }
+    uint64_t fp64 = readUint64(fp.data());
+    uint64_t mask = indexCapacity - 1;
+    for (uint64_t pos = fp64 & mask; ; pos = (pos + 1) & mask) {
+        const unsigned char* slot = index.data() + HEADER_LEN + pos * SLOT_LEN;
+        uint64_t r = readUint64(slot + 8);
+        if (r == 0) {
+            return records;
+        }
+        r--;
+        // confirm with the record, fingerprints may collide
+        if (readUint64(slot) == fp64 && r < records) {
+            const unsigned char* rec = record(r);
+            if (std::equal(id.begin(), id.end(), rec) && std::equal(ct.begin(), ct.end(), rec + id.size())) {
+                return r;
+            }
+        }
+    }
+}
+
+void EquivocationStore::append(const key_id_t& id, const Authenticator::ct_t& ct, const ChameleonHash::digest_t& stDigest, const TokenView& t, const fingerprint_t& fp)
+{
+    if (HEADER_LEN + (records + 1) * RECORD_LEN > log.size()) {
+        log.resize(HEADER_LEN + 2 * (log.size() - HEADER_LEN) / RECORD_LEN * RECORD_LEN);
+    }
+    unsigned char* rec = record(records);
+    rec = std::copy(id.begin(), id.end(), rec);
+    rec = std::copy(ct.begin(), ct.end(), rec);
+    rec = std::copy(stDigest.begin(), stDigest.end(), rec);
+    std::copy(t.data(), t.data() + Wire::TOKEN_LEN, rec);
+
+    if ((indexEntries + 1) * 2 > indexCapacity) {
+        growIndex();
+    }
+    indexInsert(readUint64(fp.data()), records);
+    bloomInsert(fp);
+
+    // count the record only after it is complete
+    indexEntries++;
+    writeUint64(index.data() + 24, indexEntries);
+    writeUint64(bloom.data() + 24, indexEntries);
+    records++;
+    writeUint64(log.data() + 16, records);
+}
+
+void EquivocationStore::indexInsert(uint64_t fp64, uint64_t recordNumber)
+{
+    uint64_t mask = indexCapacity - 1;
+    for (uint64_t pos = fp64 & mask; ; pos = (pos + 1) & mask) {
+        unsigned char* slot = index.data() + HEADER_LEN + pos * SLOT_LEN;
+        if (readUint64(slot + 8) == 0) {
+            writeUint64(slot, fp64);
+            writeUint64(slot + 8, recordNumber + 1);
+            return;
+        }
+    }
+}
+
+void EquivocationStore::growIndex()
+{
+    std::vector<unsigned char> slots(index.data() + HEADER_LEN, index.data() + index.size());
+    indexCapacity *= 2;
+    index.resize(HEADER_LEN + indexCapacity * SLOT_LEN);
+    std::fill(index.data() + HEADER_LEN, index.data() + index.size(), 0);
+    writeUint64(index.data() + 16, indexCapacity);
+    for (size_t off = 0; off < slots.size(); off += SLOT_LEN) {
+        uint64_t r = readUint64(slots.data() + off + 8);
+        if (r != 0) {
+            indexInsert(readUint64(slots.data() + off), r - 1);
+        }
+    }
+}
+
+bool EquivocationStore::bloomContains(const fingerprint_t& fp) const
+{
+    const unsigned char* bits = bloom.data() + HEADER_LEN;
+    uint64_t h1 = readUint64(fp.data() + 8);
+    uint64_t h2 = readUint64(fp.data() + 16) | 1;
+    for (size_t i = 0; i < BLOOM_HASHES; i++) {
+        uint64_t bit = (h1 + i * h2) % bloomBits;
+        if (!(bits[bit / 8] & (1 << (bit % 8)))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void EquivocationStore::bloomInsert(const fingerprint_t& fp)
+{
+    unsigned char* bits = bloom.data() + HEADER_LEN;
+    uint64_t h1 = readUint64(fp.data() + 8);
+    uint64_t h2 = readUint64(fp.data() + 16) | 1;
+    for (size_t i = 0; i < BLOOM_HASHES; i++) {
+        uint64_t bit = (h1 + i * h2) % bloomBits;
+        bits[bit / 8] |= 1 << (bit % 8);
+    }
+}
+
+void EquivocationStore::rebuild()
+{
+    std::fill(index.data() + HEADER_LEN, index.data() + index.size(), 0);
+    std::fill(bloom.data() + HEADER_LEN, bloom.data() + bloom.size(), 0);
+    indexEntries = 0;
+    for (uint64_t r = 0; r < records; r++) {
+        key_id_t id;
+        Authenticator::ct_t ct;
+        const unsigned char* rec = record(r);
+        std::copy(rec, rec + id.size(), id.begin());
+        std::copy(rec + id.size(), rec + id.size() + ct.size(), ct.begin());
+        fingerprint_t fp = fingerprint(id, ct);
+
+        if ((indexEntries + 1) * 2 > indexCapacity) {
+            growIndex();
+        }
+        indexInsert(readUint64(fp.data()), r);
+        bloomInsert(fp);
+        indexEntries++;
+    }
+    writeUint64(index.data() + 24, indexEntries);
+    writeUint64(bloom.data() + 24, indexEntries);
+}
@@ -0,0 +1,133 @@
+/*
+ * Copyright (c) 2015 Tim Ruffing <tim.ruffing@mmci.uni-saarland.de>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#ifndef EQUIVOCATIONSTORE_H
+#define EQUIVOCATIONSTORE_H
+
+#include "authenticator.h"
+#include "mappedfile.h"
+#include "wire.h"
+
+#include <mutex>
+#include <string>
+
+class KeyRegistry;
+
+// Persistent store of verified assertions that detects equivocation: as soon as a
+// token for a second statement in the same context of the same key is ingested,
+// the secret key is extracted from the two tokens.
+//
+// The store is a directory with three memory-mapped files (all integers big-endian):
+//  - log: 64 byte header (magic "ACCAEQLG", 4-byte version and CT_LEN, 8-byte number
+//    of records), followed by fixed-size records consisting of the key id (SHA-256
+//    of the encoded public key), the context, the digest of the statement and the
+//    token in wire encoding,
+//  - index: 64 byte header (magic "ACCAEQIX", 4-byte version, 8-byte capacity and
+//    number of entries), followed by an open-addressing hash table with 16-byte
+//    slots that map the fingerprint of (key id, context) to the record number plus 1,
+//  - bloom: 64 byte header (magic "ACCAEQBF", 4-byte version, 8-byte number of bits
+//    and entries), followed by a Bloom filter of all (key id, context) pairs, which
+//    answers most lookups for fresh contexts without touching the index.
+// Records are appended before they are counted in the headers. If the entry count of
+// the index or the Bloom filter differs from the number of records when the store is
+// opened, for instance after a crash or if one of the files has been deleted, the index
+// and the Bloom filter are rebuilt from the log.
+//
+// This class is thread-safe.
+class EquivocationStore
+{
+public:
+    static const uint32_t VERSION = 1;
+    static const size_t HEADER_LEN = 64;
+    static const size_t RECORD_LEN;
+
+    // Opens the store in the directory dir, which is created if necessary. The Bloom
+    // filter of a new store is sized for expectedEntries assertions. Tokens are verified
+    // with the verifiers of the registry, which must outlive the store.
+    EquivocationStore(const std::string& dir, size_t expectedEntries, KeyRegistry& verifiers);
+
+    // Records that t is a token for the statement with digest stDigest (see
+    // ChameleonHash::digest) in context ct under dpk. Throws std::invalid_argument if the
+    // token does not verify, so that only valid tokens are ever recorded.
+    // If a token for a different statement in ct under dpk has been recorded before,
+    // the assertion is not recorded, and the function returns true and sets dsk to the
+    // secret key extracted from both tokens. Otherwise, it returns false.
+    bool ingest(Authenticator::dsk_t& dsk, const Authenticator::dpk_t& dpk, const Authenticator::ct_t& ct, const ChameleonHash::digest_t& stDigest, const TokenView& t);
+    bool ingest(Authenticator::dsk_t& dsk, const Authenticator::dpk_t& dpk, const Authenticator::ct_t& ct, const Authenticator::st_t& st, const Authenticator::token_t& t);
+
+    // Same as ingest but leaves the extraction to the caller: in case of a conflict,
+    // returns true and sets otherDigest and other to the digest and the encoded
+    // token of the recorded assertion.
+    bool detect(ChameleonHash::digest_t& otherDigest, Wire::bytes_t& other, const Authenticator::dpk_t& dpk, const Authenticator::ct_t& ct, const ChameleonHash::digest_t& stDigest, const TokenView& t);
+    // Same as detect but does not verify the token. Only for tokens that the caller has
+    // verified or created itself: a recorded invalid token makes extraction impossible
+    // for its context forever.
+    bool detectVerified(ChameleonHash::digest_t& otherDigest, Wire::bytes_t& other, const Authenticator::dpk_t& dpk, const Authenticator::ct_t& ct, const ChameleonHash::digest_t& stDigest, const TokenView& t);
+
+    // Number of recorded assertions.
+    size_t size();
+    // Writes all files back to disk. Returns once all assertions recorded before the call
+    // are on disk. Concurrent calls are combined into a single write-back.
+    void sync();
+
+private:
+    typedef ChameleonHash::digest_t key_id_t;
+    // SHA-256 of the key id and the context
+    typedef std::array<unsigned char, 32> fingerprint_t;
+
+    KeyRegistry& verifiers;
+    std::mutex mutex;
+    // serializes write-backs, synced is the number of records on disk
+    std::mutex syncMutex;
+    uint64_t synced;
+    MappedFile log;
+    MappedFile index;
+    MappedFile bloom;
+    uint64_t records;
+    uint64_t indexCapacity;
+    uint64_t indexEntries;
+    uint64_t bloomBits;
+
+    // Throws std::invalid_argument if t is not a valid token.
+    void check(const Authenticator::dpk_t& dpk, const Authenticator::ct_t& ct, const ChameleonHash::digest_t& stDigest, const TokenView& t);
+    static key_id_t keyId(const Authenticator::dpk_t& dpk);
+    static fingerprint_t fingerprint(const key_id_t& id, const Authenticator::ct_t& ct);
+
+    unsigned char* record(uint64_t i) {
+        return log.data() + HEADER_LEN + i * RECORD_LEN;
+    }
+    // Returns the number of the record for (id, ct) or records if there is none.
+    uint64_t find(const key_id_t& id, const Authenticator::ct_t& ct, const fingerprint_t& fp);
+    void append(const key_id_t& id, const Authenticator::ct_t& ct, const ChameleonHash::digest_t& stDigest, const TokenView& t, const fingerprint_t& fp);
+    void indexInsert(uint64_t fp, uint64_t recordNumber);
+    void growIndex();
+    bool bloomContains(const fingerprint_t& fp) const;
+    void bloomInsert(const fingerprint_t& fp);
+    void rebuild();
+};
+
+#endif // EQUIVOCATIONSTORE_H
@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2015 Tim Ruffing <tim.ruffing@mmci.uni-saarland.de>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#include "fixedbasetable.h"
+
+#include <vector>
+
+FixedBaseTable::FixedBaseTable(const secp256k1_gej_t& p)
+{
+    std::vector<secp256k1_gej_t> multiples(table.size());
+    secp256k1_gej_t base = p;
+
+    for (size_t i = 0; i < WINDOWS; i++) {
+        secp256k1_gej_t* window = &multiples[i * ENTRIES_PER_WINDOW];
+
+        // window[j-1] = j * base
+        window[0] = base;
+        for (size_t j = 1; j < ENTRIES_PER_WINDOW; j++) {
+            secp256k1_gej_add_var(&window[j], &window[j-1], &base);
+        }
+
+        // base = 16 * base
+        for (size_t j = 0; j < WINDOW_BITS; j++) {
+            secp256k1_gej_double_var(&base, &base);
+        }
+    }
+
+    // normalize all entries using a single field inversion
+    secp256k1_ge_set_all_gej_var(table.size(), table.data(), multiples.data());
+}
+
+void FixedBaseTable::mul(secp256k1_gej_t& res, const secp256k1_scalar_t& s) const
+{
+    unsigned char b32[32];
+    secp256k1_scalar_get_b32(b32, &s);
+
+    secp256k1_gej_set_infinity(&res);
+    for (size_t i = 0; i < WINDOWS; i++) {
+        // window i covers the bits 4*i, ..., 4*i+3 of the big-endian scalar
+        unsigned int bits = (b32[31 - i/2] >> (4 * (i % 2))) & 0xF;
+        if (bits) {
+            secp256k1_gej_add_ge_var(&res, &res, &table[i * ENTRIES_PER_WINDOW + bits - 1]);
+        }
+    }
+}
@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) 2015 Tim Ruffing <tim.ruffing@mmci.uni-saarland.de>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#ifndef FIXEDBASETABLE_H
+#define FIXEDBASETABLE_H
+
+#include "chameleonhash.h"
+
+#include <array>
+
+// Precomputed multiples of a fixed point P, which make multiplications with P
+// about as cheap as multiplications with the generator in secp256k1_ecmult_gen.
+// The layout follows secp256k1_ecmult_gen: the scalar is split into 4-bit windows
+// and window i stores j * 16^i * P for j = 1, ..., 15 in affine coordinates,
+// so a multiplication needs at most one mixed addition per window.
+//
+// Multiplication is not constant-time. The table is meant for public points.
+class FixedBaseTable
+{
+public:
+    static const size_t WINDOW_BITS = 4;
+    static const size_t WINDOWS = 256 / WINDOW_BITS;
+    static const size_t ENTRIES_PER_WINDOW = (1 << WINDOW_BITS) - 1;
+
+    FixedBaseTable(const secp256k1_gej_t& p);
+
+    void mul(secp256k1_gej_t& res, const secp256k1_scalar_t& s) const;
+
+private:
+    std::array<secp256k1_ge_t, WINDOWS * ENTRIES_PER_WINDOW> table;
+};
+
+#endif // FIXEDBASETABLE_H
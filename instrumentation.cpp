@@ -0,0 +1,186 @@
+/*
+ * Copyright (c) 2015 Tim Ruffing <tim.ruffing@mmci.uni-saarland.de>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#include "instrumentation.h"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define INSTRUMENTATION_RDTSC
+#endif
+
+const bool Instrumentation::ENABLED;
+
+namespace {
+
+struct totals_t {
+    std::array<std::atomic<uint64_t>, Instrumentation::OPERATIONS> operations;
+    std::array<std::atomic<uint64_t>, Instrumentation::COUNTERS> counts;
+    std::array<std::atomic<uint64_t>, Instrumentation::PHASES> phaseTicks;
+};
+
+totals_t& totals()
+{
+    static totals_t t;
+    return t;
+}
+
+std::shared_ptr<const Instrumentation::callback_t>& callbackPtr()
+{
+    static std::shared_ptr<const Instrumentation::callback_t> callback;
+    return callback;
+}
+
+#ifdef ACCA_INSTRUMENTATION
+// the operation running on this thread
+struct current_t {
+    unsigned depth;
+    uint64_t begin;
+    Instrumentation::record_t record;
+};
+
+thread_local current_t current = {};
+#endif
+
+}
+
+Instrumentation::stats_t Instrumentation::snapshot()
+{
+    stats_t stats;
+    totals_t& t = totals();
+    for (size_t i = 0; i < OPERATIONS; i++) {
+        stats.operations[i] = t.operations[i].load(std::memory_order_relaxed);
+    }
+    for (size_t i = 0; i < COUNTERS; i++) {
+        stats.counts[i] = t.counts[i].load(std::memory_order_relaxed);
+    }
+    for (size_t i = 0; i < PHASES; i++) {
+        stats.phaseTicks[i] = t.phaseTicks[i].load(std::memory_order_relaxed);
+    }
+    return stats;
+}
+
+void Instrumentation::reset()
+{
+    totals_t& t = totals();
+    for (auto& x : t.operations) {
+        x = 0;
+    }
+    for (auto& x : t.counts) {
+        x = 0;
+    }
+    for (auto& x : t.phaseTicks) {
+        x = 0;
+    }
+}
+
+void Instrumentation::setCallback(callback_t callback)
+{
+    std::shared_ptr<const callback_t> ptr;
+    if (callback) {
+        ptr = std::make_shared<const callback_t>(std::move(callback));
+    }
+    std::atomic_store(&callbackPtr(), ptr);
+}
+
+uint64_t Instrumentation::ticks()
+{
+#ifdef INSTRUMENTATION_RDTSC
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+void Instrumentation::count(counter_t counter, uint64_t n)
+{
+#ifdef ACCA_INSTRUMENTATION
+    if (current.depth) {
+        current.record.counts[counter] += n;
+        return;
+    }
+#endif
+    totals().counts[counter].fetch_add(n, std::memory_order_relaxed);
+}
+
+void Instrumentation::addTicks(phase_t phase, uint64_t ticks)
+{
+#ifdef ACCA_INSTRUMENTATION
+    if (current.depth) {
+        current.record.phaseTicks[phase] += ticks;
+        return;
+    }
+#endif
+    totals().phaseTicks[phase].fetch_add(ticks, std::memory_order_relaxed);
+}
+
+Instrumentation::OperationScope::OperationScope(operation_t operation) : outermost(false)
+{
+#ifdef ACCA_INSTRUMENTATION
+    if (current.depth++ == 0) {
+        outermost = true;
+        current.record = record_t();
+        current.record.operation = operation;
+        current.begin = ticks();
+    }
+#else
+    (void) operation;
+#endif
+}
+
+Instrumentation::OperationScope::~OperationScope()
+{
+#ifdef ACCA_INSTRUMENTATION
+    current.depth--;
+    if (!outermost) {
+        return;
+    }
+    record_t& record = current.record;
+    record.totalTicks = ticks() - current.begin;
+
+    totals_t& t = totals();
+    t.operations[record.operation].fetch_add(1, std::memory_order_relaxed);
+    for (size_t i = 0; i < COUNTERS; i++) {
+        if (record.counts[i]) {
+            t.counts[i].fetch_add(record.counts[i], std::memory_order_relaxed);
+        }
+    }
+    for (size_t i = 0; i < PHASES; i++) {
+        if (record.phaseTicks[i]) {
+            t.phaseTicks[i].fetch_add(record.phaseTicks[i], std::memory_order_relaxed);
+        }
+    }
+
+    std::shared_ptr<const callback_t> callback = std::atomic_load(&callbackPtr());
+    if (callback) {
+        (*callback)(record);
+    }
+#endif
+}
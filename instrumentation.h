@@ -0,0 +1,168 @@
+/*
+ * Copyright (c) 2015 Tim Ruffing <tim.ruffing@mmci.uni-saarland.de>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#ifndef INSTRUMENTATION_H
+#define INSTRUMENTATION_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+// Counters and per-phase timings of the hot paths, for finding out where an
+// operation spends its time. Instrumentation is compiled in only if the cmake option
+// ACCA_INSTRUMENTATION is set; otherwise the hooks below expand to nothing and
+// snapshot() returns zeros.
+//
+// Counts and timings are accumulated per thread while an operation (e.g., a call of
+// Authenticator::verify) runs on it, and added to the global totals when the
+// operation returns. Work done outside of operations, e.g., by the pool threads in
+// the latency mode of Authenticator::authenticate, is added to the totals directly
+// but not attributed to any operation.
+class Instrumentation
+{
+public:
+    enum counter_t {
+        // variable-base multiplications, with or without a precomputed table
+        EC_MULT,
+        EC_MULT_GEN,
+        // field and scalar inversions
+        INVERSIONS,
+        // SHA-256 compressions; every lane of the multi-buffer kernels counts separately
+        SHA_COMPRESSIONS,
+        // PRF outputs, i.e., every x and every r counts
+        PRF_CALLS,
+        // re-hashing in ChameleonHash::digest because the hash overflowed the group order
+        DIGEST_RETRIES,
+        COUNTERS
+    };
+
+    // Phases nest: PHASE_PATH and PHASE_CHAIN include the time of the phases inside them.
+    enum phase_t {
+        PHASE_PRF,
+        PHASE_EC_MULT,
+        PHASE_SERIALIZE,
+        PHASE_COLLISION,
+        // hashing in ChameleonHash::digest and ChameleonHash::randomOracle
+        PHASE_DIGEST,
+        // computing the chameleon hashes on the path in Authenticator::authenticate
+        PHASE_PATH,
+        // computing the collisions and digests up to the root
+        PHASE_CHAIN,
+        PHASES
+    };
+
+    enum operation_t {
+        AUTHENTICATE,
+        // Authenticator::authenticateMany and authenticateMulti, once per chunk of statements
+        AUTHENTICATE_BATCH,
+        VERIFY,
+        VERIFY_BATCH,
+        EXTRACT,
+        // Authenticator::precompute; the online part counts as AUTHENTICATE
+        PRECOMPUTE,
+        OPERATIONS
+    };
+
+    typedef std::array<uint64_t, COUNTERS> counts_t;
+    // Timings are in TSC ticks on x86 and in nanoseconds elsewhere.
+    typedef std::array<uint64_t, PHASES> ticks_t;
+
+    // one finished operation
+    struct record_t {
+        operation_t operation;
+        counts_t counts;
+        ticks_t phaseTicks;
+        uint64_t totalTicks;
+    };
+
+    struct stats_t {
+        std::array<uint64_t, OPERATIONS> operations;
+        counts_t counts;
+        ticks_t phaseTicks;
+    };
+
+    // Called on the thread of the operation after every operation. It must be cheap,
+    // e.g., just update some metrics, and must not throw.
+    typedef std::function<void(const record_t&)> callback_t;
+
+#ifdef ACCA_INSTRUMENTATION
+    static const bool ENABLED = true;
+#else
+    static const bool ENABLED = false;
+#endif
+
+    static stats_t snapshot();
+    static void reset();
+    // Pass an empty function to remove the callback.
+    static void setCallback(callback_t callback);
+
+    static uint64_t ticks();
+    static void count(counter_t counter, uint64_t n);
+    static void addTicks(phase_t phase, uint64_t ticks);
+
+    class PhaseTimer
+    {
+    public:
+        PhaseTimer(phase_t phase) : phase(phase), begin(ticks()) { }
+        ~PhaseTimer() {
+            addTicks(phase, ticks() - begin);
+        }
+        PhaseTimer(const PhaseTimer&) = delete;
+        PhaseTimer& operator=(const PhaseTimer&) = delete;
+
+    private:
+        phase_t phase;
+        uint64_t begin;
+    };
+
+    // Nested operations on the same thread, e.g., verify inside extract, count as
+    // part of the outermost one.
+    class OperationScope
+    {
+    public:
+        OperationScope(operation_t operation);
+        ~OperationScope();
+        OperationScope(const OperationScope&) = delete;
+        OperationScope& operator=(const OperationScope&) = delete;
+
+    private:
+        bool outermost;
+    };
+};
+
+#ifdef ACCA_INSTRUMENTATION
+#define ACCA_COUNT(counter, n) Instrumentation::count(Instrumentation::counter, n)
+#define ACCA_PHASE(phase) Instrumentation::PhaseTimer accaPhaseTimer_(Instrumentation::phase)
+#define ACCA_OPERATION(operation) Instrumentation::OperationScope accaOperationScope_(Instrumentation::operation)
+#else
+#define ACCA_COUNT(counter, n) do { } while (0)
+#define ACCA_PHASE(phase) do { } while (0)
+#define ACCA_OPERATION(operation) do { } while (0)
+#endif
+
+#endif // INSTRUMENTATION_H
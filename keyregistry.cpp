@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2015 Tim Ruffing <tim.ruffing@mmci.uni-saarland.de>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#include "keyregistry.h"
+#include "fixedbasetable.h"
+
+const size_t KeyRegistry::ENTRY_SIZE = sizeof(Authenticator) + sizeof(FixedBaseTable);
+
+KeyRegistry::KeyRegistry(size_t memoryBudget) : cache(memoryBudget) { }
+
+std::shared_ptr<const Authenticator> KeyRegistry::get(const Authenticator::dpk_t& dpk)
+{
+    std::vector<unsigned char> key = toKey(dpk);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::shared_ptr<const Authenticator>* acca = cache.get(key);
+        if (acca) {
+            return *acca;
+        }
+    }
+
+    // Parsing the key and building the table is expensive, so we do not hold the lock.
+    // If another thread creates the same verifier concurrently, the later one wins.
+    std::shared_ptr<const Authenticator> acca = std::make_shared<Authenticator>(dpk, true);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    cache.put(key, acca, ENTRY_SIZE);
+    return acca;
+}
+
+void KeyRegistry::setMemoryBudget(size_t memoryBudget)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    cache.setBudget(memoryBudget);
+}
+
+KeyRegistry::stats_t KeyRegistry::getStats()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return cache.getStats();
+}
+
+std::vector<unsigned char> KeyRegistry::toKey(const Authenticator::dpk_t& dpk)
+{
+    std::vector<unsigned char> key(dpk.chpk);
+    key.insert(key.end(), dpk.rootDigest.begin(), dpk.rootDigest.end());
+    return key;
+}
@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2015 Tim Ruffing <tim.ruffing@mmci.uni-saarland.de>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#ifndef KEYREGISTRY_H
+#define KEYREGISTRY_H
+
+#include "authenticator.h"
+#include "lrucache.h"
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Keeps verifiers for long-lived public keys, each one with a precomputed table
+// for its chameleon hash public key. Keys are evicted in LRU order when the memory
+// used by the cached verifiers exceeds the configured budget.
+//
+// This class is thread-safe.
+class KeyRegistry
+{
+public:
+    // Approximate memory used by one cached verifier.
+    static const size_t ENTRY_SIZE;
+
+    typedef LruCacheStats stats_t;
+
+    KeyRegistry(size_t memoryBudget);
+
+    // Returns a verifier for dpk, creating it if necessary. The verifier stays valid
+    // even if it is evicted from the registry in the meantime. Throws std::invalid_argument
+    // if dpk is a key for a different context length than Authenticator::CT_LEN.
+    std::shared_ptr<const Authenticator> get(const Authenticator::dpk_t& dpk);
+
+    void setMemoryBudget(size_t memoryBudget);
+    stats_t getStats();
+
+private:
+    std::mutex mutex;
+    LruCache<std::vector<unsigned char>, std::shared_ptr<const Authenticator>> cache;
+
+    static std::vector<unsigned char> toKey(const Authenticator::dpk_t& dpk);
+};
+
+#endif // KEYREGISTRY_H
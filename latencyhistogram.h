@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2015 Tim Ruffing <tim.ruffing@mmci.uni-saarland.de>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#ifndef LATENCYHISTOGRAM_H
+#define LATENCYHISTOGRAM_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+// A histogram of latencies in nanoseconds with a relative error of at most 1/8.
+// Values below 16 have their own bucket, and every larger power-of-two range is
+// split into 8 buckets of equal width. Recording is lock-free.
+class LatencyHistogram
+{
+public:
+    static const size_t SUB_BUCKETS = 8;
+    static const size_t BUCKETS = 16 + (64 - 4) * SUB_BUCKETS;
+
+    LatencyHistogram() {
+        reset();
+    }
+
+    void record(uint64_t ns) {
+        buckets[bucket(ns)].fetch_add(1, std::memory_order_relaxed);
+        total.fetch_add(1, std::memory_order_relaxed);
+        uint64_t old = maximum.load(std::memory_order_relaxed);
+        while (ns > old && !maximum.compare_exchange_weak(old, ns, std::memory_order_relaxed)) { }
+    }
+
+    uint64_t count() const {
+        return total.load(std::memory_order_relaxed);
+    }
+
+    uint64_t max() const {
+        return maximum.load(std::memory_order_relaxed);
+    }
+
+    // Returns an upper bound for the latency below which the fraction q of all values lie.
+    uint64_t quantile(double q) const {
+        uint64_t n = count();
+        if (n == 0) {
+            return 0;
+        }
+        uint64_t rank = (uint64_t) (q * n);
+        rank = rank < n ? rank : n - 1;
+        uint64_t seen = 0;
+        for (size_t i = 0; i < BUCKETS; i++) {
+            seen += buckets[i].load(std::memory_order_relaxed);
+            if (seen > rank) {
+                uint64_t upper = upperBound(i);
+                return upper < max() ? upper : max();
+            }
+        }
+        return max();
+    }
+
+    void reset() {
+        for (auto& b : buckets) {
+            b.store(0, std::memory_order_relaxed);
+        }
+        total.store(0, std::memory_order_relaxed);
+        maximum.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    std::array<std::atomic<uint64_t>, BUCKETS> buckets;
+    std::atomic<uint64_t> total;
+    std::atomic<uint64_t> maximum;
+
+    static size_t bucket(uint64_t ns) {
+        if (ns < 16) {
+            return ns;
+        }
+        unsigned msb = 63 - __builtin_clzll(ns);
+        return 16 + (msb - 4) * SUB_BUCKETS + ((ns >> (msb - 3)) & (SUB_BUCKETS - 1));
+    }
+
+    static uint64_t upperBound(size_t i) {
+        if (i < 16) {
+            return i;
+        }
+        unsigned msb = (i - 16) / SUB_BUCKETS + 4;
+        uint64_t sub = (i - 16) % SUB_BUCKETS;
+        uint64_t width = 1ull << (msb - 3);
+        return (1ull << msb) + (sub + 1) * width - 1;
+    }
+};
+
+#endif // LATENCYHISTOGRAM_H
@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) 2015 Tim Ruffing <tim.ruffing@mmci.uni-saarland.de>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#ifndef LRUCACHE_H
+#define LRUCACHE_H
+
+#include <list>
+#include <map>
+#include <utility>
+#include <cstdint>
+
+struct LruCacheStats {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    size_t entries;
+    size_t cost;
+    size_t budget;
+};
+
+// A map with a bounded total cost, which evicts the least recently used entries
+// when the budget is exceeded. This class is not thread-safe.
+template<typename K, typename V>
+class LruCache
+{
+public:
+    typedef LruCacheStats stats_t;
+
+    LruCache(size_t budget) : budget(budget), cost(0), hits(0), misses(0), evictions(0) { }
+
+    // Returns a pointer to the value for key, or nullptr if there is none.
+    // The pointer is valid until the next modification of the cache.
+    V* get(const K& key) {
+        auto it = index.find(key);
+        if (it == index.end()) {
+            misses++;
+            return nullptr;
+        }
+        hits++;
+        // move to front
+        entries.splice(entries.begin(), entries, it->second);
+        return &it->second->value;
+    }
+
+    // Inserts or replaces the value for key. An entry whose cost exceeds the whole
+    // budget is not inserted.
+    void put(const K& key, const V& value, size_t entryCost) {
+        erase(key);
+        if (entryCost > budget) {
+            return;
+        }
+        entries.push_front(entry_t{key, value, entryCost});
+        index[key] = entries.begin();
+        cost += entryCost;
+        shrink();
+    }
+
+    void erase(const K& key) {
+        auto it = index.find(key);
+        if (it != index.end()) {
+            cost -= it->second->cost;
+            entries.erase(it->second);
+            index.erase(it);
+        }
+    }
+
+    void setBudget(size_t newBudget) {
+        budget = newBudget;
+        shrink();
+    }
+
+    stats_t getStats() const {
+        return stats_t{hits, misses, evictions, index.size(), cost, budget};
+    }
+
+private:
+    struct entry_t {
+        K key;
+        V value;
+        size_t cost;
+    };
+
+    // most recently used entry first
+    std::list<entry_t> entries;
+    std::map<K, typename std::list<entry_t>::iterator> index;
+    size_t budget;
+    size_t cost;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+
+    void shrink() {
+        while (cost > budget) {
+            const entry_t& last = entries.back();
+            cost -= last.cost;
+            index.erase(last.key);
+            entries.pop_back();
+            evictions++;
+        }
+    }
+};
+
+#endif // LRUCACHE_H
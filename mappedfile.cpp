@@ -0,0 +1,172 @@
+/*
+ * Copyright (c) 2015 Tim Ruffing <tim.ruffing@mmci.uni-saarland.de>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#include "mappedfile.h"
+
+#include <stdexcept>
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static std::runtime_error systemError(const std::string& what)
+{
+    return std::runtime_error(what + ": " + strerror(errno));
+}
+
+MappedFile::MappedFile(int fd, size_t size, bool writable) : fd(fd), data_(nullptr), size_(size), writable(writable)
+{
+    map();
+}
+
+MappedFile MappedFile::openReadOnly(const std::string& path)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw systemError("cannot open " + path);
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        throw systemError("cannot stat " + path);
+    }
+    return MappedFile(fd, st.st_size, false);
+}
+
+MappedFile MappedFile::openReadWrite(const std::string& path)
+{
+    int fd = open(path.c_str(), O_RDWR);
+    if (fd < 0) {
+        throw systemError("cannot open " + path);
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        throw systemError("cannot stat " + path);
+    }
+    return MappedFile(fd, st.st_size, true);
+}
+
+MappedFile MappedFile::create(const std::string& path, size_t size)
+{
+    int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        throw systemError("cannot create " + path);
+    }
+    if (ftruncate(fd, size) < 0) {
+        close(fd);
+        throw systemError("cannot resize " + path);
+    }
+    return MappedFile(fd, size, true);
+}
+
+MappedFile::MappedFile(MappedFile&& other) : fd(other.fd), data_(other.data_), size_(other.size_), writable(other.writable)
+{
+    other.fd = -1;
+    other.data_ = nullptr;
+    other.size_ = 0;
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other)
+{
+    if (this != &other) {
+        unmap();
+        if (fd >= 0) {
+            close(fd);
+        }
+        fd = other.fd;
+        data_ = other.data_;
+        size_ = other.size_;
+        writable = other.writable;
+        other.fd = -1;
+        other.data_ = nullptr;
+        other.size_ = 0;
+    }
+    return *this;
+}
+
+MappedFile::~MappedFile()
+{
+    unmap();
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+void MappedFile::resize(size_t newSize)
+{
+    if (!writable) {
+        throw std::logic_error("cannot resize a read-only mapping");
+    }
+    unmap();
+    if (ftruncate(fd, newSize) < 0) {
+        throw systemError("cannot resize mapped file");
+    }
+    size_ = newSize;
+    map();
+}
+
+void MappedFile::sync()
+{
+    if (data_ && msync(data_, size_, MS_SYNC) < 0) {
+        throw systemError("cannot sync mapped file");
+    }
+    // the size and the other metadata
+    if (fd >= 0 && fsync(fd) < 0) {
+        throw systemError("cannot sync mapped file");
+    }
+}
+
+void MappedFile::map()
+{
+    if (size_ == 0) {
+        // mmap does not support empty mappings
+        data_ = nullptr;
+        return;
+    }
+    int prot = writable ? (PROT_READ | PROT_WRITE) : PROT_READ;
+    void* p = mmap(nullptr, size_, prot, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED) {
+        int err = errno;
+        close(fd);
+        fd = -1;
+        errno = err;
+        throw systemError("cannot map file");
+    }
+    data_ = static_cast<unsigned char*>(p);
+}
+
+void MappedFile::unmap()
+{
+    if (data_) {
+        munmap(data_, size_);
+        data_ = nullptr;
+    }
+}
@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2015 Tim Ruffing <tim.ruffing@mmci.uni-saarland.de>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <string>
+#include <cstddef>
+
+// A file mapped into memory with MAP_SHARED, so that several processes mapping
+// the same file share its pages in the page cache. Instances own their mapping
+// and can be moved but not copied.
+class MappedFile
+{
+public:
+    // Maps an existing file read-only.
+    static MappedFile openReadOnly(const std::string& path);
+    // Maps an existing file read-write.
+    static MappedFile openReadWrite(const std::string& path);
+    // Creates (or truncates) a file of the given size and maps it read-write.
+    static MappedFile create(const std::string& path, size_t size);
+
+    MappedFile(MappedFile&& other);
+    MappedFile& operator=(MappedFile&& other);
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile();
+
+    // Changes the size of a read-write mapping, extending the file with zeros if necessary.
+    // Pointers obtained from data() are invalidated.
+    void resize(size_t newSize);
+    // Writes modified pages and the metadata of the file back to disk.
+    void sync();
+
+    const unsigned char* data() const {
+        return data_;
+    }
+    unsigned char* data() {
+        return data_;
+    }
+    size_t size() const {
+        return size_;
+    }
+
+private:
+    int fd;
+    unsigned char* data_;
+    size_t size_;
+    bool writable;
+
+    MappedFile(int fd, size_t size, bool writable);
+    void map();
+    void unmap();
+};
+
+#endif // MAPPEDFILE_H
@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2015 Tim Ruffing <tim.ruffing@mmci.uni-saarland.de>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#include "messagedigester.h"
+#include "mappedfile.h"
+#include "instrumentation.h"
+
+#include <stdexcept>
+#include <cerrno>
+#include <cstring>
+
+#include <sys/uio.h>
+#include <unistd.h>
+
+void MessageDigester::write(const struct iovec* iov, size_t iovcnt)
+{
+    for (size_t i = 0; i < iovcnt; i++) {
+        sha.write(static_cast<const unsigned char*>(iov[i].iov_base), iov[i].iov_len);
+    }
+}
+
+void MessageDigester::writeFrom(int fd)
+{
+    unsigned char buf[65536];
+    for (;;) {
+        ssize_t n = read(fd, buf, sizeof(buf));
+        if (n == 0) {
+            return;
+        }
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::runtime_error(std::string("cannot read statement: ") + strerror(errno));
+        }
+        sha.write(buf, n);
+    }
+}
+
+void MessageDigester::finalize(ChameleonHash::digest_t& digest)
+{
+    ACCA_PHASE(PHASE_DIGEST);
+    sha.finalize(digest.data());
+    ChameleonHash::reduceDigest(digest);
+}
+
+void MessageDigester::digest(ChameleonHash::digest_t& digest, const struct iovec* iov, size_t iovcnt)
+{
+    MessageDigester md;
+    md.write(iov, iovcnt);
+    md.finalize(digest);
+}
+
+void MessageDigester::digestFrom(ChameleonHash::digest_t& digest, int fd)
+{
+    MessageDigester md;
+    md.writeFrom(fd);
+    md.finalize(digest);
+}
+
+void MessageDigester::digestFile(ChameleonHash::digest_t& digest, const std::string& path)
+{
+    MappedFile file = MappedFile::openReadOnly(path);
+    ChameleonHash::digest(digest, file.data(), file.size());
+}
@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2015 Tim Ruffing <tim.ruffing@mmci.uni-saarland.de>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#ifndef MESSAGEDIGESTER_H
+#define MESSAGEDIGESTER_H
+
+#include "chameleonhash.h"
+#include "sha256.h"
+
+#include <string>
+#include <cstddef>
+
+struct iovec;
+
+// Computes ChameleonHash::digest() of a message that is given in pieces, e.g., a large
+// statement that arrives from the network, without keeping the message in memory.
+class MessageDigester
+{
+public:
+    void write(const unsigned char* data, size_t len) {
+        sha.write(data, len);
+    }
+    // Scatter-gather input, e.g., the buffers filled by readv().
+    void write(const struct iovec* iov, size_t iovcnt);
+    // Reads fd until end of file. Throws std::runtime_error if reading fails.
+    void writeFrom(int fd);
+    void finalize(ChameleonHash::digest_t& digest);
+
+    static void digest(ChameleonHash::digest_t& digest, const struct iovec* iov, size_t iovcnt);
+    static void digestFrom(ChameleonHash::digest_t& digest, int fd);
+    // Digest of the contents of a file, which is mapped into memory instead of being read.
+    static void digestFile(ChameleonHash::digest_t& digest, const std::string& path);
+
+private:
+    Sha256 sha;
+};
+
+#endif // MESSAGEDIGESTER_H
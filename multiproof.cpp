@@ -0,0 +1,133 @@
+/*
+ * Copyright (c) 2015 Tim Ruffing <tim.ruffing@mmci.uni-saarland.de>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#include "multiproof.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+template<size_t CtLen> const size_t BasicMultiProof<CtLen>::DEPTH;
+template<size_t CtLen> const size_t BasicMultiProof<CtLen>::level_t::NONE;
+
+template<size_t CtLen>
+std::vector<typename BasicMultiProof<CtLen>::level_t> BasicMultiProof<CtLen>::layout(std::vector<size_t>& leaves, const std::vector<ct_t>& cts)
+{
+    std::vector<level_t> levels(DEPTH);
+    std::vector<Node>& nodes = levels[0].nodes;
+    for (const ct_t& ct : cts) {
+        nodes.emplace_back(ct);
+    }
+    std::sort(nodes.begin(), nodes.end());
+    nodes.erase(std::unique(nodes.begin(), nodes.end()), nodes.end());
+    leaves.resize(cts.size());
+    for (size_t i = 0; i < cts.size(); i++) {
+        leaves[i] = std::lower_bound(nodes.begin(), nodes.end(), Node(cts[i])) - nodes.begin();
+    }
+
+    for (size_t level = 0; level < DEPTH; level++) {
+        level_t& lv = levels[level];
+        size_t m = lv.nodes.size();
+        lv.siblings.resize(m);
+        lv.parents.resize(m);
+        for (size_t j = 0; j < m; j++) {
+            // the sibling is a neighbour if it is a path node
+            Node sibling = lv.nodes[j];
+            sibling.moveToSibling();
+            if (j > 0 && lv.nodes[j - 1] == sibling) {
+                lv.siblings[j] = j - 1;
+            } else if (j + 1 < m && lv.nodes[j + 1] == sibling) {
+                lv.siblings[j] = j + 1;
+            } else {
+                lv.siblings[j] = level_t::NONE;
+            }
+
+            if (level + 1 == DEPTH) {
+                // the parent is the root
+                lv.parents[j] = 0;
+                continue;
+            }
+            // the parents of nodes from left to right are again from left to right
+            std::vector<Node>& next = levels[level + 1].nodes;
+            Node parent = lv.nodes[j];
+            parent.moveToParent();
+            if (next.empty() || !(next.back() == parent)) {
+                next.push_back(parent);
+            }
+            lv.parents[j] = next.size() - 1;
+        }
+    }
+    return levels;
+}
+
+template<size_t CtLen>
+void BasicMultiProof<CtLen>::fromTokens(BasicMultiProof& proof, const std::vector<token_t>& ts, const std::vector<ct_t>& cts)
+{
+    if (ts.size() != cts.size()) {
+        throw std::invalid_argument("batch sizes differ");
+    }
+    const size_t n = ts.size();
+    std::vector<size_t> leaves;
+    std::vector<level_t> levels = layout(leaves, cts);
+
+    proof.rs.clear();
+    proof.chs.clear();
+    for (size_t i = 0; i < n; i++) {
+        proof.rs.push_back(ts[i].rs[0]);
+        proof.chs.push_back(ts[i].chs[0]);
+    }
+    for (size_t i = 0; i < n; i++) {
+        proof.rs.push_back(ts[i].rs[1]);
+    }
+
+    // for every node on the current level, a token whose path contains the node
+    std::vector<size_t> reps(levels[0].nodes.size());
+    for (size_t i = 0; i < n; i++) {
+        reps[leaves[i]] = i;
+    }
+    for (size_t level = 1; level < DEPTH; level++) {
+        const level_t& below = levels[level - 1];
+        const level_t& lv = levels[level];
+        std::vector<size_t> next(lv.nodes.size());
+        for (size_t j = 0; j < below.nodes.size(); j++) {
+            next[below.parents[j]] = reps[j];
+        }
+        reps.swap(next);
+
+        for (size_t j = 0; level >= 2 && j < lv.nodes.size(); j++) {
+            proof.rs.push_back(ts[reps[j]].rs[level]);
+        }
+        for (size_t j = 0; j < lv.nodes.size(); j++) {
+            if (lv.siblings[j] == level_t::NONE) {
+                proof.chs.push_back(ts[reps[j]].chs[level]);
+            }
+        }
+    }
+}
+
+#define INSTANTIATE(n) template class BasicMultiProof<n>;
+ACCA_FOR_EACH_CT_LEN(INSTANTIATE)
+#undef INSTANTIATE
@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2015 Tim Ruffing <tim.ruffing@mmci.uni-saarland.de>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#ifndef MULTIPROOF_H
+#define MULTIPROOF_H
+
+#include "authenticator.h"
+#include "node.h"
+
+#include <vector>
+
+// A proof for several assertions under the same key, similar to a Merkle multiproof.
+// The paths of nearby contexts share their upper nodes. For a path node above level 1,
+// the randomness is the same in all tokens through the node, and it is stored only once.
+// A sibling hash on level 1 or above is stored only if the sibling is not on one of the
+// paths, since otherwise the verifier computes it anyway. On levels 0 and 1, the randomness
+// depends on the statement, so it is stored for every assertion, as are the sibling
+// hashes on level 0, which differ from the hashes on the paths due to the random oracle.
+//
+// The values are stored level by level from the leaves to the root:
+//  - rs: one per assertion on levels 0 and 1 (in the order of the assertions), and one
+//    per path node on each higher level (from left to right),
+//  - chs: one per assertion on level 0, and one per path node whose sibling is not a
+//    path node on each higher level.
+template<size_t CtLen>
+class BasicMultiProof
+{
+public:
+    typedef BasicNode<CtLen> Node;
+    typedef typename BasicAuthenticator<CtLen>::ct_t ct_t;
+    typedef typename BasicAuthenticator<CtLen>::token_t token_t;
+    static const size_t DEPTH = BasicAuthenticator<CtLen>::DEPTH;
+
+    std::vector<ChameleonHash::rand_t> rs;
+    std::vector<ChameleonHash::hash_t> chs;
+
+    // Builds the proof from tokens created by BasicAuthenticator::authenticate().
+    // The tokens of a dishonest signer do not share their upper levels, and the proof
+    // of such tokens does not verify.
+    static void fromTokens(BasicMultiProof& proof, const std::vector<token_t>& ts, const std::vector<ct_t>& cts);
+
+    // The path nodes of a set of contexts, level by level.
+    struct level_t {
+        static const size_t NONE = (size_t) -1;
+        // the distinct path nodes on the level, from left to right
+        std::vector<Node> nodes;
+        // for every node, the index of its parent on the next level
+        std::vector<size_t> parents;
+        // for every node, the index of its sibling, or NONE if the sibling is not a path node
+        std::vector<size_t> siblings;
+    };
+    // Returns DEPTH levels, and in leaves the index of the leaf of every context.
+    static std::vector<level_t> layout(std::vector<size_t>& leaves, const std::vector<ct_t>& cts);
+};
+
+typedef BasicMultiProof<ACCA_CT_LEN> MultiProof;
+
+#endif // MULTIPROOF_H
@@ -25,28 +25,43 @@
  */
 
 #include "node.h"
+
+#include <stdexcept>
 #include <assert.h>
 
-Node::Node(const Authenticator::ct_t& ct) : level(Authenticator::DEPTH), fromLeft({})
+template<size_t CtLen>
+BasicNode<CtLen>::BasicNode(const ct_t& ct) : level(DEPTH), fromLeft({})
 {
     // Parse as big endian number
-    for (size_t i = 0; i < Authenticator::CT_LEN; i++) {
+    for (size_t i = 0; i < CtLen; i++) {
         fromLeft[LIMBS - 1 - i/sizeof(limb_t)]
-            |= (limb_t) ct[Authenticator::CT_LEN-i-1] << (i % sizeof(limb_t) * 8);
+            |= (limb_t) ct[CtLen-i-1] << (i % sizeof(limb_t) * 8);
     }
 }
 
-Node::Node(size_t level, uint64_t fromLeft) : level(level), fromLeft({})
+template<size_t CtLen>
+BasicNode<CtLen>::BasicNode(size_t level, uint64_t fromLeft) : level(level), fromLeft({})
 {
     this->fromLeft.back() += fromLeft;
 }
 
-Node Node::leftChildOfRoot()
+template<size_t CtLen>
+BasicNode<CtLen> BasicNode<CtLen>::leftChildOfRoot()
 {
-    return Node(1, 0);
+    return BasicNode(1, 0);
+}
+
+template<size_t CtLen>
+BasicNode<CtLen> BasicNode<CtLen>::fromPosition(size_t level, uint64_t fromLeft)
+{
+    if (level > DEPTH || (level < 64 && fromLeft >> level)) {
+        throw std::out_of_range("no such node");
+    }
+    return BasicNode(level, fromLeft);
 }
 
-bool Node::moveToParent()
+template<size_t CtLen>
+bool BasicNode<CtLen>::moveToParent()
 {
     if (isRoot()) {
         return false;
@@ -71,7 +86,8 @@ bool Node::moveToParent()
     return true;
 }
 
-bool Node::moveToSibling()
+template<size_t CtLen>
+bool BasicNode<CtLen>::moveToSibling()
 {
     if (isRoot()) {
         return false;
@@ -80,7 +96,8 @@ bool Node::moveToSibling()
     return true;
 }
 
-bool Node::isLeftChild()
+template<size_t CtLen>
+bool BasicNode<CtLen>::isLeftChild() const
 {
     if (isRoot()) {
         throw std::logic_error("Root node is not a child.");
@@ -88,19 +105,53 @@ bool Node::isLeftChild()
     return !(fromLeft.back() & 1);
 }
 
-bool Node::isRoot()
+template<size_t CtLen>
+bool BasicNode<CtLen>::isRoot() const
 {
     return level == 0;
 }
 
-void Node::toBytes(Prf::data_t& d)
+template<size_t CtLen>
+void BasicNode<CtLen>::toBytes(bytes_t& d) const
 {
-    d.resize(sizeof level + sizeof(limb_t) * LIMBS);
-    d.push_back(level);
-    for (auto &limb : fromLeft) {
+    static_assert(DEPTH <= 0xFFFF, "level does not fit into two bytes");
+    auto it = d.begin();
+    *it++ = (level >> 8) & 0xFF;
+    *it++ = level & 0xFF;
+    for (const auto &limb : fromLeft) {
         // for i = sizeof(limb_t) - 1, ..., 0
-        for (size_t i = sizeof(limb_t) - 1; i-- > 0; ) {
-            d.push_back((limb >> (i*8)) & 0xFF);
+        for (size_t i = sizeof(limb_t); i-- > 0; ) {
+            *it++ = (limb >> (i*8)) & 0xFF;
         }
     }
+    assert(it == d.end());
+}
+
+template<size_t CtLen>
+bool BasicNode<CtLen>::operator<(const BasicNode& other) const
+{
+    return level < other.level || (level == other.level && fromLeft < other.fromLeft);
+}
+
+template<size_t CtLen>
+bool BasicNode<CtLen>::operator==(const BasicNode& other) const
+{
+    return level == other.level && fromLeft == other.fromLeft;
+}
+
+template<size_t CtLen>
+size_t BasicNode<CtLen>::getLevel() const
+{
+    return level;
 }
+
+template<size_t CtLen>
+uint64_t BasicNode<CtLen>::getFromLeft() const
+{
+    assert(level <= 64);
+    return fromLeft.back();
+}
+
+#define INSTANTIATE(n) template class BasicNode<n>;
+ACCA_FOR_EACH_CT_LEN(INSTANTIATE)
+#undef INSTANTIATE
@@ -27,23 +27,39 @@
 #ifndef NODE_H
 #define NODE_H
 
-#include "authenticator.h"
-#include "prf.h"
+#include "contextlength.h"
+
 #include <array>
+#include <cstddef>
+#include <cstdint>
 
-class Node
+template<size_t CtLen>
+class BasicNode
 {
 public:
+    static const size_t CT_LEN = CtLen;
+    static const size_t DEPTH = CtLen * 8;
+    typedef std::array<unsigned char, CtLen> ct_t;
+
     // construct a leaf node
-    Node(const Authenticator::ct_t& ct);
-    static Node leftChildOfRoot();
+    BasicNode(const ct_t& ct);
+    static BasicNode leftChildOfRoot();
+    // construct the node with the given number of other nodes left of it on the given level
+    static BasicNode fromPosition(size_t level, uint64_t fromLeft);
 
     bool moveToParent();
     bool moveToSibling();
-    bool isLeftChild();
+    bool isLeftChild() const;
+
+    bool isRoot() const;
 
-    bool isRoot();
-    void toBytes(Prf::data_t& d);
+    // order by level first, then from left to right
+    bool operator<(const BasicNode& other) const;
+    bool operator==(const BasicNode& other) const;
+
+    size_t getLevel() const;
+    // Only defined for nodes on the levels 0, ..., 64.
+    uint64_t getFromLeft() const;
 
 private:
     // Level 0 is the level of the root.
@@ -51,11 +67,18 @@ private:
 
     // The code is fully parametric in limb_t.
     typedef uint64_t limb_t;
-    static const size_t LIMBS = (Authenticator::CT_LEN + sizeof(limb_t) - 1) / sizeof(limb_t);
+    static const size_t LIMBS = (CtLen + sizeof(limb_t) - 1) / sizeof(limb_t);
     // Big-endian representation of number of other nodes on the same level left of this node.
     std::array<uint64_t, LIMBS> fromLeft = {};
-    Node(size_t level, uint64_t fromLeft);
+    BasicNode(size_t level, uint64_t fromLeft);
+
+public:
+    // Fixed-size encoding: the level as 16-bit big-endian number, followed by fromLeft.
+    static const size_t BYTES_LEN = 2 + sizeof(limb_t) * LIMBS;
+    typedef std::array<unsigned char, BYTES_LEN> bytes_t;
+    void toBytes(bytes_t& d) const;
 };
 
+typedef BasicNode<ACCA_CT_LEN> Node;
 
 #endif // NODE_H
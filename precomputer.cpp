@@ -0,0 +1,142 @@
+/*
+ * Copyright (c) 2015 Tim Ruffing <tim.ruffing@mmci.uni-saarland.de>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#include "precomputer.h"
+
+#include <algorithm>
+
+Authenticator::ct_t Precomputer::nextCounter(const Authenticator::ct_t& ct)
+{
+    Authenticator::ct_t res = ct;
+    for (size_t i = res.size(); i-- > 0; ) {
+        if (++res[i] != 0) {
+            break;
+        }
+    }
+    return res;
+}
+
+Precomputer::Precomputer(const Authenticator& acca, const Authenticator::ct_t& first, size_t depth, predictor_t predict)
+    : acca(acca), depth(std::max<size_t>(depth, 1)), predict(predict), generation(0), working(false), workingGeneration(0), stats(), stopping(false)
+{
+    handle_ptr h(new Authenticator::handle_t);
+    acca.precompute(*h, first);
+    ready.push_back(std::move(h));
+    next = predict(first);
+    worker = std::thread(&Precomputer::run, this);
+}
+
+Precomputer::~Precomputer()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wakeup.notify_all();
+    worker.join();
+}
+
+void Precomputer::authenticate(Authenticator::token_t& t, const Authenticator::ct_t& ct, const Authenticator::st_t& st)
+{
+    ChameleonHash::digest_t stDigest;
+    ChameleonHash::digest(stDigest, st);
+    authenticate(t, ct, stDigest);
+}
+
+void Precomputer::authenticate(Authenticator::token_t& t, const Authenticator::ct_t& ct, const ChameleonHash::digest_t& stDigest)
+{
+    handle_ptr h;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;) {
+            auto it = std::find_if(ready.begin(), ready.end(), [&](const handle_ptr& r) { return r->ct == ct; });
+            if (it != ready.end()) {
+                h = std::move(*it);
+                ready.erase(ready.begin(), it + 1);
+                break;
+            }
+            if (working && workingGeneration == generation && workingCt == ct) {
+                finished.wait(lock);
+            } else if (next == ct) {
+                // the contexts in ready were skipped, which makes space for the worker to compute ct
+                ready.clear();
+                wakeup.notify_one();
+                finished.wait(lock);
+            } else {
+                break;
+            }
+        }
+        if (h) {
+            stats.hits++;
+        } else {
+            stats.misses++;
+            ready.clear();
+            generation++;
+            next = predict(ct);
+        }
+    }
+    wakeup.notify_one();
+
+    if (h) {
+        acca.authenticate(t, *h, stDigest);
+    } else {
+        acca.authenticate(t, ct, stDigest);
+    }
+}
+
+Precomputer::stats_t Precomputer::getStats() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
+
+void Precomputer::run()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+        wakeup.wait(lock, [&]() { return stopping || ready.size() < depth; });
+        if (stopping) {
+            return;
+        }
+        Authenticator::ct_t ct = next;
+        working = true;
+        workingCt = ct;
+        workingGeneration = generation;
+        next = predict(ct);
+        lock.unlock();
+
+        handle_ptr h(new Authenticator::handle_t);
+        acca.precompute(*h, ct);
+
+        lock.lock();
+        working = false;
+        if (workingGeneration == generation) {
+            ready.push_back(std::move(h));
+        }
+        finished.notify_all();
+    }
+}
@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2015 Tim Ruffing <tim.ruffing@mmci.uni-saarland.de>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#ifndef PRECOMPUTER_H
+#define PRECOMPUTER_H
+
+#include "authenticator.h"
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+// Keeps a queue of precomputed handles (see Authenticator::precompute) for the contexts
+// that are expected to be authenticated next, e.g., the following values of a counter, so
+// that authenticate() usually does no elliptic curve work on the calling thread.
+// A worker thread refills the queue in the background. The handles reveal the secret key
+// (see Authenticator::handle_t), so the queue is as sensitive as the key itself and must
+// not be dumped or inspected.
+class Precomputer
+{
+public:
+    // Returns the context expected after ct.
+    typedef std::function<Authenticator::ct_t(const Authenticator::ct_t&)> predictor_t;
+
+    struct stats_t {
+        // authentications that found their handle precomputed or in progress
+        uint64_t hits;
+        uint64_t misses;
+    };
+
+    // The predictor for contexts that are big-endian counters, wrapping around at the end.
+    static Authenticator::ct_t nextCounter(const Authenticator::ct_t& ct);
+
+    // acca must outlive the precomputer. Handles for up to depth contexts, starting with
+    // first, are kept. The handle for first is computed by the constructor, which thus
+    // throws std::logic_error if acca has no secret key.
+    Precomputer(const Authenticator& acca, const Authenticator::ct_t& first, size_t depth, predictor_t predict = nextCounter);
+    ~Precomputer();
+    Precomputer(const Precomputer&) = delete;
+    Precomputer& operator=(const Precomputer&) = delete;
+
+    // Same as Authenticator::authenticate(). The handles for the contexts predicted before ct
+    // are dropped. If ct is not among the predicted contexts, the token is computed without
+    // a handle, and the prediction restarts after ct.
+    void authenticate(Authenticator::token_t& t, const Authenticator::ct_t& ct, const Authenticator::st_t& st);
+    void authenticate(Authenticator::token_t& t, const Authenticator::ct_t& ct, const ChameleonHash::digest_t& stDigest);
+
+    stats_t getStats() const;
+
+private:
+    typedef std::unique_ptr<Authenticator::handle_t> handle_ptr;
+
+    const Authenticator& acca;
+    const size_t depth;
+    const predictor_t predict;
+
+    // protects the following members
+    mutable std::mutex mutex;
+    // signals the worker that there is space in the queue
+    std::condition_variable wakeup;
+    // signals waiting authentications that the worker has finished a handle
+    std::condition_variable finished;
+    std::deque<handle_ptr> ready;
+    // the context after the last one in ready or in progress
+    Authenticator::ct_t next;
+    // Incremented when the prediction restarts, so that a handle in progress for an
+    // old prediction is discarded.
+    uint64_t generation;
+    bool working;
+    Authenticator::ct_t workingCt;
+    uint64_t workingGeneration;
+    stats_t stats;
+    bool stopping;
+
+    std::thread worker;
+
+    void run();
+};
+
+#endif // PRECOMPUTER_H
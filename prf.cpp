@@ -25,43 +25,114 @@
  */
 
 #include "prf.h"
+#include "instrumentation.h"
 #include "node.h"
 
+#include <algorithm>
+#include <stdexcept>
 #include <assert.h>
 
 const unsigned char Prf::X = 'X';
 const unsigned char Prf::R = 'R';
 
-Prf::Prf(Prf::key_t key) : key(key) { }
+Prf::Prf(Prf::key_t key) : key(key), keyed(this->key.data(), this->key.size())
+{
+    Sha256Multi::hmacKey(multiKey, this->key.data(), this->key.size());
+}
 
-Prf::Prf(ChameleonHash::sk_t dsk, bool extract) {
-    if (extract) {
-        secp256k1_sha256_t hash;
-        secp256k1_sha256_initialize(&hash);
-        secp256k1_sha256_write(&hash, dsk.data(), dsk.size());
-        assert(KEY_LEN == 256/8);
-        secp256k1_sha256_finalize(&hash, this->key.data());
+Prf::Prf(const ChameleonHash::sk_t& dsk, size_t ctLen) : Prf(deriveKey(dsk, ctLen)) { }
+
+Prf::key_t Prf::deriveKey(const ChameleonHash::sk_t& dsk, size_t ctLen)
+{
+    if (ctLen == 0 || ctLen > 0xFF) {
+        throw std::invalid_argument("unsupported context length");
     }
+    key_t key;
+    unsigned char len = ctLen;
+    Sha256 hash;
+    hash.write(dsk.data(), dsk.size());
+    hash.write(&len, 1);
+    static_assert(KEY_LEN == Sha256::OUT_LEN, "key length mismatch");
+    hash.finalize(key.data());
+    return key;
+}
+
+template<size_t CtLen>
+void Prf::getX(Prf::out_t& x, const BasicNode<CtLen>& i) const
+{
+    ACCA_PHASE(PHASE_PRF);
+    ACCA_COUNT(PRF_CALLS, 1);
+    typename BasicNode<CtLen>::bytes_t ibytes;
+    i.toBytes(ibytes);
+    get_random_with_prefix(x, ibytes.data(), ibytes.size(), X);
 }
 
-void Prf::getX(Prf::out_t& x, Node& i)
+template<size_t CtLen>
+void Prf::getR(Prf::out_t& r, const BasicNode<CtLen>& i) const
 {
-    Prf::data_t ibytes;
+    ACCA_PHASE(PHASE_PRF);
+    ACCA_COUNT(PRF_CALLS, 1);
+    typename BasicNode<CtLen>::bytes_t ibytes;
     i.toBytes(ibytes);
-    get_random_with_prefix(x, ibytes, X);
+    get_random_with_prefix(r, ibytes.data(), ibytes.size(), R);
 }
 
-void Prf::getR(Prf::out_t& r, Node& i)
+template<size_t CtLen>
+void Prf::getXR(Prf::out_t& x, Prf::out_t& r, const BasicNode<CtLen>& i) const
 {
-    Prf::data_t ibytes;
+    ACCA_PHASE(PHASE_PRF);
+    ACCA_COUNT(PRF_CALLS, 2);
+    typename BasicNode<CtLen>::bytes_t ibytes;
     i.toBytes(ibytes);
-    get_random_with_prefix(r, ibytes, R);
+    get_random_with_prefix(x, ibytes.data(), ibytes.size(), X);
+    get_random_with_prefix(r, ibytes.data(), ibytes.size(), R);
 }
 
-void Prf::get_random_with_prefix(out_t& x, const data_t& data, const unsigned char& prefix)
+template<size_t CtLen>
+void Prf::getXRs(Prf::out_t* xs, Prf::out_t* rs, const BasicNode<CtLen>* nodes, size_t n) const
 {
-    secp256k1_hmac_sha256_initialize(&hash, key.data(), key.size());
-    secp256k1_hmac_sha256_write(&hash, &prefix, 1);
-    secp256k1_hmac_sha256_write(&hash, data.data(), data.size());;
-    secp256k1_hmac_sha256_finalize(&hash, x.data());
+    ACCA_PHASE(PHASE_PRF);
+    ACCA_COUNT(PRF_CALLS, 2*n);
+    static_assert(HASH_LEN == Sha256Multi::OUT_LEN, "wrong output length");
+    const size_t MSG_LEN = 1 + BasicNode<CtLen>::BYTES_LEN;
+    // x and r for CHUNK nodes per call
+    const size_t CHUNK = 32;
+    unsigned char msgs[2*CHUNK][MSG_LEN];
+    const unsigned char* msgPtrs[2*CHUNK];
+    unsigned char out[2*CHUNK * HASH_LEN];
+
+    for (size_t i = 0; i < n; i += CHUNK) {
+        size_t m = std::min(CHUNK, n - i);
+        for (size_t j = 0; j < m; j++) {
+            typename BasicNode<CtLen>::bytes_t ibytes;
+            nodes[i + j].toBytes(ibytes);
+            msgs[2*j][0] = X;
+            msgs[2*j + 1][0] = R;
+            std::copy(ibytes.begin(), ibytes.end(), msgs[2*j] + 1);
+            std::copy(ibytes.begin(), ibytes.end(), msgs[2*j + 1] + 1);
+            msgPtrs[2*j] = msgs[2*j];
+            msgPtrs[2*j + 1] = msgs[2*j + 1];
+        }
+        Sha256Multi::hmac(out, multiKey, msgPtrs, MSG_LEN, 2*m);
+        for (size_t j = 0; j < m; j++) {
+            std::copy_n(out + 2*j*HASH_LEN, HASH_LEN, xs[i + j].begin());
+            std::copy_n(out + (2*j + 1)*HASH_LEN, HASH_LEN, rs[i + j].begin());
+        }
+    }
 }
+
+void Prf::get_random_with_prefix(out_t& x, const unsigned char* data, size_t len, const unsigned char& prefix) const
+{
+    HmacSha256 hash = keyed;
+    hash.write(&prefix, 1);
+    hash.write(data, len);
+    hash.finalize(x.data());
+}
+
+#define INSTANTIATE(n) \
+    template void Prf::getX(Prf::out_t&, const BasicNode<n>&) const; \
+    template void Prf::getR(Prf::out_t&, const BasicNode<n>&) const; \
+    template void Prf::getXR(Prf::out_t&, Prf::out_t&, const BasicNode<n>&) const; \
+    template void Prf::getXRs(Prf::out_t*, Prf::out_t*, const BasicNode<n>*, size_t) const;
+ACCA_FOR_EACH_CT_LEN(INSTANTIATE)
+#undef INSTANTIATE
@@ -28,13 +28,12 @@
 #define PRF_H
 
 #include "chameleonhash.h"
+#include "sha256.h"
+#include "sha256multi.h"
 
 #include <assert.h>
 
-#include "secp256k1/src/hash.h"
-#include "secp256k1/src/hash_impl.h"
-
-class Node;
+template<size_t CtLen> class BasicNode;
 
 class Prf
 {
@@ -44,21 +43,35 @@ public:
 
     typedef std::array<unsigned char, KEY_LEN> key_t;
     typedef std::array<unsigned char, HASH_LEN> out_t;
-    typedef std::vector<unsigned char> data_t;
 
     Prf(key_t key);
-    Prf(ChameleonHash::sk_t dsk, bool extract);
+    // Derive the key from dsk and the context length of the tree, such that trees of
+    // different depths for the same dsk use independent x and r values.
+    Prf(const ChameleonHash::sk_t& dsk, size_t ctLen);
 
-    void getX(out_t& x, Node& i);
-    void getR(out_t& r, Node& i);
+    template<size_t CtLen>
+    void getX(out_t& x, const BasicNode<CtLen>& i) const;
+    template<size_t CtLen>
+    void getR(out_t& r, const BasicNode<CtLen>& i) const;
+    // Same as getX and getR but encodes the node only once.
+    template<size_t CtLen>
+    void getXR(out_t& x, out_t& r, const BasicNode<CtLen>& i) const;
+    // Same as getXR for n nodes, using multi-buffer hashing.
+    template<size_t CtLen>
+    void getXRs(out_t* xs, out_t* rs, const BasicNode<CtLen>* nodes, size_t n) const;
 
 private:
-    secp256k1_hmac_sha256_t hash;
     key_t key;
+    // HMAC state after absorbing the key, i.e., the inner and outer midstates.
+    // Copying it saves the two compressions of the key blocks per evaluation.
+    HmacSha256 keyed;
+    Sha256Multi::hmac_key_t multiKey;
+
+    static key_t deriveKey(const ChameleonHash::sk_t& dsk, size_t ctLen);
 
     static const unsigned char X;
     static const unsigned char R;
-    void get_random_with_prefix(out_t& x, const data_t& data, const unsigned char& R);
+    void get_random_with_prefix(out_t& x, const unsigned char* data, size_t len, const unsigned char& R) const;
 };
 
 #endif // PRF_H
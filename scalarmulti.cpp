@@ -0,0 +1,426 @@
+/*
+ * Copyright (c) 2015 Tim Ruffing <tim.ruffing@mmci.uni-saarland.de>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#include "scalarmulti.h"
+#include "chameleonhash.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define SCALARMULTI_X86
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// little-endian 64-bit limbs
+typedef std::array<uint64_t, 4> limbs_t;
+
+const limbs_t ORDER = {{
+    0xbfd25e8cd0364141ULL, 0xbaaedce6af48a03bULL, 0xfffffffffffffffeULL, 0xffffffffffffffffULL
+}};
+
+// 2^520 mod n, i.e., R^2 for the Montgomery radix R = 2^260 of both vector kernels
+const limbs_t R2 = {{
+    0xc8ee180c268b3b23ULL, 0x97594894fd6e33e4ULL, 0x97f5e45bcd07c73bULL, 0x671cd581c69bc5e6ULL
+}};
+
+inline void load(limbs_t& r, const ScalarMulti::scalar_t& in)
+{
+    for (size_t i = 0; i < 4; i++) {
+        uint64_t v;
+        memcpy(&v, in.data() + 24 - 8*i, 8);
+        r[i] = __builtin_bswap64(v);
+    }
+}
+
+inline void store(ScalarMulti::scalar_t& out, const limbs_t& x)
+{
+    for (size_t i = 0; i < 4; i++) {
+        uint64_t v = __builtin_bswap64(x[i]);
+        memcpy(out.data() + 24 - 8*i, &v, 8);
+    }
+}
+
+inline bool belowOrder(const limbs_t& x)
+{
+    for (size_t i = 4; i-- > 0; ) {
+        if (x[i] != ORDER[i]) {
+            return x[i] < ORDER[i];
+        }
+    }
+    return false;
+}
+
+// r = a - b mod 2^256, returns the borrow
+inline uint64_t sub(limbs_t& r, const limbs_t& a, const limbs_t& b)
+{
+    uint64_t borrow = 0;
+    for (size_t i = 0; i < 4; i++) {
+        uint64_t ai = a[i], bi = b[i];
+        r[i] = ai - bi - borrow;
+        borrow = (ai < bi) | ((ai == bi) & borrow);
+    }
+    return borrow;
+}
+
+// r = a + b mod 2^256, returns the carry
+inline uint64_t add(limbs_t& r, const limbs_t& a, const limbs_t& b)
+{
+    uint64_t carry = 0;
+    for (size_t i = 0; i < 4; i++) {
+        uint64_t s = a[i] + b[i];
+        uint64_t c = s < b[i];
+        r[i] = s + carry;
+        carry = c | (r[i] < s);
+    }
+    return carry;
+}
+
+// The reductions are branch-free, since the borrows and carries of random scalars are
+// unpredictable.
+inline void subModOrder(limbs_t& r, const limbs_t& a, const limbs_t& b)
+{
+    const uint64_t mask = -sub(r, a, b);
+    const limbs_t correction = {{ ORDER[0] & mask, ORDER[1] & mask, ORDER[2] & mask, ORDER[3] & mask }};
+    add(r, r, correction);
+}
+
+inline void addModOrder(limbs_t& r, const limbs_t& a, const limbs_t& b)
+{
+    limbs_t reduced;
+    const uint64_t carry = add(r, a, b);
+    const uint64_t borrow = sub(reduced, r, ORDER);
+    // r - n is the result if the sum is at least n
+    const uint64_t mask = -(carry | (borrow ^ 1));
+    for (size_t i = 0; i < 4; i++) {
+        r[i] = (reduced[i] & mask) | (r[i] & ~mask);
+    }
+}
+
+std::atomic<int>& selectedKernel()
+{
+    static std::atomic<int> kernel(ScalarMulti::bestKernel());
+    return kernel;
+}
+
+#ifdef SCALARMULTI_X86
+// The vector kernels work on values split into limbs of a few bits each, with the limbs
+// of all lanes interleaved: limb j of lane l is at index j*lanes + l.
+inline void split(uint64_t* out, size_t lanes, const limbs_t& x, unsigned bits, size_t limbs)
+{
+    const uint64_t mask = (1ULL << bits) - 1;
+    for (size_t j = 0; j < limbs; j++) {
+        size_t k = j*bits / 64, off = j*bits % 64;
+        uint64_t v = x[k] >> off;
+        if (off && k + 1 < 4) {
+            v |= x[k+1] << (64 - off);
+        }
+        out[j*lanes] = v & mask;
+    }
+}
+
+// Inverse of split() for normalized limbs of a value below 2n, which is reduced modulo n.
+inline void join(limbs_t& x, const uint64_t* in, size_t lanes, unsigned bits, size_t limbs)
+{
+    uint64_t w[5] = { 0 };
+    for (size_t j = 0; j < limbs; j++) {
+        size_t k = j*bits / 64, off = j*bits % 64;
+        w[k] |= in[j*lanes] << off;
+        if (off) {
+            w[k+1] |= in[j*lanes] >> (64 - off);
+        }
+    }
+    limbs_t reduced;
+    std::copy_n(w, 4, x.begin());
+    const uint64_t borrow = sub(reduced, x, ORDER);
+    const uint64_t mask = -(w[4] | (borrow ^ 1));
+    for (size_t i = 0; i < 4; i++) {
+        x[i] = (reduced[i] & mask) | (x[i] & ~mask);
+    }
+}
+
+// Computes the Montgomery products r = a * b / 2^260 mod n of all lanes. The limbs of a
+// and b must be normalized, and a * b must be below n * 2^260, e.g., a below 2n and b below n.
+// The limbs of r are normalized and r is below 2n. r may alias a or b.
+typedef void (*montmul_fn)(uint64_t* r, const uint64_t* a, const uint64_t* b);
+
+// n in 26-bit limbs and -1/n mod 2^26
+const uint64_t ORDER26[10] = {
+    0x364141, 0x97a334, 0x203bbfd, 0x39abd22, 0x2baaedc, 0x3ffffff, 0x3ffffff, 0x3ffffff, 0x3ffffff, 0x3fffff
+};
+const uint64_t ORDER26_INV = 0x188b13f;
+
+// Four lanes with 26-bit limbs, so that the 32x32-bit multiplications of AVX2 suffice and
+// the products can be accumulated without carries. The outer loop has to be unrolled to keep
+// the accumulators in registers.
+__attribute__((target("avx2"))) void montMul4(uint64_t* r, const uint64_t* a, const uint64_t* b)
+{
+    const size_t L = 4, LIMBS = 10, BITS = 26;
+    const __m256i mask = _mm256_set1_epi64x((1ULL << BITS) - 1);
+    const __m256i inv = _mm256_set1_epi64x(ORDER26_INV);
+    __m256i t[LIMBS];
+    for (size_t j = 0; j < LIMBS; j++) {
+        t[j] = _mm256_setzero_si256();
+    }
+#pragma GCC unroll 10
+    for (size_t i = 0; i < LIMBS; i++) {
+        __m256i ai = _mm256_load_si256((const __m256i*) (a + i*L));
+        for (size_t j = 0; j < LIMBS; j++) {
+            __m256i bj = _mm256_load_si256((const __m256i*) (b + j*L));
+            t[j] = _mm256_add_epi64(t[j], _mm256_mul_epu32(ai, bj));
+        }
+        __m256i q = _mm256_and_si256(_mm256_mul_epu32(t[0], inv), mask);
+        for (size_t j = 0; j < LIMBS; j++) {
+            t[j] = _mm256_add_epi64(t[j], _mm256_mul_epu32(q, _mm256_set1_epi64x(ORDER26[j])));
+        }
+        // the lowest limb is divisible by 2^26 now
+        __m256i carry = _mm256_srli_epi64(t[0], BITS);
+        for (size_t j = 0; j + 1 < LIMBS; j++) {
+            t[j] = t[j+1];
+        }
+        t[0] = _mm256_add_epi64(t[0], carry);
+        t[LIMBS-1] = _mm256_setzero_si256();
+    }
+    for (size_t j = 0; j + 1 < LIMBS; j++) {
+        t[j+1] = _mm256_add_epi64(t[j+1], _mm256_srli_epi64(t[j], BITS));
+        t[j] = _mm256_and_si256(t[j], mask);
+    }
+    for (size_t j = 0; j < LIMBS; j++) {
+        _mm256_store_si256((__m256i*) (r + j*L), t[j]);
+    }
+}
+
+// n in 52-bit limbs and -1/n mod 2^52
+const uint64_t ORDER52[5] = {
+    0x25e8cd0364141, 0xe6af48a03bbfd, 0xffffffebaaedc, 0xfffffffffffff, 0xffffffffffff
+};
+const uint64_t ORDER52_INV = 0xdff665588b13f;
+
+typedef uint64_t v8u64 __attribute__((vector_size(64)));
+
+// Eight lanes with 52-bit limbs, using the 52x52-bit multiply-accumulate of AVX-512 IFMA.
+// The shifts use vector extensions, since the intrinsics trigger bogus uninitialized warnings in GCC.
+__attribute__((target("avx512f,avx512ifma"))) void montMul8(uint64_t* r, const uint64_t* a, const uint64_t* b)
+{
+    const size_t L = 8, LIMBS = 5, BITS = 52;
+    const __m512i zero = _mm512_setzero_si512();
+    const __m512i mask = _mm512_set1_epi64((1ULL << BITS) - 1);
+    const __m512i inv = _mm512_set1_epi64(ORDER52_INV);
+    __m512i bv[LIMBS], nv[LIMBS], t[LIMBS + 1];
+    for (size_t j = 0; j < LIMBS; j++) {
+        bv[j] = _mm512_load_si512(b + j*L);
+        nv[j] = _mm512_set1_epi64(ORDER52[j]);
+        t[j] = zero;
+    }
+    t[LIMBS] = zero;
+    for (size_t i = 0; i < LIMBS; i++) {
+        __m512i ai = _mm512_load_si512(a + i*L);
+        for (size_t j = 0; j < LIMBS; j++) {
+            t[j] = _mm512_madd52lo_epu64(t[j], ai, bv[j]);
+            t[j+1] = _mm512_madd52hi_epu64(t[j+1], ai, bv[j]);
+        }
+        __m512i q = _mm512_madd52lo_epu64(zero, t[0], inv);
+        for (size_t j = 0; j < LIMBS; j++) {
+            t[j] = _mm512_madd52lo_epu64(t[j], q, nv[j]);
+            t[j+1] = _mm512_madd52hi_epu64(t[j+1], q, nv[j]);
+        }
+        // the lowest limb is divisible by 2^52 now
+        __m512i carry = (__m512i) ((v8u64) t[0] >> BITS);
+        for (size_t j = 0; j < LIMBS; j++) {
+            t[j] = t[j+1];
+        }
+        t[0] = _mm512_add_epi64(t[0], carry);
+        t[LIMBS] = zero;
+    }
+    for (size_t j = 0; j + 1 < LIMBS; j++) {
+        t[j+1] = _mm512_add_epi64(t[j+1], (__m512i) ((v8u64) t[j] >> BITS));
+        t[j] = _mm512_and_si512(t[j], mask);
+    }
+    for (size_t j = 0; j < LIMBS; j++) {
+        _mm512_store_si512(r + j*L, t[j]);
+    }
+}
+
+// The operations of ScalarMulti for a kernel with L lanes and LIMBS limbs of BITS bits.
+template<size_t L, size_t LIMBS, unsigned BITS>
+void subMulAddLanes(montmul_fn montMul, ScalarMulti::scalar_t* out, const ScalarMulti::scalar_t* a, const ScalarMulti::scalar_t* b,
+                    const ScalarMulti::scalar_t& c, const ScalarMulti::scalar_t* d, size_t count)
+{
+    alignas(64) uint64_t xs[LIMBS * L] = {}, ys[LIMBS * L], rs[LIMBS * L];
+    limbs_t x, y;
+    // Montgomery products with c*R are the plain products with c.
+    load(x, c);
+    for (size_t l = 0; l < L; l++) {
+        split(xs + l, L, x, BITS, LIMBS);
+        split(ys + l, L, R2, BITS, LIMBS);
+    }
+    montMul(ys, xs, ys);
+    for (size_t i = 0; i < count; i += L) {
+        const size_t m = std::min(L, count - i);
+        for (size_t l = 0; l < m; l++) {
+            load(x, a[i+l]);
+            load(y, b[i+l]);
+            subModOrder(x, x, y);
+            split(xs + l, L, x, BITS, LIMBS);
+        }
+        montMul(rs, xs, ys);
+        for (size_t l = 0; l < m; l++) {
+            join(x, rs + l, L, BITS, LIMBS);
+            load(y, d[i+l]);
+            addModOrder(x, x, y);
+            store(out[i+l], x);
+        }
+    }
+}
+
+template<size_t L, size_t LIMBS, unsigned BITS>
+void subMulLanes(montmul_fn montMul, ScalarMulti::scalar_t* out, const ScalarMulti::scalar_t* a, const ScalarMulti::scalar_t* b,
+                 const ScalarMulti::scalar_t* c, size_t count)
+{
+    alignas(64) uint64_t xs[LIMBS * L] = {}, ys[LIMBS * L] = {}, r2s[LIMBS * L];
+    limbs_t x, y;
+    for (size_t l = 0; l < L; l++) {
+        split(r2s + l, L, R2, BITS, LIMBS);
+    }
+    for (size_t i = 0; i < count; i += L) {
+        const size_t m = std::min(L, count - i);
+        for (size_t l = 0; l < m; l++) {
+            load(x, a[i+l]);
+            load(y, b[i+l]);
+            subModOrder(x, x, y);
+            split(xs + l, L, x, BITS, LIMBS);
+            load(y, c[i+l]);
+            split(ys + l, L, y, BITS, LIMBS);
+        }
+        // (a - b) * c / R, and then times R^2 / R
+        montMul(xs, xs, ys);
+        montMul(xs, xs, r2s);
+        for (size_t l = 0; l < m; l++) {
+            join(x, xs + l, L, BITS, LIMBS);
+            store(out[i+l], x);
+        }
+    }
+}
+#endif
+
+}
+
+void ScalarMulti::subMulAdd(scalar_t* out, const scalar_t* a, const scalar_t* b, const scalar_t& c, const scalar_t* d, size_t count)
+{
+    int kernel = selectedKernel().load(std::memory_order_relaxed);
+#ifdef SCALARMULTI_X86
+    if (kernel >= AVX512IFMA) {
+        subMulAddLanes<8, 5, 52>(montMul8, out, a, b, c, d, count);
+        return;
+    }
+    if (kernel >= AVX2) {
+        subMulAddLanes<4, 10, 26>(montMul4, out, a, b, c, d, count);
+        return;
+    }
+#else
+    (void) kernel;
+#endif
+    secp256k1_scalar_t cs;
+    secp256k1_scalar_set_b32(&cs, c.data(), nullptr);
+    for (size_t i = 0; i < count; i++) {
+        secp256k1_scalar_t x, y;
+        secp256k1_scalar_set_b32(&x, a[i].data(), nullptr);
+        secp256k1_scalar_set_b32(&y, b[i].data(), nullptr);
+        secp256k1_scalar_negate(&y, &y);
+        secp256k1_scalar_add(&x, &x, &y);
+        secp256k1_scalar_mul(&x, &x, &cs);
+        secp256k1_scalar_set_b32(&y, d[i].data(), nullptr);
+        secp256k1_scalar_add(&x, &x, &y);
+        secp256k1_scalar_get_b32(out[i].data(), &x);
+    }
+}
+
+void ScalarMulti::subMul(scalar_t* out, const scalar_t* a, const scalar_t* b, const scalar_t* c, size_t count)
+{
+    int kernel = selectedKernel().load(std::memory_order_relaxed);
+#ifdef SCALARMULTI_X86
+    if (kernel >= AVX512IFMA) {
+        subMulLanes<8, 5, 52>(montMul8, out, a, b, c, count);
+        return;
+    }
+    if (kernel >= AVX2) {
+        subMulLanes<4, 10, 26>(montMul4, out, a, b, c, count);
+        return;
+    }
+#else
+    (void) kernel;
+#endif
+    for (size_t i = 0; i < count; i++) {
+        secp256k1_scalar_t x, y;
+        secp256k1_scalar_set_b32(&x, a[i].data(), nullptr);
+        secp256k1_scalar_set_b32(&y, b[i].data(), nullptr);
+        secp256k1_scalar_negate(&y, &y);
+        secp256k1_scalar_add(&x, &x, &y);
+        secp256k1_scalar_set_b32(&y, c[i].data(), nullptr);
+        secp256k1_scalar_mul(&x, &x, &y);
+        secp256k1_scalar_get_b32(out[i].data(), &x);
+    }
+}
+
+bool ScalarMulti::isBelowOrder(const scalar_t& x)
+{
+    limbs_t xl;
+    load(xl, x);
+    return belowOrder(xl);
+}
+
+ScalarMulti::kernel_t ScalarMulti::bestKernel()
+{
+#ifdef SCALARMULTI_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512ifma")) {
+        return AVX512IFMA;
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        return AVX2;
+    }
+#endif
+    return SCALAR;
+}
+
+ScalarMulti::kernel_t ScalarMulti::getKernel()
+{
+    return (kernel_t) selectedKernel().load();
+}
+
+void ScalarMulti::setKernel(ScalarMulti::kernel_t kernel)
+{
+    if (kernel > SCALAR && kernel > bestKernel()) {
+        throw std::invalid_argument("kernel not supported by this CPU");
+    }
+    selectedKernel().store(kernel);
+}
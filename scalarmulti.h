@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2015 Tim Ruffing <tim.ruffing@mmci.uni-saarland.de>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#ifndef SCALARMULTI_H
+#define SCALARMULTI_H
+
+#include <array>
+#include <cstddef>
+
+// Multi-lane arithmetic modulo the order n of the secp256k1 group, for the many
+// independent scalar operations of the batched code paths, e.g., the collisions of
+// several tokens on the same level. On x86, an 8-way AVX-512 IFMA kernel or a 4-way
+// AVX2 kernel computes Montgomery products in SIMD lanes, selected at runtime depending
+// on the CPU; otherwise the scalar arithmetic of libsecp256k1 is used.
+//
+// Scalars are encoded in 32 bytes big-endian as in ChameleonHash, and all inputs must
+// be below n. Outputs may alias inputs.
+class ScalarMulti
+{
+public:
+    static const size_t LEN = 32;
+    typedef std::array<unsigned char, LEN> scalar_t;
+
+    enum kernel_t { SCALAR = 1, AVX2 = 4, AVX512IFMA = 8 };
+
+    // out[i] = (a[i] - b[i]) * c + d[i] for i = 0, ..., count-1, e.g., the collisions
+    // r2 = (d1 - d2)/sk + r1 under a single key.
+    static void subMulAdd(scalar_t* out, const scalar_t* a, const scalar_t* b, const scalar_t& c, const scalar_t* d, size_t count);
+    // out[i] = (a[i] - b[i]) * c[i] for i = 0, ..., count-1, e.g., the keys
+    // sk = (d1 - d2)/(r2 - r1) of several collisions.
+    static void subMul(scalar_t* out, const scalar_t* a, const scalar_t* b, const scalar_t* c, size_t count);
+
+    static bool isBelowOrder(const scalar_t& x);
+
+    // The widest kernel supported by the CPU.
+    static kernel_t bestKernel();
+    static kernel_t getKernel();
+    // Restricts the arithmetic to the given kernel, e.g., for testing. Throws
+    // std::invalid_argument if the CPU does not support it.
+    static void setKernel(kernel_t kernel);
+};
+
+#endif // SCALARMULTI_H
@@ -0,0 +1,234 @@
+/*
+ * Copyright (c) 2015 Tim Ruffing <tim.ruffing@mmci.uni-saarland.de>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#include "sha256.h"
+#include "instrumentation.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SHA256_X86
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+const uint32_t Sha256::K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+const std::array<uint32_t, 8> Sha256::IV = {{
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+}};
+
+namespace {
+
+#ifdef SHA256_X86
+// Compresses n consecutive blocks using the SHA extensions.
+__attribute__((target("sha,sse4.1,ssse3"))) void compressShaNi(uint32_t* state, const unsigned char* blocks, size_t n)
+{
+    const __m128i MASK = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+    // the instructions expect the state as ABEF and CDGH
+    __m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*) &state[0]), 0xB1);
+    __m128i state1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*) &state[4]), 0x1B);
+    __m128i state0 = _mm_alignr_epi8(tmp, state1, 8);
+    state1 = _mm_blend_epi16(state1, tmp, 0xF0);
+
+    for (size_t b = 0; b < n; b++) {
+        const unsigned char* block = blocks + b*Sha256::BLOCK_LEN;
+        __m128i abefSave = state0;
+        __m128i cdghSave = state1;
+        __m128i m[4];
+
+        // four rounds per iteration; m[g % 4] holds the message words of rounds 4g, ..., 4g+3
+        for (size_t g = 0; g < 16; g++) {
+            if (g < 4) {
+                m[g] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*) (block + 16*g)), MASK);
+            }
+            __m128i msg = _mm_add_epi32(m[g & 3], _mm_loadu_si128((const __m128i*) &Sha256::K[4*g]));
+            state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+            if (g >= 3 && g <= 14) {
+                __m128i& next = m[(g + 1) & 3];
+                next = _mm_add_epi32(next, _mm_alignr_epi8(m[g & 3], m[(g - 1) & 3], 4));
+                next = _mm_sha256msg2_epu32(next, m[g & 3]);
+            }
+            msg = _mm_shuffle_epi32(msg, 0x0E);
+            state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+            if (g >= 1 && g <= 12) {
+                m[(g - 1) & 3] = _mm_sha256msg1_epu32(m[(g - 1) & 3], m[g & 3]);
+            }
+        }
+
+        state0 = _mm_add_epi32(state0, abefSave);
+        state1 = _mm_add_epi32(state1, cdghSave);
+    }
+
+    tmp = _mm_shuffle_epi32(state0, 0x1B);
+    state1 = _mm_shuffle_epi32(state1, 0xB1);
+    state0 = _mm_blend_epi16(tmp, state1, 0xF0);
+    state1 = _mm_alignr_epi8(state1, tmp, 8);
+    _mm_storeu_si128((__m128i*) &state[0], state0);
+    _mm_storeu_si128((__m128i*) &state[4], state1);
+}
+#endif
+
+std::atomic<bool>& acceleratedFlag()
+{
+    static std::atomic<bool> flag(Sha256::hasShaExtensions());
+    return flag;
+}
+
+}
+
+Sha256::Sha256() : accelerated(acceleratedFlag().load(std::memory_order_relaxed)), s(IV), bytes(0)
+{
+    if (!accelerated) {
+        secp256k1_sha256_initialize(&fallback);
+    }
+}
+
+void Sha256::write(const unsigned char* data, size_t len)
+{
+    size_t used = bytes % BLOCK_LEN;
+    bytes += len;
+    ACCA_COUNT(SHA_COMPRESSIONS, (used + len) / BLOCK_LEN);
+    if (!accelerated) {
+        secp256k1_sha256_write(&fallback, data, len);
+        return;
+    }
+#ifdef SHA256_X86
+    if (used) {
+        size_t fill = std::min(len, BLOCK_LEN - used);
+        memcpy(buf + used, data, fill);
+        data += fill;
+        len -= fill;
+        if (used + fill < BLOCK_LEN) {
+            return;
+        }
+        compressShaNi(s.data(), buf, 1);
+    }
+    size_t full = len / BLOCK_LEN;
+    compressShaNi(s.data(), data, full);
+    memcpy(buf, data + full*BLOCK_LEN, len % BLOCK_LEN);
+#endif
+}
+
+void Sha256::finalize(unsigned char* out)
+{
+    size_t padLen = 1 + ((BLOCK_LEN + 55 - bytes % BLOCK_LEN) % BLOCK_LEN);
+    if (!accelerated) {
+        ACCA_COUNT(SHA_COMPRESSIONS, (bytes % BLOCK_LEN + padLen + 8) / BLOCK_LEN);
+        secp256k1_sha256_finalize(&fallback, out);
+        return;
+    }
+    unsigned char pad[BLOCK_LEN + 8] = { 0x80 };
+    uint64_t bits = bytes * 8;
+    for (size_t i = 0; i < 8; i++) {
+        pad[padLen + i] = bits >> (56 - 8*i);
+    }
+    write(pad, padLen + 8);
+    for (size_t j = 0; j < 8; j++) {
+        out[4*j] = s[j] >> 24;
+        out[4*j + 1] = s[j] >> 16;
+        out[4*j + 2] = s[j] >> 8;
+        out[4*j + 3] = s[j];
+    }
+}
+
+bool Sha256::hasShaExtensions()
+{
+#ifdef SHA256_X86
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx) || !(ecx & bit_SSE4_1) || !(ecx & bit_SSSE3)) {
+        return false;
+    }
+    if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+        return false;
+    }
+    return ebx & (1 << 29);
+#else
+    return false;
+#endif
+}
+
+bool Sha256::getAccelerated()
+{
+    return acceleratedFlag().load();
+}
+
+void Sha256::setAccelerated(bool accelerated)
+{
+    if (accelerated && !hasShaExtensions()) {
+        throw std::invalid_argument("SHA extensions not supported by this CPU");
+    }
+    acceleratedFlag().store(accelerated);
+}
+
+HmacSha256::HmacSha256(const unsigned char* key, size_t len)
+{
+    unsigned char block[Sha256::BLOCK_LEN] = {};
+    if (len > Sha256::BLOCK_LEN) {
+        Sha256 hash;
+        hash.write(key, len);
+        hash.finalize(block);
+    } else {
+        memcpy(block, key, len);
+    }
+
+    unsigned char pad[Sha256::BLOCK_LEN];
+    for (size_t i = 0; i < Sha256::BLOCK_LEN; i++) {
+        pad[i] = block[i] ^ 0x36;
+    }
+    inner.write(pad, Sha256::BLOCK_LEN);
+    for (size_t i = 0; i < Sha256::BLOCK_LEN; i++) {
+        pad[i] = block[i] ^ 0x5c;
+    }
+    outer.write(pad, Sha256::BLOCK_LEN);
+}
+
+void HmacSha256::write(const unsigned char* data, size_t len)
+{
+    inner.write(data, len);
+}
+
+void HmacSha256::finalize(unsigned char* out)
+{
+    unsigned char t[Sha256::OUT_LEN];
+    inner.finalize(t);
+    outer.write(t, Sha256::OUT_LEN);
+    outer.finalize(out);
+}
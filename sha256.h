@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2015 Tim Ruffing <tim.ruffing@mmci.uni-saarland.de>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#ifndef SHA256_H
+#define SHA256_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "secp256k1-macros.h"
+#include "secp256k1/src/hash.h"
+#include "secp256k1/src/hash_impl.h"
+
+// Streaming SHA-256. If the CPU supports the x86 SHA extensions, blocks are
+// compressed with them, otherwise the implementation of libsecp256k1 is used.
+// The choice is made once at runtime and applies to objects constructed later.
+class Sha256
+{
+public:
+    static const size_t OUT_LEN = 32;
+    static const size_t BLOCK_LEN = 64;
+    // the round constants, shared with Sha256Multi
+    static const uint32_t K[64];
+    static const std::array<uint32_t, 8> IV;
+
+    Sha256();
+    void write(const unsigned char* data, size_t len);
+    void finalize(unsigned char* out);
+
+    // Whether the CPU supports the SHA extensions.
+    static bool hasShaExtensions();
+    static bool getAccelerated();
+    // Switches the SHA extensions on or off, e.g., for testing and benchmarking.
+    // Throws std::invalid_argument if they are not supported by the CPU.
+    static void setAccelerated(bool accelerated);
+
+private:
+    bool accelerated;
+    secp256k1_sha256_t fallback;
+    std::array<uint32_t, 8> s;
+    unsigned char buf[BLOCK_LEN];
+    uint64_t bytes;
+};
+
+// HMAC-SHA256. Copying a keyed object is cheaper than keying a new one.
+class HmacSha256
+{
+public:
+    HmacSha256(const unsigned char* key, size_t len);
+    void write(const unsigned char* data, size_t len);
+    void finalize(unsigned char* out);
+
+private:
+    Sha256 inner;
+    Sha256 outer;
+};
+
+#endif // SHA256_H
@@ -0,0 +1,277 @@
+/*
+ * Copyright (c) 2015 Tim Ruffing <tim.ruffing@mmci.uni-saarland.de>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#include "sha256multi.h"
+#include "sha256.h"
+#include "instrumentation.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SHA256MULTI_X86
+#endif
+
+namespace {
+
+inline uint32_t readBE32(const unsigned char* p)
+{
+    return (uint32_t) p[0] << 24 | (uint32_t) p[1] << 16 | (uint32_t) p[2] << 8 | (uint32_t) p[3];
+}
+
+inline void writeBE32(unsigned char* p, uint32_t x)
+{
+    p[0] = x >> 24;
+    p[1] = x >> 16;
+    p[2] = x >> 8;
+    p[3] = x;
+}
+
+#define ROTR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+// Compresses one block per lane. Word j of the state of lane l is state[j*L + l].
+// V is either uint32_t (L = 1) or a vector of L uint32_t, so the same code serves
+// as scalar and as SIMD kernel.
+template<typename V, size_t L>
+inline __attribute__((always_inline)) void compressLanes(uint32_t* state, const unsigned char* const* blocks)
+{
+    static_assert(sizeof(V) == L * sizeof(uint32_t), "wrong number of lanes");
+    V w[16];
+    for (size_t t = 0; t < 16; t++) {
+        uint32_t lanes[L];
+        for (size_t l = 0; l < L; l++) {
+            lanes[l] = readBE32(blocks[l] + 4*t);
+        }
+        memcpy(&w[t], lanes, sizeof w[t]);
+    }
+
+    V s[8];
+    memcpy(s, state, sizeof s);
+    V a = s[0], b = s[1], c = s[2], d = s[3], e = s[4], f = s[5], g = s[6], h = s[7];
+
+    for (size_t t = 0; t < 64; t++) {
+        if (t >= 16) {
+            V w15 = w[(t - 15) & 15];
+            V w2 = w[(t - 2) & 15];
+            w[t & 15] += (ROTR(w15, 7) ^ ROTR(w15, 18) ^ (w15 >> 3)) + w[(t - 7) & 15]
+                + (ROTR(w2, 17) ^ ROTR(w2, 19) ^ (w2 >> 10));
+        }
+        V t1 = h + (ROTR(e, 6) ^ ROTR(e, 11) ^ ROTR(e, 25)) + ((e & f) ^ (~e & g)) + Sha256::K[t] + w[t & 15];
+        V t2 = (ROTR(a, 2) ^ ROTR(a, 13) ^ ROTR(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+
+    s[0] += a; s[1] += b; s[2] += c; s[3] += d;
+    s[4] += e; s[5] += f; s[6] += g; s[7] += h;
+    memcpy(state, s, sizeof s);
+}
+
+#undef ROTR
+
+typedef void (*compress_fn)(uint32_t* state, const unsigned char* const* blocks);
+
+void compress1(uint32_t* state, const unsigned char* const* blocks)
+{
+    compressLanes<uint32_t, 1>(state, blocks);
+}
+
+#ifdef SHA256MULTI_X86
+typedef uint32_t v4u32 __attribute__((vector_size(16)));
+typedef uint32_t v8u32 __attribute__((vector_size(32)));
+
+__attribute__((target("sse2"))) void compress4(uint32_t* state, const unsigned char* const* blocks)
+{
+    compressLanes<v4u32, 4>(state, blocks);
+}
+
+__attribute__((target("avx2"))) void compress8(uint32_t* state, const unsigned char* const* blocks)
+{
+    compressLanes<v8u32, 8>(state, blocks);
+}
+#endif
+
+// Hashes L messages with the L-lane kernel compress.
+template<size_t L>
+void hashLanes(compress_fn compress, unsigned char* out, const Sha256Multi::midstate_t& init, const unsigned char* const* msgs, size_t len)
+{
+    const size_t B = Sha256Multi::BLOCK_LEN;
+    uint32_t state[8 * L];
+    for (size_t j = 0; j < 8; j++) {
+        std::fill_n(state + j*L, L, init.s[j]);
+    }
+
+    const unsigned char* blocks[L];
+    size_t full = len / B;
+    for (size_t i = 0; i < full; i++) {
+        for (size_t l = 0; l < L; l++) {
+            blocks[l] = msgs[l] + i*B;
+        }
+        compress(state, blocks);
+    }
+
+    // the remaining bytes, the 0x80 byte and the 64-bit length fit into one or two blocks
+    size_t rest = len % B;
+    size_t tailLen = rest + 9 <= B ? B : 2*B;
+    uint64_t bits = (init.bytes + len) * 8;
+    unsigned char tail[L][2*B];
+    for (size_t l = 0; l < L; l++) {
+        memcpy(tail[l], msgs[l] + full*B, rest);
+        tail[l][rest] = 0x80;
+        memset(tail[l] + rest + 1, 0, tailLen - rest - 9);
+        writeBE32(tail[l] + tailLen - 8, bits >> 32);
+        writeBE32(tail[l] + tailLen - 4, bits);
+    }
+    for (size_t off = 0; off < tailLen; off += B) {
+        for (size_t l = 0; l < L; l++) {
+            blocks[l] = tail[l] + off;
+        }
+        compress(state, blocks);
+    }
+
+    for (size_t l = 0; l < L; l++) {
+        for (size_t j = 0; j < 8; j++) {
+            writeBE32(out + l*Sha256Multi::OUT_LEN + 4*j, state[j*L + l]);
+        }
+    }
+}
+
+std::atomic<int>& selectedKernel()
+{
+    static std::atomic<int> kernel(Sha256Multi::bestKernel());
+    return kernel;
+}
+
+}
+
+Sha256Multi::midstate_t Sha256Multi::initial()
+{
+    return midstate_t{Sha256::IV, 0};
+}
+
+void Sha256Multi::hmacKey(Sha256Multi::hmac_key_t& key, const unsigned char* k, size_t len)
+{
+    unsigned char block[BLOCK_LEN] = {};
+    if (len > BLOCK_LEN) {
+        hash(block, initial(), &k, len, 1);
+    } else {
+        memcpy(block, k, len);
+    }
+
+    unsigned char pad[BLOCK_LEN];
+    const unsigned char* p = pad;
+    for (size_t i = 0; i < BLOCK_LEN; i++) {
+        pad[i] = block[i] ^ 0x36;
+    }
+    key.inner = initial();
+    compress1(key.inner.s.data(), &p);
+    key.inner.bytes = BLOCK_LEN;
+
+    for (size_t i = 0; i < BLOCK_LEN; i++) {
+        pad[i] = block[i] ^ 0x5c;
+    }
+    key.outer = initial();
+    compress1(key.outer.s.data(), &p);
+    key.outer.bytes = BLOCK_LEN;
+    ACCA_COUNT(SHA_COMPRESSIONS, 2);
+}
+
+void Sha256Multi::hash(unsigned char* out, const Sha256Multi::midstate_t& init, const unsigned char* const* msgs, size_t len, size_t n)
+{
+    // the messages are padded to full blocks after the midstate
+    ACCA_COUNT(SHA_COMPRESSIONS, n * ((len + 8) / BLOCK_LEN + 1));
+    int kernel = selectedKernel().load(std::memory_order_relaxed);
+    size_t i = 0;
+#ifdef SHA256MULTI_X86
+    if (kernel >= AVX2) {
+        for (; n - i >= 8; i += 8) {
+            hashLanes<8>(compress8, out + i*OUT_LEN, init, msgs + i, len);
+        }
+    }
+    if (kernel >= SSE2) {
+        for (; n - i >= 4; i += 4) {
+            hashLanes<4>(compress4, out + i*OUT_LEN, init, msgs + i, len);
+        }
+    }
+#else
+    (void) kernel;
+#endif
+    for (; i < n; i++) {
+        hashLanes<1>(compress1, out + i*OUT_LEN, init, msgs + i, len);
+    }
+}
+
+void Sha256Multi::hmac(unsigned char* out, const Sha256Multi::hmac_key_t& key, const unsigned char* const* msgs, size_t len, size_t n)
+{
+    const size_t CHUNK = 64;
+    unsigned char inner[CHUNK * OUT_LEN];
+    const unsigned char* innerPtrs[CHUNK];
+    for (size_t j = 0; j < CHUNK; j++) {
+        innerPtrs[j] = inner + j*OUT_LEN;
+    }
+
+    for (size_t i = 0; i < n; i += CHUNK) {
+        size_t m = std::min(CHUNK, n - i);
+        hash(inner, key.inner, msgs + i, len, m);
+        hash(out + i*OUT_LEN, key.outer, innerPtrs, OUT_LEN, m);
+    }
+}
+
+Sha256Multi::kernel_t Sha256Multi::bestKernel()
+{
+#ifdef SHA256MULTI_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return AVX2;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return SSE2;
+    }
+#endif
+    return SCALAR;
+}
+
+Sha256Multi::kernel_t Sha256Multi::getKernel()
+{
+    return (kernel_t) selectedKernel().load();
+}
+
+void Sha256Multi::setKernel(Sha256Multi::kernel_t kernel)
+{
+    if (kernel > bestKernel()) {
+        throw std::invalid_argument("kernel not supported by this CPU");
+    }
+    selectedKernel().store(kernel);
+}
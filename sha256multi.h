@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2015 Tim Ruffing <tim.ruffing@mmci.uni-saarland.de>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#ifndef SHA256MULTI_H
+#define SHA256MULTI_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// Multi-buffer SHA-256: hashes several independent messages of the same length at
+// once, one message per SIMD lane. On x86, an 8-way AVX2 kernel or a 4-way SSE2
+// kernel is selected at runtime depending on the CPU; otherwise, and for the last
+// few messages of a batch, a scalar kernel is used.
+//
+// This pays off for the many short and independent hashes in this library, e.g.,
+// the PRF evaluations on a path or the parent digests of a batch of tokens.
+class Sha256Multi
+{
+public:
+    static const size_t OUT_LEN = 32;
+    static const size_t BLOCK_LEN = 64;
+
+    // The state after absorbing a number of whole blocks.
+    struct midstate_t {
+        std::array<uint32_t, 8> s;
+        uint64_t bytes;
+    };
+
+    // A HMAC key, i.e., the midstates after absorbing the inner and the outer key block.
+    struct hmac_key_t {
+        midstate_t inner;
+        midstate_t outer;
+    };
+
+    enum kernel_t { SCALAR = 1, SSE2 = 4, AVX2 = 8 };
+
+    // The state before absorbing any data.
+    static midstate_t initial();
+    static void hmacKey(hmac_key_t& key, const unsigned char* k, size_t len);
+
+    // Writes the hash of init followed by msgs[i] to out + i*OUT_LEN for i = 0, ..., n-1.
+    // All messages have length len.
+    static void hash(unsigned char* out, const midstate_t& init, const unsigned char* const* msgs, size_t len, size_t n);
+    // Writes HMAC(key, msgs[i]) to out + i*OUT_LEN for i = 0, ..., n-1.
+    static void hmac(unsigned char* out, const hmac_key_t& key, const unsigned char* const* msgs, size_t len, size_t n);
+
+    // The widest kernel supported by the CPU.
+    static kernel_t bestKernel();
+    static kernel_t getKernel();
+    // Restricts hashing to the given kernel, e.g., for testing. Throws
+    // std::invalid_argument if the CPU does not support it.
+    static void setKernel(kernel_t kernel);
+};
+
+#endif // SHA256MULTI_H
@@ -0,0 +1,131 @@
+/*
+ * Copyright (c) 2015 Tim Ruffing <tim.ruffing@mmci.uni-saarland.de>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#include "streamingverifier.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+template<size_t CtLen> const size_t BasicStreamingVerifier<CtLen>::PREFIX_LEN;
+
+template<size_t CtLen>
+BasicStreamingVerifier<CtLen>::BasicStreamingVerifier(const Authenticator& acca, const ct_t& ct, const ChameleonHash::digest_t& stDigest)
+    : acca(acca), node(ct)
+{
+    reset(ct, stDigest);
+}
+
+template<size_t CtLen>
+BasicStreamingVerifier<CtLen>::BasicStreamingVerifier(const Authenticator& acca, const ct_t& ct, const st_t& st)
+    : acca(acca), node(ct)
+{
+    ChameleonHash::digest_t stDigest;
+    ChameleonHash::digest(stDigest, st);
+    reset(ct, stDigest);
+}
+
+template<size_t CtLen>
+void BasicStreamingVerifier<CtLen>::reset(const ct_t& ct, const ChameleonHash::digest_t& stDigest)
+{
+    node = Node(ct);
+    subTreeX = stDigest;
+    consumed = 0;
+    level = 0;
+    failed = false;
+    filled = 0;
+}
+
+template<size_t CtLen>
+size_t BasicStreamingVerifier<CtLen>::feed(const unsigned char* data, size_t len)
+{
+    len = std::min(len, Wire::TOKEN_LEN - consumed);
+    size_t pos = 0;
+    while (pos < len) {
+        // the header and the parities come first, then the levels
+        size_t need = consumed < PREFIX_LEN ? PREFIX_LEN : Wire::LEVEL_LEN;
+        size_t n = std::min(need - filled, len - pos);
+        std::copy(data + pos, data + pos + n, buf.begin() + filled);
+        filled += n;
+        pos += n;
+        consumed += n;
+        if (filled < need) {
+            break;
+        }
+        filled = 0;
+        if (need == PREFIX_LEN) {
+            failed = true;
+            Wire::checkTokenHeader(buf.data(), Wire::HEADER_LEN);
+            failed = false;
+            std::copy_n(buf.begin() + Wire::HEADER_LEN, Wire::PARITY_LEN, parity.begin());
+        } else {
+            verifyLevel();
+        }
+    }
+    return len;
+}
+
+template<size_t CtLen>
+void BasicStreamingVerifier<CtLen>::verifyLevel()
+{
+    if (failed) {
+        level++;
+        return;
+    }
+
+    ChameleonHash::rand_t r;
+    ChameleonHash::hash_t chash, sibchash;
+    std::copy_n(buf.begin(), ChameleonHash::RAND_LEN, r.begin());
+    sibchash[0] = 0x02 | ((parity[level / 8] >> (level % 8)) & 1);
+    std::copy_n(buf.begin() + ChameleonHash::RAND_LEN, Wire::X_LEN, sibchash.begin() + 1);
+
+    try {
+        acca.ch.ch(chash, subTreeX, r);
+    } catch (const std::invalid_argument&) {
+        // randomness out of range
+        failed = true;
+        level++;
+        return;
+    }
+    if (level == 0) {
+        ChameleonHash::randomOracle(chash, chash, r);
+    }
+    if (node.isLeftChild()) {
+        ChameleonHash::digest(subTreeX, chash, sibchash);
+    } else {
+        ChameleonHash::digest(subTreeX, sibchash, chash);
+    }
+    node.moveToParent();
+    level++;
+
+    if (level == Authenticator::DEPTH) {
+        failed = subTreeX != acca.rootDigest;
+    }
+}
+
+#define INSTANTIATE(n) template class BasicStreamingVerifier<n>;
+ACCA_FOR_EACH_CT_LEN(INSTANTIATE)
+#undef INSTANTIATE
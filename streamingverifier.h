@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2015 Tim Ruffing <tim.ruffing@mmci.uni-saarland.de>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#ifndef STREAMINGVERIFIER_H
+#define STREAMINGVERIFIER_H
+
+#include "authenticator.h"
+#include "node.h"
+#include "wire.h"
+
+#include <array>
+
+// Verifies an encoded token (see wire.h) while it is being received. The levels of
+// the encoding are ordered from the leaf to the root, so every level can be checked
+// as soon as its bytes have arrived, and the chameleon hash of the first level is
+// computed before the rest of the token has been received. The verifier keeps only
+// the current level and the running digest, i.e., its state does not depend on the
+// depth of the tree.
+template<size_t CtLen>
+class BasicStreamingVerifier
+{
+public:
+    typedef BasicAuthenticator<CtLen> Authenticator;
+    typedef BasicWire<CtLen> Wire;
+    typedef typename Authenticator::Node Node;
+    typedef typename Authenticator::ct_t ct_t;
+    typedef typename Authenticator::st_t st_t;
+
+    // acca must outlive the verifier.
+    BasicStreamingVerifier(const Authenticator& acca, const ct_t& ct, const ChameleonHash::digest_t& stDigest);
+    BasicStreamingVerifier(const Authenticator& acca, const ct_t& ct, const st_t& st);
+
+    // Starts over with another token, so that a verifier can be reused.
+    void reset(const ct_t& ct, const ChameleonHash::digest_t& stDigest);
+
+    // Consumes the next bytes of the encoded token and verifies all levels completed by them.
+    // Returns the number of bytes consumed, which is less than len only if the token ends
+    // earlier. Throws std::invalid_argument if the header is not the one of a token for
+    // contexts of CtLen bytes; the verifier must be reset before it can be used again.
+    size_t feed(const unsigned char* data, size_t len);
+
+    // Returns true if the whole token has been consumed.
+    bool done() const {
+        return consumed == Wire::TOKEN_LEN;
+    }
+
+    // Returns true if the whole token has been consumed and is valid.
+    bool valid() const {
+        return done() && !failed;
+    }
+
+    // Returns false as soon as a level has been rejected. The rest of the token is still
+    // consumed but not checked.
+    bool good() const {
+        return !failed;
+    }
+
+private:
+    static const size_t PREFIX_LEN = Wire::HEADER_LEN + Wire::PARITY_LEN;
+
+    const Authenticator& acca;
+    Node node;
+    ChameleonHash::digest_t subTreeX;
+    size_t consumed;
+    size_t level;
+    bool failed;
+    std::array<unsigned char, Wire::PARITY_LEN> parity;
+    // the header or the level which is currently received
+    std::array<unsigned char, (PREFIX_LEN > Wire::LEVEL_LEN ? PREFIX_LEN : Wire::LEVEL_LEN)> buf;
+    size_t filled;
+
+    void verifyLevel();
+};
+
+typedef BasicStreamingVerifier<ACCA_CT_LEN> StreamingVerifier;
+
+#endif // STREAMINGVERIFIER_H
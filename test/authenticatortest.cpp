@@ -26,11 +26,44 @@
 
 #include <gtest/gtest.h>
 #include "../chameleonhash.h"
+#include "../equivocationstore.h"
+#include "../instrumentation.h"
+#include "../anyauthenticator.h"
+#ifdef __linux__
+#include "../assertionservice.h"
+#endif
+#include "../auditpipeline.h"
+#include "../batchscheduler.h"
 #include "../authenticator.h"
-#include <ctime>
+#include "../keyregistry.h"
+#include "../messagedigester.h"
+#include "../multiproof.h"
+#include "../node.h"
+#include "../precomputer.h"
+#include "../prf.h"
+#include "../scalarmulti.h"
+#include "../sha256.h"
+#include "../sha256multi.h"
+#include "../streamingverifier.h"
+#include "../treecache.h"
+#include "../verifiednodecache.h"
+#include "../wire.h"
+#include "../workstealingpool.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
 #include <random>
 #include <array>
 #include <iomanip>
+#include <map>
+#include <set>
+#include <cstdio>
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
 
 using namespace std;
 
@@ -119,10 +152,17 @@ const ChameleonHash::hash_t AuthenticatorTest::ch1 = {
     0x46, 0x55, 0xdf, 0xb6, 0x77, 0x06, 0x19, 0xc4
 };
 
-const Authenticator::ct_t AuthenticatorTest::ct = {
-    // FIXME We always set the first 8 bytes even though CT_LEN can be configured.
-    0x41, 0x04, 0xff, 0x17, 0x5f, 0xa9, 0x17, 0xab
-};
+// repeats a fixed pattern, so that the tests work for every configured CT_LEN
+static Authenticator::ct_t fixedCt() {
+    const unsigned char pattern[] = {0x41, 0x04, 0xff, 0x17, 0x5f, 0xa9, 0x17, 0xab};
+    Authenticator::ct_t res;
+    for (size_t i = 0; i < res.size(); i++) {
+        res[i] = pattern[i % sizeof pattern];
+    }
+    return res;
+}
+
+const Authenticator::ct_t AuthenticatorTest::ct = fixedCt();
 
 random_device AuthenticatorTest::rd;
 random_device::result_type AuthenticatorTest::seed = AuthenticatorTest::rd();
@@ -147,6 +187,38 @@ TEST_F(AuthenticatorTest, ChSingleSk) {
     EXPECT_EQ(res1, ch1);
 }
 
+TEST_F(AuthenticatorTest, ChBulkMatchesSingle) {
+    const int k = 100;
+    ChameleonHash chpk(pk);
+    ChameleonHash chsk(sk);
+    std::vector<ChameleonHash::digest_t> ds(k);
+    std::vector<ChameleonHash::hash_t> respk(k), ressk(k);
+    for (int i = 0; i < k; i++) {
+        ChameleonHash::digest(ds[i], xs[i]);
+    }
+
+    chpk.ch(respk.data(), ds.data(), rs.data(), k);
+    chsk.ch(ressk.data(), ds.data(), rs.data(), k);
+    for (int i = 0; i < k; i++) {
+        ChameleonHash::hash_t res;
+        chpk.ch(res, ds[i], rs[i]);
+        EXPECT_EQ(res, respk[i]) << "failed at index " << i;
+        EXPECT_EQ(res, ressk[i]) << "failed at index " << i;
+    }
+}
+
+TEST_F(AuthenticatorTest, ChPrecomputedPkMatchesEcmult) {
+    ChameleonHash ch(pk);
+    ChameleonHash chTable(pk, true);
+
+    for (int i = 0; i < n; i++) {
+        ChameleonHash::hash_t res1, res2;
+        ch.ch(res1, xs[i], rs[i]);
+        chTable.ch(res2, xs[i], rs[i]);
+        EXPECT_EQ(res1, res2) << "failed at index " << i;
+    }
+}
+
 TEST_F(AuthenticatorTest, NoCollisionWithoutSecretKey) {
     ChameleonHash ch(pk);
     ChameleonHash::rand_t r2;
@@ -197,63 +269,109 @@ TEST_F(AuthenticatorTest, CollisionCorrectRandom) {
     }
 }
 
-TEST_F(AuthenticatorTest, ChBenchmarkPublic) {
-    ChameleonHash ch(pk);
-    ChameleonHash::hash_t res;
+TEST_F(AuthenticatorTest, AuthenticatorCorrectSingle) {
+    Authenticator acca(sk);
+    Authenticator::token_t t;
 
-    clock_t begin = clock();
-    for (int i = 0; i < n; i++) {
-        ch.ch(res, xs[i], rs[i]);
-    }
-    clock_t end = clock();
+    acca.authenticate(t, ct, m1);
+    EXPECT_TRUE(acca.verify(t, ct, m1));
 
-    double elapsed_usecs = double(end - begin) * 1000000 / (CLOCKS_PER_SEC * n);
-    cout << n << " iterations " << endl;
-    cout << elapsed_usecs << " microseconds on avg" << endl;
+    Authenticator::dpk_t dpk = acca.getDpk();
+    Authenticator accaPk(dpk);
+    EXPECT_TRUE(accaPk.verify(t, ct, m1));
 }
 
-TEST_F(AuthenticatorTest, ChBenchmarkSecret) {
-    ChameleonHash ch(sk);
-    ChameleonHash::hash_t res;
-
-    clock_t begin = clock();
-    for (int i = 0; i < n; i++) {
-        ch.ch(res, xs[i], rs[i]);
+TEST_F(AuthenticatorTest, MessageDigesterMatchesDigest) {
+    // larger than the read buffer of MessageDigester::writeFrom
+    Authenticator::st_t st(200000);
+    for (size_t i = 0; i < st.size(); i++) {
+        st[i] = (unsigned char) (i * 131 + (i >> 11));
     }
-    clock_t end = clock();
-
-    double elapsed_usecs = double(end - begin) * 1000000 / (CLOCKS_PER_SEC * n);
-    cout << n << " iterations " << endl;
-    cout << elapsed_usecs << " microseconds on avg" << endl;
-}
+    ChameleonHash::digest_t expected, d;
+    ChameleonHash::digest(expected, st);
 
-TEST_F(AuthenticatorTest, CollisionBenchmark) {
-    ChameleonHash ch(sk);
-    ChameleonHash::hash_t res1, res2;
-    ChameleonHash::rand_t r2;
+    ChameleonHash::digest(d, st.data(), st.size());
+    EXPECT_EQ(expected, d);
 
-    clock_t begin = clock();
-    for (int i = 1; i < n; i++) {
-        ch.collision(xs[i-1], rs[i-1], xs[i], r2);
+    MessageDigester md;
+    for (size_t pos = 0; pos < st.size(); pos += 777) {
+        md.write(st.data() + pos, std::min<size_t>(777, st.size() - pos));
     }
-    clock_t end = clock();
+    md.finalize(d);
+    EXPECT_EQ(expected, d);
 
-    double elapsed_usecs = double(end - begin) * 1000000 / (CLOCKS_PER_SEC * (n-1));
-    cout << (n-1) << " iterations " << endl;
-    cout << elapsed_usecs << " microseconds on avg" << endl;
-}
+    struct iovec iov[3] = {
+        { st.data(), 10 },
+        { st.data() + 10, 0 },
+        { st.data() + 10, st.size() - 10 }
+    };
+    MessageDigester::digest(d, iov, 3);
+    EXPECT_EQ(expected, d);
 
+    const char* path = "messagedigester-test.bin";
+    FILE* f = fopen(path, "wb");
+    ASSERT_TRUE(f != nullptr);
+    ASSERT_EQ(st.size(), fwrite(st.data(), 1, st.size(), f));
+    fclose(f);
+    MessageDigester::digestFile(d, path);
+    EXPECT_EQ(expected, d);
+    f = fopen(path, "rb");
+    ASSERT_TRUE(f != nullptr);
+    MessageDigester::digestFrom(d, fileno(f));
+    fclose(f);
+    std::remove(path);
+    EXPECT_EQ(expected, d);
 
-TEST_F(AuthenticatorTest, AuthenticatorCorrectSingle) {
     Authenticator acca(sk);
-    Authenticator::token_t t;
+    Authenticator::token_t t1, t2;
+    acca.authenticate(t1, ct, st);
+    acca.authenticate(t2, ct, expected);
+    EXPECT_EQ(t1.chs, t2.chs);
+    EXPECT_EQ(t1.rs, t2.rs);
+    EXPECT_TRUE(acca.verify(t1, ct, expected));
+    EXPECT_FALSE(acca.verify(t1, ct, m1));
+}
 
-    acca.authenticate(t, ct, m1);
-    EXPECT_TRUE(acca.verify(t, ct, m1));
+TEST_F(AuthenticatorTest, PrecomputedHandlesSameTokens) {
+    Authenticator acca(sk);
+    Authenticator::handle_t h;
+    acca.precompute(h, ct);
+    Authenticator::token_t t1, t2;
+    acca.authenticate(t1, ct, m1);
+    acca.authenticate(t2, h, m1);
+    EXPECT_EQ(t1.chs, t2.chs);
+    EXPECT_EQ(t1.rs, t2.rs);
+    acca.authenticate(t2, h, m2);
+    EXPECT_TRUE(acca.verify(t2, ct, m2));
+    EXPECT_THROW(Authenticator(acca.getDpk()).precompute(h, ct), std::logic_error);
 
-    Authenticator::dpk_t dpk = acca.getDpk();
-    Authenticator accaPk(dpk);
-    EXPECT_TRUE(accaPk.verify(t, ct, m1));
+    Authenticator::ct_t counter = {};
+    counter[counter.size() - 1] = 0xfe;
+    Precomputer pre(acca, counter, 4);
+    for (int i = 0; i < 6; i++) {
+        // the second step skips a context
+        if (i == 2) {
+            counter = Precomputer::nextCounter(counter);
+        }
+        acca.authenticate(t1, counter, xs[i]);
+        pre.authenticate(t2, counter, xs[i]);
+        EXPECT_EQ(t1.chs, t2.chs) << "failed at index " << i;
+        EXPECT_EQ(t1.rs, t2.rs) << "failed at index " << i;
+        counter = Precomputer::nextCounter(counter);
+    }
+    // the counter carried into the next byte
+    EXPECT_EQ(1, counter[counter.size() - 2]);
+    EXPECT_EQ(5, counter[counter.size() - 1]);
+    EXPECT_EQ(6, pre.getStats().hits);
+    EXPECT_EQ(0, pre.getStats().misses);
+
+    // an unpredicted context restarts the prediction
+    pre.authenticate(t2, cts[0], xs[0]);
+    EXPECT_TRUE(acca.verify(t2, cts[0], xs[0]));
+    pre.authenticate(t2, Precomputer::nextCounter(cts[0]), xs[1]);
+    EXPECT_TRUE(acca.verify(t2, Precomputer::nextCounter(cts[0]), xs[1]));
+    EXPECT_EQ(7, pre.getStats().hits);
+    EXPECT_EQ(1, pre.getStats().misses);
 }
 
 TEST_F(AuthenticatorTest, AuthenticatorNonMalleableSingle) {
@@ -280,28 +398,1198 @@ TEST_F(AuthenticatorTest, AuthenticatorExtractSimple) {
     EXPECT_EQ(sk, accaPk.getDsk());
 }
 
-TEST_F(AuthenticatorTest, AuthenticatorCorrectRandomAndBenchmark) {
+TEST_F(AuthenticatorTest, AuthenticatorExtractDivergingLevel) {
     Authenticator acca(sk);
-    std::vector<Authenticator::token_t> ts(n);
-    cout << n << " iterations " << endl;
+    Authenticator::token_t t1, t2;
+    acca.authenticate(t1, ct, m1);
+    acca.authenticate(t2, ct, m2);
+    Authenticator::dpk_t dpk = acca.getDpk();
+
+    // only the leaf level is needed
+    Authenticator::token_t tampered = t2;
+    tampered.chs[Authenticator::DEPTH - 1][0] ^= 1;
+    Authenticator accaLeaf(dpk);
+    accaLeaf.extract(t1, tampered, ct, m1, m2);
+    EXPECT_EQ(sk, accaLeaf.getDsk());
+
+    // move the collision one level up
+    ChameleonHash chSk(sk);
+    ChameleonHash::digest_t d1, d2, x1, x2;
+    ChameleonHash::digest(d1, m1);
+    ChameleonHash::digest(d2, m2);
+    tampered = t2;
+    tampered.rs[0] = rs[0];
+    Node leaf(ct);
+    for (auto p : { make_pair(&x1, &t1), make_pair(&x2, &tampered) }) {
+        ChameleonHash::hash_t c;
+        chSk.ch(c, p.first == &x1 ? d1 : d2, p.second->rs[0]);
+        ChameleonHash::randomOracle(c, c, p.second->rs[0]);
+        if (leaf.isLeftChild()) {
+            ChameleonHash::digest(*p.first, c, p.second->chs[0]);
+        } else {
+            ChameleonHash::digest(*p.first, p.second->chs[0], c);
+        }
+    }
+    chSk.collision(x1, t1.rs[1], x2, tampered.rs[1]);
+    Authenticator accaUp(dpk);
+    accaUp.extract(t1, tampered, ct, m1, m2);
+    EXPECT_EQ(sk, accaUp.getDsk());
+
+    // a token does not collide with itself
+    Authenticator accaNone(dpk);
+    EXPECT_THROW(accaNone.extract(t1, t1, ct, m1, m1), std::invalid_argument);
+    EXPECT_THROW(accaNone.getDsk(), std::logic_error);
+}
+
+TEST_F(AuthenticatorTest, AuthenticatorExtractBatch) {
+    ChameleonHash::sk_t sk2 = sk;
+    sk2[ChameleonHash::SK_LEN - 1] ^= 0x55;
+    Authenticator acca(sk), acca2(sk2);
+    Authenticator::token_t t1, t2, u1, u2;
+    acca.authenticate(t1, ct, m1);
+    acca.authenticate(t2, ct, m2);
+    acca2.authenticate(u1, cts[0], m1);
+    acca2.authenticate(u2, cts[0], m2);
+    Authenticator::dpk_t wrongLength = acca.getDpk();
+    wrongLength.ctLen++;
+
+    std::vector<Authenticator::dsk_t> dsks;
+    std::vector<bool> ok = Authenticator::extractBatch(dsks,
+        { acca.getDpk(), acca2.getDpk(), acca.getDpk(), wrongLength },
+        { t1, u1, t1, t1 },
+        { t2, u2, t1, t2 },
+        { ct, cts[0], ct, ct },
+        { m1, m1, m1, m1 },
+        { m2, m2, m1, m2 });
+    ASSERT_EQ(4, ok.size());
+    ASSERT_EQ(4, dsks.size());
+    EXPECT_TRUE(ok[0]);
+    EXPECT_EQ(sk, dsks[0]);
+    EXPECT_TRUE(ok[1]);
+    EXPECT_EQ(sk2, dsks[1]);
+    EXPECT_FALSE(ok[2]);
+    EXPECT_FALSE(ok[3]);
+
+    EXPECT_THROW(Authenticator::extractBatch(dsks, { acca.getDpk() }, { t1 }, { t2 }, { ct }, { m1 }, {}), std::invalid_argument);
+}
+
+TEST_F(AuthenticatorTest, InstrumentationCountsOperations) {
+    Authenticator acca(sk);
+    Authenticator accaPk(acca.getDpk());
+    Authenticator::token_t t;
+    std::vector<Instrumentation::record_t> records;
+    Instrumentation::setCallback([&](const Instrumentation::record_t& record) {
+        records.push_back(record);
+    });
+    Instrumentation::reset();
+    acca.authenticate(t, ct, m1);
+    EXPECT_TRUE(accaPk.verify(t, ct, m1));
+    Instrumentation::setCallback(Instrumentation::callback_t());
+    Instrumentation::stats_t stats = Instrumentation::snapshot();
+
+    if (!Instrumentation::ENABLED) {
+        EXPECT_TRUE(records.empty());
+        EXPECT_EQ(0, stats.operations[Instrumentation::AUTHENTICATE]);
+        return;
+    }
+    ASSERT_EQ(2, records.size());
+    const Instrumentation::record_t& auth = records[0];
+    const Instrumentation::record_t& verify = records[1];
+    EXPECT_EQ(Instrumentation::AUTHENTICATE, auth.operation);
+    EXPECT_EQ(Instrumentation::VERIFY, verify.operation);
+    // x and r for every node on the path and its sibling
+    EXPECT_EQ(4 * Authenticator::DEPTH, auth.counts[Instrumentation::PRF_CALLS]);
+    EXPECT_EQ(2 * Authenticator::DEPTH, auth.counts[Instrumentation::EC_MULT_GEN]);
+    // the hashes on the path share a single inversion
+    EXPECT_EQ(1, auth.counts[Instrumentation::INVERSIONS]);
+    EXPECT_EQ(Authenticator::DEPTH, verify.counts[Instrumentation::EC_MULT]);
+    EXPECT_EQ(Authenticator::DEPTH, verify.counts[Instrumentation::INVERSIONS]);
+    EXPECT_EQ(0, verify.counts[Instrumentation::PRF_CALLS]);
+    EXPECT_LT(Authenticator::DEPTH, verify.counts[Instrumentation::SHA_COMPRESSIONS]);
+    EXPECT_LE(auth.phaseTicks[Instrumentation::PHASE_PATH], auth.totalTicks);
+
+    EXPECT_EQ(1, stats.operations[Instrumentation::AUTHENTICATE]);
+    EXPECT_EQ(1, stats.operations[Instrumentation::VERIFY]);
+    EXPECT_EQ(auth.counts[Instrumentation::PRF_CALLS], stats.counts[Instrumentation::PRF_CALLS]);
+}
+
+TEST_F(AuthenticatorTest, BatchSchedulerMatchesDirectCalls) {
+    Authenticator acca(sk);
+    WorkStealingPool pool(2);
+    BatchScheduler::config_t config;
+    config.maxBatch = 16;
+    config.maxDelay = std::chrono::microseconds(500);
+
+    const size_t count = 64;
+    std::vector<std::future<Authenticator::token_t>> tokens(count);
+    std::vector<std::future<bool>> valid;
+    {
+        BatchScheduler scheduler(acca, pool, config);
+        // submit from several threads at once
+        std::vector<std::thread> clients;
+        for (size_t c = 0; c < 4; c++) {
+            clients.emplace_back([&, c] {
+                for (size_t i = c; i < count; i += 4) {
+                    tokens[i] = scheduler.submitAuthenticate(cts[i], xs[i]);
+                }
+            });
+        }
+        for (auto& client : clients) {
+            client.join();
+        }
+
+        Authenticator::token_t direct;
+        for (size_t i = 0; i < count; i++) {
+            Authenticator::token_t t = tokens[i].get();
+            acca.authenticate(direct, cts[i], xs[i]);
+            EXPECT_EQ(direct.chs, t.chs);
+            EXPECT_EQ(direct.rs, t.rs);
+            valid.push_back(scheduler.submitVerify(t, cts[i], xs[i]));
+        }
+        valid.push_back(scheduler.submitVerify(direct, cts[0], xs[0]));
+
+        BatchScheduler::stats_t stats = scheduler.getStats();
+        EXPECT_EQ(count, stats.authentications);
+        EXPECT_LE(stats.authenticateLimit, config.maxBatch);
+        // the destructor processes the pending requests
+    }
+    for (size_t i = 0; i < count; i++) {
+        EXPECT_TRUE(valid[i].get());
+    }
+    EXPECT_FALSE(valid[count].get());
+}
+
+TEST_F(AuthenticatorTest, BatchSchedulerLimitDropsUnderLightLoad) {
+    Authenticator acca(sk);
+    WorkStealingPool pool(2);
+    BatchScheduler::config_t config;
+    config.maxBatch = 16;
+    config.maxDelay = std::chrono::microseconds(500);
+    BatchScheduler scheduler(acca, pool, config);
+
+    std::vector<std::future<Authenticator::token_t>> tokens;
+    for (size_t i = 0; i < 64; i++) {
+        tokens.push_back(scheduler.submitAuthenticate(cts[i], xs[i]));
+    }
+    for (auto& t : tokens) {
+        t.get();
+    }
+    // one request at a time
+    for (size_t i = 0; i < 8; i++) {
+        scheduler.submitAuthenticate(cts[i], xs[i]).get();
+    }
+    EXPECT_EQ(1, scheduler.getStats().authenticateLimit);
+}
+
+static void removeStore(const std::string& dir) {
+    for (const char* file : {"/log", "/index", "/bloom"}) {
+        std::remove((dir + file).c_str());
+    }
+    std::remove(dir.c_str());
+}
+
+#ifdef __linux__
+TEST_F(AuthenticatorTest, AssertionServiceRoundTrip) {
+    std::string path = "/tmp/authenticatortest-" + std::to_string(getpid()) + ".sock";
+    const std::string dir = path + ".issued";
+    removeStore(dir);
+    KeyRegistry verifiers(16 << 20);
+    EquivocationStore issued(dir, 1000, verifiers);
+    AssertionServer::config_t config;
+    config.workers = 2;
+    AssertionServer server(path, { std::make_shared<Authenticator>(sk) }, verifiers, issued, config);
+    AssertionClient client(path);
+    AssertionProtocol::response_t response;
+
+    client.send(AssertionProtocol::getDpkRequest(1, 0));
+    client.receive(response);
+    ASSERT_EQ(AssertionProtocol::OK, response.status);
+    EXPECT_EQ(1, response.id);
+    Authenticator::dpk_t dpk;
+    Wire::decodeDpk(dpk, response.payload.data(), response.payload.size());
+    EXPECT_EQ(Authenticator(sk).getDpk().rootDigest, dpk.rootDigest);
+
+    // pipelined requests, the responses may arrive in any order
+    Authenticator::ct_t ct2 = ct;
+    ct2[0]++;
+    client.send(AssertionProtocol::authenticateRequest(2, 0, ct, m1));
+    client.send(AssertionProtocol::authenticateRequest(3, 0, ct2, m2));
+    client.send(AssertionProtocol::getDpkRequest(4, 1));
+    std::map<uint32_t, AssertionProtocol::response_t> responses;
+    for (int i = 0; i < 3; i++) {
+        client.receive(response);
+        responses[response.id] = response;
+    }
+    ASSERT_EQ(AssertionProtocol::OK, responses[2].status);
+    ASSERT_EQ(AssertionProtocol::OK, responses[3].status);
+    EXPECT_EQ(AssertionProtocol::UNKNOWN_KEY, responses[4].status);
+    Authenticator::token_t t1, t2;
+    Wire::decodeToken(t1, responses[2].payload.data(), responses[2].payload.size());
+
+    // the same statement again is fine, a second statement in the same context is refused
+    client.send(AssertionProtocol::authenticateRequest(11, 0, ct, m1));
+    client.receive(response);
+    ASSERT_EQ(AssertionProtocol::OK, response.status);
+    EXPECT_EQ(responses[2].payload, response.payload);
+    client.send(AssertionProtocol::authenticateRequest(12, 0, ct, m2));
+    client.receive(response);
+    EXPECT_EQ(12, response.id);
+    EXPECT_EQ(AssertionProtocol::EQUIVOCATION, response.status);
+    EXPECT_TRUE(response.payload.empty());
+    EXPECT_EQ(2, issued.size());
+
+    // extraction from tokens that did not come from the server
+    Authenticator(sk).authenticate(t2, ct, m2);
+
+    client.send(AssertionProtocol::verifyRequest(5, dpk, ct, t1, m1));
+    client.receive(response);
+    ASSERT_EQ(AssertionProtocol::OK, response.status);
+    EXPECT_EQ(AssertionProtocol::bytes_t(1, 1), response.payload);
+    client.send(AssertionProtocol::verifyRequest(6, dpk, ct, t1, m2));
+    client.receive(response);
+    EXPECT_EQ(AssertionProtocol::bytes_t(1, 0), response.payload);
+
+    client.send(AssertionProtocol::extractRequest(7, dpk, ct, t1, t2, m1, m2));
+    client.receive(response);
+    ASSERT_EQ(AssertionProtocol::OK, response.status);
+    EXPECT_EQ(AssertionProtocol::bytes_t(sk.begin(), sk.end()), response.payload);
+    client.send(AssertionProtocol::extractRequest(8, dpk, ct, t1, t1, m1, m1));
+    client.receive(response);
+    EXPECT_EQ(AssertionProtocol::NOT_EXTRACTABLE, response.status);
+
+    // truncated payload
+    AssertionProtocol::bytes_t bad = AssertionProtocol::verifyRequest(9, dpk, ct, t1, m1);
+    bad.resize(AssertionProtocol::HEADER_LEN + 10);
+    bad[3] = bad.size() - 4;
+    bad[2] = 0;
+    client.send(bad);
+    client.receive(response);
+    EXPECT_EQ(9, response.id);
+    EXPECT_EQ(AssertionProtocol::BAD_REQUEST, response.status);
+
+    EXPECT_EQ(4, server.getLatencies(AssertionProtocol::AUTHENTICATE).count());
+    client.send(AssertionProtocol::statsRequest(10));
+    client.receive(response);
+    ASSERT_EQ(AssertionProtocol::OK, response.status);
+    EXPECT_NE(std::string::npos, std::string(response.payload.begin(), response.payload.end()).find("\"verify\": {\"count\": 3"));
+    removeStore(dir);
+}
+
+TEST_F(AuthenticatorTest, AssertionServiceRefusesAfterRestart) {
+    std::string path = "/tmp/authenticatortest-" + std::to_string(getpid()) + ".sock";
+    const std::string dir = path + ".issued";
+    removeStore(dir);
+    KeyRegistry verifiers(16 << 20);
+    AssertionServer::config_t config;
+    config.workers = 2;
+    AssertionProtocol::response_t response;
+    {
+        EquivocationStore issued(dir, 1000, verifiers);
+        AssertionServer server(path, { std::make_shared<Authenticator>(sk) }, verifiers, issued, config);
+        AssertionClient client(path);
+        client.send(AssertionProtocol::authenticateRequest(1, 0, ct, m1));
+        client.receive(response);
+        ASSERT_EQ(AssertionProtocol::OK, response.status);
+    }
+
+    EquivocationStore issued(dir, 1000, verifiers);
+    EXPECT_EQ(1, issued.size());
+    AssertionServer server(path, { std::make_shared<Authenticator>(sk) }, verifiers, issued, config);
+    AssertionClient client(path);
+    client.send(AssertionProtocol::authenticateRequest(2, 0, ct, m2));
+    client.receive(response);
+    EXPECT_EQ(AssertionProtocol::EQUIVOCATION, response.status);
+    client.send(AssertionProtocol::authenticateRequest(3, 0, ct, m1));
+    client.receive(response);
+    EXPECT_EQ(AssertionProtocol::OK, response.status);
+    removeStore(dir);
+}
+
+TEST_F(AuthenticatorTest, AssertionServiceAnswersAfterShutdown) {
+    std::string path = "/tmp/authenticatortest-" + std::to_string(getpid()) + ".sock";
+    const std::string dir = path + ".issued";
+    removeStore(dir);
+    KeyRegistry verifiers(16 << 20);
+    EquivocationStore issued(dir, 1000, verifiers);
+    AssertionServer::config_t config;
+    config.workers = 2;
+    // stop reading after every response
+    config.outputHighWater = 1;
+    AssertionServer server(path, { std::make_shared<Authenticator>(sk) }, verifiers, issued, config);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    ASSERT_LE(0, fd);
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path.c_str());
+    ASSERT_EQ(0, connect(fd, (sockaddr*) &addr, sizeof(addr)));
+
+    const size_t count = 50;
+    AssertionProtocol::bytes_t requests;
+    for (size_t i = 0; i < count; i++) {
+        AssertionProtocol::bytes_t request = AssertionProtocol::getDpkRequest(i, 0);
+        requests.insert(requests.end(), request.begin(), request.end());
+    }
+    ASSERT_EQ((ssize_t) requests.size(), write(fd, requests.data(), requests.size()));
+    ASSERT_EQ(0, shutdown(fd, SHUT_WR));
+
+    // all responses arrive before the server closes the connection
+    AssertionProtocol::bytes_t in;
+    unsigned char buf[4096];
+    ssize_t n;
+    while ((n = read(fd, buf, sizeof(buf))) > 0) {
+        in.insert(in.end(), buf, buf + n);
+    }
+    EXPECT_EQ(0, n);
+    close(fd);
+    std::set<uint32_t> ids;
+    size_t pos = 0;
+    while (in.size() - pos >= AssertionProtocol::HEADER_LEN) {
+        size_t len = 4 + ((in[pos] << 24) | (in[pos + 1] << 16) | (in[pos + 2] << 8) | in[pos + 3]);
+        ASSERT_LE(pos + len, in.size());
+        EXPECT_EQ(AssertionProtocol::OK, in[pos + 4]);
+        ids.insert((in[pos + 5] << 24) | (in[pos + 6] << 16) | (in[pos + 7] << 8) | in[pos + 8]);
+        pos += len;
+    }
+    EXPECT_EQ(in.size(), pos);
+    EXPECT_EQ(count, ids.size());
+    removeStore(dir);
+}
+#endif
+
+TEST_F(AuthenticatorTest, WireRoundTripAndTokenViews) {
+    Authenticator acca(sk);
+    Authenticator::token_t t1, t2, decoded;
+    acca.authenticate(t1, ct, m1);
+    acca.authenticate(t2, ct, m2);
+
+    Wire::bytes_t enc1 = Wire::encodeToken(t1);
+    Wire::bytes_t enc2 = Wire::encodeToken(t2);
+    EXPECT_EQ(Wire::TOKEN_LEN, enc1.size());
+    Wire::decodeToken(decoded, enc1.data(), enc1.size());
+    EXPECT_EQ(t1.chs, decoded.chs);
+    EXPECT_EQ(t1.rs, decoded.rs);
+
+    Authenticator::dpk_t dpk = acca.getDpk();
+    Wire::bytes_t encDpk = Wire::encodeDpk(dpk);
+    Authenticator::dpk_t decodedDpk;
+    Wire::decodeDpk(decodedDpk, encDpk.data(), encDpk.size());
+    EXPECT_EQ(dpk.chpk, decodedDpk.chpk);
+    EXPECT_EQ(dpk.rootDigest, decodedDpk.rootDigest);
+    EXPECT_EQ(dpk.ctLen, decodedDpk.ctLen);
+
+    Authenticator accaPk(decodedDpk);
+    TokenView view1(enc1.data(), enc1.size());
+    TokenView view2(enc2.data(), enc2.size());
+    EXPECT_TRUE(accaPk.verify(view1, ct, m1));
+    EXPECT_FALSE(accaPk.verify(view1, ct, m2));
+    accaPk.extract(view1, view2, ct, m1, m2);
+    EXPECT_EQ(sk, accaPk.getDsk());
+
+    EXPECT_THROW(TokenView(enc1.data(), enc1.size() - 1), std::invalid_argument);
+    enc1[4]++;
+    EXPECT_THROW(TokenView(enc1.data(), enc1.size()), std::invalid_argument);
+}
+
+TEST_F(AuthenticatorTest, ExtendedTokensVerify) {
+    Authenticator acca(sk);
+    Authenticator accaPk(acca.getDpk(), true);
+    Authenticator::token_t t;
+    Authenticator::extended_token_t ext, decoded;
+    acca.authenticate(t, ct, m1);
+    acca.authenticate(ext, ct, m1);
+    EXPECT_EQ(t.chs, ext.token.chs);
+    EXPECT_EQ(t.rs, ext.token.rs);
+    EXPECT_TRUE(accaPk.verify(ext.token, ct, m1));
+
+    EXPECT_TRUE(accaPk.verify(ext, ct, m1));
+    EXPECT_TRUE(acca.verify(ext, ct, m1));
+    EXPECT_TRUE(Authenticator(acca.getDpk()).verify(ext, ct, m1));
+    for (size_t i = 0; i < 4; i++) {
+        Authenticator::extended_token_t other;
+        acca.authenticate(other, cts[i], xs[i]);
+        EXPECT_TRUE(accaPk.verify(other, cts[i], xs[i]));
+        EXPECT_FALSE(accaPk.verify(other, ct, xs[i]));
+    }
+
+    // the statement and the randomness above the leaf enter only the chameleon hashes,
+    // so they are caught by the multi-scalar multiplication
+    EXPECT_FALSE(accaPk.verify(ext, ct, m2));
+    Authenticator::extended_token_t bad = ext;
+    bad.token.rs[Authenticator::DEPTH / 2][ChameleonHash::RAND_LEN/2] ^= 1;
+    EXPECT_FALSE(accaPk.verify(bad, ct, m1));
+    bad = ext;
+    bad.pathChs[1] = ext.pathChs[2];
+    EXPECT_FALSE(accaPk.verify(bad, ct, m1));
+    bad = ext;
+    bad.token.chs[3][ChameleonHash::HASH_LEN/2] ^= 1;
+    EXPECT_FALSE(accaPk.verify(bad, ct, m1));
+
+    Wire::bytes_t enc = Wire::encodeExtendedToken(ext);
+    EXPECT_EQ(Wire::EXTENDED_TOKEN_LEN, enc.size());
+    EXPECT_EQ(Wire::TOKEN_LEN + Authenticator::DEPTH / 8 + Authenticator::DEPTH * Wire::X_LEN, enc.size());
+    Wire::decodeExtendedToken(decoded, enc.data(), enc.size());
+    EXPECT_EQ(ext.token.chs, decoded.token.chs);
+    EXPECT_EQ(ext.token.rs, decoded.token.rs);
+    EXPECT_EQ(ext.pathChs, decoded.pathChs);
+    EXPECT_THROW(Wire::decodeExtendedToken(decoded, enc.data(), enc.size() - 1), std::invalid_argument);
+    EXPECT_THROW(TokenView(enc.data(), enc.size()), std::invalid_argument);
+}
+
+TEST_F(AuthenticatorTest, MultiProofSequentialContexts) {
+    Authenticator acca(sk);
+    Authenticator accaPk(acca.getDpk());
+    const size_t count = 16;
+    std::vector<Authenticator::ct_t> proofCts(count, ct);
+    std::vector<Authenticator::st_t> sts(count);
+    for (size_t i = 0; i < count; i++) {
+        proofCts[i][Authenticator::CT_LEN - 1] = i;
+        sts[i] = xs[i];
+    }
+    // an equivocation is fine as well
+    proofCts.push_back(proofCts[3]);
+    sts.push_back(m1);
+
+    MultiProof proof;
+    acca.authenticateMulti(proof, proofCts, sts);
+    EXPECT_TRUE(accaPk.verifyMulti(proof, proofCts, sts));
+    // 16 contexts form a full subtree of depth 4
+    EXPECT_EQ(2 * (count + 1) + (4 + 2 + 1) + (Authenticator::DEPTH - 5), proof.rs.size());
+    EXPECT_EQ(count + 1 + (Authenticator::DEPTH - 4), proof.chs.size());
+
+    Wire::bytes_t enc = Wire::encodeMultiProof(proof);
+    EXPECT_LT(enc.size(), 2 * Wire::TOKEN_LEN);
+    MultiProof decoded;
+    Wire::decodeMultiProof(decoded, enc.data(), enc.size());
+    EXPECT_TRUE(accaPk.verifyMulti(decoded, proofCts, sts));
+    EXPECT_THROW(Wire::decodeMultiProof(decoded, enc.data(), enc.size() - 1), std::invalid_argument);
+
+    std::vector<Authenticator::st_t> wrong = sts;
+    wrong[5] = m2;
+    EXPECT_FALSE(accaPk.verifyMulti(proof, proofCts, wrong));
+    MultiProof tampered = proof;
+    tampered.rs.back()[ChameleonHash::RAND_LEN - 1] ^= 1;
+    EXPECT_FALSE(accaPk.verifyMulti(tampered, proofCts, sts));
+    tampered = proof;
+    tampered.chs.pop_back();
+    EXPECT_FALSE(accaPk.verifyMulti(tampered, proofCts, sts));
+
+    // a single assertion needs as much as a token
+    MultiProof single;
+    Authenticator::token_t t;
+    acca.authenticate(t, ct, m1);
+    MultiProof::fromTokens(single, { t }, { ct });
+    EXPECT_EQ(Authenticator::DEPTH, single.rs.size());
+    EXPECT_EQ(Authenticator::DEPTH, single.chs.size());
+    EXPECT_TRUE(accaPk.verifyMulti(single, { ct }, { m1 }));
+}
+
+TEST_F(AuthenticatorTest, StreamingVerifierMatchesVerify) {
+    Authenticator acca(sk);
+    Authenticator accaPk(acca.getDpk());
+    Authenticator::token_t t;
+    acca.authenticate(t, ct, m1);
+    Wire::bytes_t enc = Wire::encodeToken(t);
+    // followed by the start of the next message
+    enc.resize(enc.size() + 5, 0xAA);
+
+    uniform_int_distribution<size_t> chunk(1, 100);
+    StreamingVerifier sv(accaPk, ct, m1);
+    size_t pos = 0;
+    while (!sv.done()) {
+        size_t n = std::min(chunk(gen), enc.size() - pos);
+        pos += sv.feed(enc.data() + pos, n);
+        EXPECT_TRUE(sv.good());
+    }
+    EXPECT_EQ(Wire::TOKEN_LEN, pos);
+    EXPECT_TRUE(sv.valid());
+    EXPECT_EQ(0, sv.feed(enc.data() + pos, 5));
+
+    // wrong statement, fed at once
+    ChameleonHash::digest_t d2;
+    ChameleonHash::digest(d2, m2);
+    sv.reset(ct, d2);
+    EXPECT_EQ(Wire::TOKEN_LEN, sv.feed(enc.data(), enc.size()));
+    EXPECT_TRUE(sv.done());
+    EXPECT_FALSE(sv.valid());
+
+    // tampered level, fed in two parts split in the middle of the level
+    size_t tampered = Wire::HEADER_LEN + Wire::PARITY_LEN + 2 * Wire::LEVEL_LEN + Wire::LEVEL_LEN / 2;
+    enc[tampered] ^= 1;
+    StreamingVerifier sv2(accaPk, ct, m1);
+    EXPECT_EQ(tampered, sv2.feed(enc.data(), tampered));
+    sv2.feed(enc.data() + tampered, enc.size() - tampered);
+    EXPECT_TRUE(sv2.done());
+    EXPECT_FALSE(sv2.valid());
+
+    enc[0] ^= 1;
+    StreamingVerifier sv3(accaPk, ct, m1);
+    EXPECT_THROW(sv3.feed(enc.data(), enc.size()), std::invalid_argument);
+    EXPECT_FALSE(sv3.good());
+}
+
+TEST_F(AuthenticatorTest, AnyAuthenticatorAllContextLengths) {
+    std::set<ChameleonHash::digest_t> rootDigests;
+    for (size_t ctLen : {2, 3, 4, 8}) {
+        ASSERT_TRUE(AnyAuthenticator::supports(ctLen));
+        AnyAuthenticator acca(sk, ctLen);
+        AnyAuthenticator::dpk_t dpk = acca.getDpk();
+        EXPECT_EQ(ctLen, dpk.ctLen);
+        // the trees of different depths are independent
+        EXPECT_TRUE(rootDigests.insert(dpk.rootDigest).second);
+
+        AnyAuthenticator::ct_t anyCt(ctLen);
+        for (size_t i = 0; i < ctLen; i++) {
+            anyCt[i] = 0x35 * (i + 1);
+        }
+        AnyAuthenticator::token_t t1, t2;
+        acca.authenticate(t1, anyCt, m1);
+        acca.authenticate(t2, anyCt, m2);
+
+        AnyAuthenticator accaPk(dpk);
+        EXPECT_EQ(ctLen, accaPk.getCtLen());
+        EXPECT_TRUE(accaPk.verify(t1, anyCt, m1));
+        EXPECT_FALSE(accaPk.verify(t1, anyCt, m2));
+        EXPECT_THROW(accaPk.verify(t1, AnyAuthenticator::ct_t(ctLen + 1), m1), std::invalid_argument);
+        accaPk.extract(t1, t2, anyCt, m1, m2);
+        EXPECT_EQ(sk, accaPk.getDsk());
+
+        if (ctLen != Authenticator::CT_LEN) {
+            EXPECT_THROW(Authenticator accaWrong(dpk), std::invalid_argument);
+        } else {
+            // same tokens as the authenticator with the length fixed at compile time
+            Authenticator accaFixed(sk);
+            Authenticator::token_t t;
+            AnyAuthenticator::token_t any;
+            accaFixed.authenticate(t, ct, m1);
+            acca.authenticate(any, AnyAuthenticator::ct_t(ct.begin(), ct.end()), m1);
+            EXPECT_EQ(Wire::encodeToken(t), any);
+        }
+    }
+    EXPECT_FALSE(AnyAuthenticator::supports(0));
+    EXPECT_THROW(AnyAuthenticator(sk, 0), std::invalid_argument);
+}
+
+TEST_F(AuthenticatorTest, EquivocationStoreDetectsConflicts) {
+    const std::string dir = "equivocation-test";
+    removeStore(dir);
+
+    Authenticator acca(sk);
+    Authenticator::dpk_t dpk = acca.getDpk();
+    Authenticator::token_t t1, t2;
+    acca.authenticate(t1, ct, m1);
+    acca.authenticate(t2, ct, m2);
+    Authenticator::dsk_t dsk = {};
+    KeyRegistry verifiers(10 * KeyRegistry::ENTRY_SIZE);
+
+    // assertions in fresh contexts
+    const size_t k = 32;
+    std::vector<Wire::bytes_t> encs(k);
+    std::vector<ChameleonHash::digest_t> ds(k);
+    for (size_t i = 0; i < k; i++) {
+        Authenticator::token_t t;
+        acca.authenticate(t, cts[i], xs[i]);
+        encs[i] = Wire::encodeToken(t);
+        ChameleonHash::digest(ds[i], xs[i]);
+    }
+
     {
-        clock_t begin = clock();
-        for (int i = 0; i < n; i++) {
-            acca.authenticate(ts[i], cts[i], xs[i]);
+        EquivocationStore store(dir, 100000, verifiers);
+        EXPECT_FALSE(store.ingest(dsk, dpk, ct, m1, t1));
+        EXPECT_FALSE(store.ingest(dsk, dpk, ct, m1, t1));
+        EXPECT_EQ(1, store.size());
+
+        for (size_t i = 0; i < k; i++) {
+            EXPECT_FALSE(store.ingest(dsk, dpk, cts[i], ds[i], TokenView(encs[i].data(), encs[i].size())));
         }
-        clock_t end = clock();
-        double elapsed_usecs = double(end - begin) * 1000000 / (CLOCKS_PER_SEC * n);
+        EXPECT_EQ(1 + k, store.size());
+
+        // a token that does not verify must not occupy the slot of its context
+        EXPECT_THROW(store.ingest(dsk, dpk, cts[k], ds[0], TokenView(encs[0].data(), encs[0].size())), std::invalid_argument);
+        EXPECT_THROW(store.ingest(dsk, dpk, ct, m2, t1), std::invalid_argument);
+        EXPECT_EQ(1 + k, store.size());
+    }
+
+    // reopen and equivocate
+    {
+        EquivocationStore store(dir, 100000, verifiers);
+        EXPECT_EQ(1 + k, store.size());
+        EXPECT_TRUE(store.ingest(dsk, dpk, ct, m2, t2));
+        EXPECT_EQ(sk, dsk);
+    }
+
+    // a lost Bloom filter is rebuilt from the log
+    std::remove((dir + "/bloom").c_str());
+    EquivocationStore store(dir, 100000, verifiers);
+    dsk = {};
+    Authenticator::token_t t;
+    acca.authenticate(t, cts[0], xs[1]);
+    EXPECT_TRUE(store.ingest(dsk, dpk, cts[0], xs[1], t));
+    EXPECT_EQ(sk, dsk);
+    removeStore(dir);
+}
+
+TEST_F(AuthenticatorTest, AuditPipelineDetectsEquivocation) {
+    const std::string dir = "pipeline-test";
+    const size_t k = 200;
+    removeStore(dir);
 
-        cout << elapsed_usecs << " microseconds for authentication on avg" << endl;
+    Authenticator acca(sk);
+    Wire::bytes_t dpk = Wire::encodeDpk(acca.getDpk());
+    std::vector<AuditPipeline::assertion_t> assertions;
+    for (size_t i = 0; i < k; i++) {
+        Authenticator::token_t t;
+        acca.authenticate(t, cts[i], xs[i]);
+        assertions.push_back(AuditPipeline::assertion_t{dpk, cts[i], xs[i], Wire::encodeToken(t)});
     }
+    // an invalid token, a malformed token and an equivocation
+    assertions.push_back(AuditPipeline::assertion_t{dpk, cts[0], m1, assertions[1].token});
+    assertions.push_back(AuditPipeline::assertion_t{dpk, cts[0], m1, Wire::bytes_t(10)});
+    Authenticator::token_t t;
+    acca.authenticate(t, cts[0], m2);
+    assertions.push_back(AuditPipeline::assertion_t{dpk, cts[0], m2, Wire::encodeToken(t)});
+
+    KeyRegistry keys(10 * KeyRegistry::ENTRY_SIZE);
+    EquivocationStore store(dir, 10000, keys);
+    std::vector<Authenticator::dsk_t> extracted;
+    std::mutex mutex;
+    AuditPipeline::config_t config;
+    config.threads[AuditPipeline::VERIFY] = 2;
+    config.queueCapacity = 16;
+
     {
-        clock_t begin = clock();
-        for (int i = 0; i < n; i++) {
-            EXPECT_TRUE(acca.verify(ts[i], cts[i], xs[i]));
+        AuditPipeline pipeline(keys, store, config, [&](const AuditPipeline::equivocation_t& e) {
+            std::lock_guard<std::mutex> lock(mutex);
+            extracted.push_back(e.dsk);
+        });
+        for (auto& a : assertions) {
+            pipeline.submit(std::move(a));
         }
-        clock_t end = clock();
+        pipeline.close();
+
+        AuditPipeline::stats_t stats = pipeline.getStats();
+        EXPECT_EQ(k + 3, stats.stages[AuditPipeline::HASH].items);
+        EXPECT_EQ(k + 2, stats.stages[AuditPipeline::VERIFY].items);
+        EXPECT_EQ(k + 1, stats.stages[AuditPipeline::DETECT].items);
+        EXPECT_EQ(1, stats.stages[AuditPipeline::EXTRACT].items);
+        EXPECT_EQ(1, stats.malformed);
+        EXPECT_EQ(1, stats.invalid);
+        EXPECT_EQ(1, stats.equivocations);
+        for (const auto& stage : stats.stages) {
+            EXPECT_LE(stage.maxQueueDepth, 16);
+        }
+    }
+    ASSERT_EQ(1, extracted.size());
+    EXPECT_EQ(sk, extracted[0]);
+    removeStore(dir);
+}
+
+TEST_F(AuthenticatorTest, AuditPipelineSurvivesFailedExtraction) {
+    const std::string dir = "pipeline-error-test";
+    removeStore(dir);
+
+    Authenticator acca(sk);
+    Authenticator::dpk_t dpk = acca.getDpk();
+    Wire::bytes_t encDpk = Wire::encodeDpk(dpk);
+    Authenticator::token_t t0, t1, t2;
+    acca.authenticate(t0, cts[0], m1);
+    acca.authenticate(t1, ct, m1);
+    acca.authenticate(t2, ct, m2);
+    Wire::bytes_t enc0 = Wire::encodeToken(t0);
+
+    KeyRegistry keys(10 * KeyRegistry::ENTRY_SIZE);
+    EquivocationStore store(dir, 10000, keys);
+    // record a token that is not valid for ct, so that extraction from it fails
+    ChameleonHash::digest_t d1, otherDigest;
+    Wire::bytes_t other;
+    ChameleonHash::digest(d1, m1);
+    EXPECT_FALSE(store.detectVerified(otherDigest, other, dpk, ct, d1, TokenView(enc0.data(), enc0.size())));
+
+    std::vector<Authenticator::dsk_t> extracted;
+    std::mutex mutex;
+    {
+        AuditPipeline pipeline(keys, store, AuditPipeline::config_t(), [&](const AuditPipeline::equivocation_t& e) {
+            std::lock_guard<std::mutex> lock(mutex);
+            extracted.push_back(e.dsk);
+        });
+        pipeline.submit(AuditPipeline::assertion_t{encDpk, ct, m2, Wire::encodeToken(t2)});
+        // an equivocation afterwards is still detected
+        pipeline.submit(AuditPipeline::assertion_t{encDpk, cts[1], xs[1], Wire::encodeToken(t1)});
+        Authenticator::token_t t;
+        acca.authenticate(t, cts[1], xs[1]);
+        pipeline.submit(AuditPipeline::assertion_t{encDpk, cts[1], xs[1], Wire::encodeToken(t)});
+        acca.authenticate(t, cts[1], m2);
+        pipeline.submit(AuditPipeline::assertion_t{encDpk, cts[1], m2, Wire::encodeToken(t)});
+        pipeline.close();
+
+        AuditPipeline::stats_t stats = pipeline.getStats();
+        EXPECT_EQ(1, stats.invalid);
+        EXPECT_EQ(1, stats.errors);
+        EXPECT_EQ(1, stats.equivocations);
+    }
+    ASSERT_EQ(1, extracted.size());
+    EXPECT_EQ(sk, extracted[0]);
+    removeStore(dir);
+}
+
+TEST_F(AuthenticatorTest, KeyRegistryHitsAndEvictions) {
+    Authenticator acca1(sk);
+    Authenticator acca2(rs[0]);
+    Authenticator acca3(rs[1]);
+    Authenticator::token_t t;
+    acca1.authenticate(t, ct, m1);
+
+    KeyRegistry registry(2 * KeyRegistry::ENTRY_SIZE);
+    EXPECT_TRUE(registry.get(acca1.getDpk())->verify(t, ct, m1));
+    EXPECT_TRUE(registry.get(acca1.getDpk())->verify(t, ct, m1));
+    EXPECT_FALSE(registry.get(acca2.getDpk())->verify(t, ct, m1));
+    // evicts the least recently used key, which is the one of acca1
+    registry.get(acca3.getDpk());
+    registry.get(acca1.getDpk());
+
+    KeyRegistry::stats_t stats = registry.getStats();
+    EXPECT_EQ(1, stats.hits);
+    EXPECT_EQ(4, stats.misses);
+    EXPECT_EQ(2, stats.evictions);
+    EXPECT_EQ(2, stats.entries);
+
+    registry.setMemoryBudget(0);
+    EXPECT_EQ(0, registry.getStats().entries);
+}
+
+TEST_F(AuthenticatorTest, TreeCacheSameTokens) {
+    const char* path = "treecache-test.bin";
+    TreeCache::create(path, sk, 8, 2);
+    auto cache = std::make_shared<const TreeCache>(path);
+    std::remove(path);
+
+    Authenticator acca(sk);
+    Authenticator accaCached(sk);
+    EXPECT_EQ(acca.getDpk().rootDigest, cache->getRootDigest());
+    accaCached.setTreeCache(cache);
+    EXPECT_THROW(Authenticator(rs[0]).setTreeCache(cache), std::invalid_argument);
+
+    for (int i = 0; i < 10; i++) {
+        Authenticator::token_t t1, t2;
+        acca.authenticate(t1, cts[i], xs[i]);
+        accaCached.authenticate(t2, cts[i], xs[i]);
+        EXPECT_EQ(t1.chs, t2.chs) << "failed at index " << i;
+        EXPECT_EQ(t1.rs, t2.rs) << "failed at index " << i;
+        EXPECT_TRUE(acca.verify(t2, cts[i], xs[i])) << "failed at index " << i;
+    }
+}
+
+TEST_F(AuthenticatorTest, VerifiedNodeCacheEarlyExit) {
+    const int k = 8;
+    Authenticator acca(sk);
+    Authenticator accaPk(acca.getDpk());
+    auto cache = std::make_shared<VerifiedNodeCache>(acca.getDpk().rootDigest, 1000);
+    accaPk.setVerifiedNodeCache(cache);
+    EXPECT_THROW(Authenticator(rs[0]).setVerifiedNodeCache(cache), std::invalid_argument);
+
+    // sequential contexts
+    std::vector<Authenticator::token_t> ts(k);
+    std::vector<Authenticator::ct_t> seqCts(k, ct);
+    std::vector<Authenticator::st_t> sts(xs.begin(), xs.begin() + k);
+    for (int i = 0; i < k; i++) {
+        seqCts[i].back() = i;
+        acca.authenticate(ts[i], seqCts[i], sts[i]);
+    }
+
+    for (int i = 0; i < k; i++) {
+        EXPECT_TRUE(accaPk.verify(ts[i], seqCts[i], sts[i])) << "failed at index " << i;
+    }
+    EXPECT_LE(k - 1, cache->getStats().hits);
+    EXPECT_EQ(std::vector<bool>(k, true), accaPk.verifyBatch(ts, seqCts, sts));
+
+    // the part of the token above the cached node must still be checked
+    Authenticator::token_t t = ts[0];
+    t.chs[Authenticator::DEPTH - 1][ChameleonHash::HASH_LEN/2] ^= 1;
+    EXPECT_FALSE(accaPk.verify(t, seqCts[0], sts[0]));
+    t = ts[0];
+    t.rs[Authenticator::DEPTH - 1][ChameleonHash::RAND_LEN/2] ^= 1;
+    EXPECT_FALSE(accaPk.verify(t, seqCts[0], sts[0]));
+    EXPECT_FALSE(accaPk.verify(ts[0], seqCts[0], m1));
+}
+
+TEST_F(AuthenticatorTest, AuthenticatorCorrectRandom) {
+    Authenticator acca(sk);
+    std::vector<Authenticator::token_t> ts(n);
+    for (int i = 0; i < n; i++) {
+        acca.authenticate(ts[i], cts[i], xs[i]);
+    }
+    for (int i = 0; i < n; i++) {
+        EXPECT_TRUE(acca.verify(ts[i], cts[i], xs[i]));
+    }
+}
 
-        double elapsed_usecs = double(end - begin) * 1000000 / (CLOCKS_PER_SEC * n);
-        cout << elapsed_usecs << " microseconds for verification on avg" << endl;
+TEST_F(AuthenticatorTest, AuthenticatorVerifyBatch) {
+    const int k = 100;
+    Authenticator acca(sk);
+    Authenticator accaPk(acca.getDpk());
+    std::vector<Authenticator::token_t> ts(k);
+    std::vector<Authenticator::ct_t> batchCts(cts.begin(), cts.begin() + k);
+    std::vector<Authenticator::st_t> batchSts(xs.begin(), xs.begin() + k);
+    for (int i = 0; i < k; i++) {
+        acca.authenticate(ts[i], batchCts[i], batchSts[i]);
+    }
+
+    EXPECT_EQ(std::vector<bool>(k, true), accaPk.verifyBatch(ts, batchCts, batchSts));
+
+    ts[3].chs[Authenticator::DEPTH/2][ChameleonHash::HASH_LEN/2] ^= (1 << 5);
+    // randomness that overflows the group order
+    ts[7].rs[0].fill(0xff);
+    batchSts[11] = m2;
+    std::vector<bool> res = accaPk.verifyBatch(ts, batchCts, batchSts);
+    for (int i = 0; i < k; i++) {
+        EXPECT_EQ(i != 3 && i != 7 && i != 11, res[i]) << "failed at index " << i;
+    }
+}
+
+TEST_F(AuthenticatorTest, WorkStealingPoolCoversAll) {
+    WorkStealingPool pool(4);
+    std::vector<std::atomic<int>> counts(n);
+    for (auto& c : counts) {
+        c = 0;
+    }
+    // uneven running times force the workers to steal
+    pool.parallelFor(n, [&](size_t i) {
+        if (i < 10) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        counts[i]++;
+    });
+    for (int i = 0; i < n; i++) {
+        EXPECT_EQ(1, counts[i]) << "failed at index " << i;
+    }
+    pool.parallelFor(0, [&](size_t i) { counts[i]++; });
+
+    EXPECT_THROW(pool.parallelFor(n, [&](size_t i) {
+        if (i == n / 2) {
+            throw std::runtime_error("test");
+        }
+    }), std::runtime_error);
+}
+
+TEST_F(AuthenticatorTest, Sha256AcceleratedMatches) {
+    if (!Sha256::hasShaExtensions()) {
+        cout << "SHA extensions not supported, skipping" << endl;
+        return;
+    }
+
+    std::vector<unsigned char> data(300);
+    for (size_t i = 0; i < data.size(); i++) {
+        data[i] = i * 13 + 1;
+    }
+    for (size_t len = 0; len <= data.size(); len += 7) {
+        unsigned char out[2][Sha256::OUT_LEN];
+        for (int accelerated = 0; accelerated < 2; accelerated++) {
+            Sha256::setAccelerated(accelerated);
+            // write in uneven pieces to exercise the buffering
+            Sha256 hash;
+            size_t half = len / 3;
+            hash.write(data.data(), half);
+            hash.write(data.data() + half, len - half);
+            hash.finalize(out[accelerated]);
+        }
+        EXPECT_TRUE(std::equal(out[0], out[0] + Sha256::OUT_LEN, out[1])) << "length " << len;
+
+        Sha256::setAccelerated(true);
+        HmacSha256 hmac(data.data(), len);
+        hmac.write(data.data(), len);
+        hmac.finalize(out[1]);
+        secp256k1_hmac_sha256_t expected;
+        secp256k1_hmac_sha256_initialize(&expected, data.data(), len);
+        secp256k1_hmac_sha256_write(&expected, data.data(), len);
+        secp256k1_hmac_sha256_finalize(&expected, out[0]);
+        EXPECT_TRUE(std::equal(out[0], out[0] + Sha256::OUT_LEN, out[1])) << "length " << len;
+    }
+
+    const int k = 10;
+    std::vector<Authenticator::token_t> ts[2];
+    for (int accelerated = 0; accelerated < 2; accelerated++) {
+        Sha256::setAccelerated(accelerated);
+        Authenticator acca(sk);
+        Authenticator verifier(acca.getDpk());
+        ts[accelerated].resize(k);
+        for (int i = 0; i < k; i++) {
+            acca.authenticate(ts[accelerated][i], cts[i], xs[i]);
+            EXPECT_TRUE(verifier.verify(ts[accelerated][i], cts[i], xs[i]));
+        }
+    }
+    Sha256::setAccelerated(true);
+    for (int i = 0; i < k; i++) {
+        EXPECT_EQ(ts[0][i].chs, ts[1][i].chs) << "failed at index " << i;
+        EXPECT_EQ(ts[0][i].rs, ts[1][i].rs) << "failed at index " << i;
+    }
+}
+
+TEST_F(AuthenticatorTest, Sha256MultiKnownAnswers) {
+    const Sha256Multi::kernel_t kernels[] = { Sha256Multi::SCALAR, Sha256Multi::SSE2, Sha256Multi::AVX2 };
+    const Sha256Multi::kernel_t best = Sha256Multi::bestKernel();
+
+    const unsigned char abc[] = "abc";
+    const unsigned char abcHash[] = {
+        0xba, 0x78, 0x16, 0xbf, 0x8f, 0x01, 0xcf, 0xea, 0x41, 0x41, 0x40, 0xde, 0x5d, 0xae, 0x22, 0x23,
+        0xb0, 0x03, 0x61, 0xa3, 0x96, 0x17, 0x7a, 0x9c, 0xb4, 0x10, 0xff, 0x61, 0xf2, 0x00, 0x15, 0xad
+    };
+    // RFC 4231, test case 2
+    const unsigned char jefe[] = "Jefe";
+    const unsigned char what[] = "what do ya want for nothing?";
+    const unsigned char jefeHmac[] = {
+        0x5b, 0xdc, 0xc1, 0x46, 0xbf, 0x60, 0x75, 0x4e, 0x6a, 0x04, 0x24, 0x26, 0x08, 0x95, 0x75, 0xc7,
+        0x5a, 0x00, 0x3f, 0x08, 0x9d, 0x27, 0x39, 0x83, 0x9d, 0xec, 0x58, 0xb9, 0x64, 0xec, 0x38, 0x43
+    };
+    Sha256Multi::hmac_key_t key;
+    Sha256Multi::hmacKey(key, jefe, 4);
+
+    // 13 messages exercise all kernels and the scalar tail
+    const size_t n = 13;
+    std::vector<unsigned char> data(n * 200);
+    for (size_t i = 0; i < data.size(); i++) {
+        data[i] = i * 7 + 3;
+    }
+
+    for (auto kernel : kernels) {
+        if (kernel > best) {
+            continue;
+        }
+        Sha256Multi::setKernel(kernel);
+        std::vector<const unsigned char*> msgs(n);
+        unsigned char out[n * Sha256Multi::OUT_LEN];
+
+        std::fill(msgs.begin(), msgs.end(), abc);
+        Sha256Multi::hash(out, Sha256Multi::initial(), msgs.data(), 3, n);
+        for (size_t i = 0; i < n; i++) {
+            EXPECT_TRUE(std::equal(abcHash, abcHash + 32, out + 32*i)) << "kernel " << kernel;
+        }
+
+        std::fill(msgs.begin(), msgs.end(), what);
+        Sha256Multi::hmac(out, key, msgs.data(), 28, n);
+        for (size_t i = 0; i < n; i++) {
+            EXPECT_TRUE(std::equal(jefeHmac, jefeHmac + 32, out + 32*i)) << "kernel " << kernel;
+        }
+
+        for (size_t len = 0; len <= 130; len++) {
+            for (size_t i = 0; i < n; i++) {
+                msgs[i] = data.data() + i*200 + len % 5;
+            }
+            Sha256Multi::hash(out, Sha256Multi::initial(), msgs.data(), len, n);
+            for (size_t i = 0; i < n; i++) {
+                unsigned char expected[32];
+                secp256k1_sha256_t sha;
+                secp256k1_sha256_initialize(&sha);
+                secp256k1_sha256_write(&sha, msgs[i], len);
+                secp256k1_sha256_finalize(&sha, expected);
+                EXPECT_TRUE(std::equal(expected, expected + 32, out + 32*i)) << "kernel " << kernel << ", length " << len;
+            }
+        }
+    }
+    Sha256Multi::setKernel(best);
+}
+
+TEST_F(AuthenticatorTest, ScalarMultiKernelsMatch) {
+    const ScalarMulti::kernel_t kernels[] = { ScalarMulti::SCALAR, ScalarMulti::AVX2, ScalarMulti::AVX512IFMA };
+    const ScalarMulti::kernel_t best = ScalarMulti::bestKernel();
+
+    // 21 values exercise all kernels and the partial last chunk
+    const size_t n = 21;
+    std::mt19937_64 gen(7);
+    std::vector<ScalarMulti::scalar_t> as(n), bs(n), cs(n), ds(n);
+    for (auto* v : { &as, &bs, &cs, &ds }) {
+        for (auto& x : *v) {
+            secp256k1_scalar_t xs;
+            std::generate(x.begin(), x.end(), [&]() { return gen() & 0xff; });
+            secp256k1_scalar_set_b32(&xs, x.data(), nullptr);
+            secp256k1_scalar_get_b32(x.data(), &xs);
+        }
+    }
+    // extreme values: zero, one and n-1
+    secp256k1_scalar_t zero, one, minusOne;
+    secp256k1_scalar_set_int(&zero, 0);
+    secp256k1_scalar_set_int(&one, 1);
+    secp256k1_scalar_negate(&minusOne, &one);
+    secp256k1_scalar_get_b32(as[0].data(), &zero);
+    secp256k1_scalar_get_b32(bs[1].data(), &minusOne);
+    secp256k1_scalar_get_b32(cs[1].data(), &minusOne);
+    secp256k1_scalar_get_b32(as[2].data(), &minusOne);
+    secp256k1_scalar_get_b32(bs[2].data(), &one);
+    secp256k1_scalar_get_b32(ds[2].data(), &minusOne);
+    EXPECT_FALSE(ScalarMulti::isBelowOrder(ScalarMulti::scalar_t{{ 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+                                                                    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff }}));
+    EXPECT_TRUE(ScalarMulti::isBelowOrder(as[2]));
+
+    Authenticator acca(sk);
+    WorkStealingPool pool(2);
+    std::vector<Authenticator::ct_t> batchCts(cts.begin(), cts.begin() + n);
+    std::vector<Authenticator::st_t> batchSts(xs.begin(), xs.begin() + n);
+    std::vector<Authenticator::token_t> expected(n);
+    for (size_t i = 0; i < n; i++) {
+        acca.authenticate(expected[i], batchCts[i], batchSts[i]);
+    }
+    Authenticator::token_t other;
+    acca.authenticate(other, batchCts[0], m2);
+
+    std::vector<ScalarMulti::scalar_t> expectedMulAdd(n), expectedMul(n);
+    for (size_t i = 0; i < n; i++) {
+        secp256k1_scalar_t a, b, c, d, x;
+        secp256k1_scalar_set_b32(&a, as[i].data(), nullptr);
+        secp256k1_scalar_set_b32(&b, bs[i].data(), nullptr);
+        secp256k1_scalar_set_b32(&c, cs[i].data(), nullptr);
+        secp256k1_scalar_set_b32(&d, ds[i].data(), nullptr);
+        secp256k1_scalar_negate(&b, &b);
+        secp256k1_scalar_add(&a, &a, &b);
+        secp256k1_scalar_mul(&x, &a, &c);
+        secp256k1_scalar_get_b32(expectedMul[i].data(), &x);
+        secp256k1_scalar_set_b32(&c, cs[1].data(), nullptr);
+        secp256k1_scalar_mul(&x, &a, &c);
+        secp256k1_scalar_add(&x, &x, &d);
+        secp256k1_scalar_get_b32(expectedMulAdd[i].data(), &x);
+    }
+
+    for (auto kernel : kernels) {
+        if (kernel > best) {
+            continue;
+        }
+        ScalarMulti::setKernel(kernel);
+        for (size_t count : { (size_t) 1, (size_t) 5, n }) {
+            std::vector<ScalarMulti::scalar_t> out(n);
+            ScalarMulti::subMulAdd(out.data(), as.data(), bs.data(), cs[1], ds.data(), count);
+            for (size_t i = 0; i < count; i++) {
+                EXPECT_EQ(expectedMulAdd[i], out[i]) << "kernel " << kernel << ", index " << i;
+            }
+            ScalarMulti::subMul(out.data(), as.data(), bs.data(), cs.data(), count);
+            for (size_t i = 0; i < count; i++) {
+                EXPECT_EQ(expectedMul[i], out[i]) << "kernel " << kernel << ", index " << i;
+            }
+        }
+        // in place
+        std::vector<ScalarMulti::scalar_t> out(as);
+        ScalarMulti::subMul(out.data(), out.data(), bs.data(), cs.data(), n);
+        EXPECT_EQ(expectedMul, out) << "kernel " << kernel;
+
+        // batched authentication uses the kernels for the collisions
+        std::vector<Authenticator::token_t> ts;
+        acca.authenticateMany(ts, batchCts, batchSts, pool);
+        for (size_t i = 0; i < n; i++) {
+            EXPECT_EQ(expected[i].chs, ts[i].chs) << "kernel " << kernel << ", index " << i;
+            EXPECT_EQ(expected[i].rs, ts[i].rs) << "kernel " << kernel << ", index " << i;
+        }
+    }
+    ScalarMulti::setKernel(best);
+
+    // batched extraction does not depend on the kernel
+    std::vector<Authenticator::dsk_t> dsks;
+    std::vector<bool> ok = Authenticator::extractBatch(dsks, { acca.getDpk() }, { expected[0] }, { other }, { batchCts[0] }, { batchSts[0] }, { m2 });
+    EXPECT_TRUE(ok[0]);
+    EXPECT_EQ(sk, dsks[0]);
+    EXPECT_THROW(ScalarMulti::setKernel((ScalarMulti::kernel_t) (best * 2)), std::invalid_argument);
+}
+
+TEST_F(AuthenticatorTest, PrfBatchMatchesSingle) {
+    Prf prf(sk, Authenticator::CT_LEN);
+    std::vector<Node> nodes;
+    Node node(cts[0]);
+    do {
+        nodes.push_back(node);
+        node.moveToSibling();
+        nodes.push_back(node);
+        node.moveToSibling();
+    } while (node.moveToParent());
+
+    std::vector<Prf::out_t> xs(nodes.size()), rs(nodes.size());
+    prf.getXRs(xs.data(), rs.data(), nodes.data(), nodes.size());
+    for (size_t i = 0; i < nodes.size(); i++) {
+        Prf::out_t x, r;
+        prf.getXR(x, r, nodes[i]);
+        EXPECT_EQ(x, xs[i]) << "failed at index " << i;
+        EXPECT_EQ(r, rs[i]) << "failed at index " << i;
+    }
+
+    std::vector<ChameleonHash::hash_t> ins(cts.size());
+    std::vector<ChameleonHash::rand_t> rands(cts.size());
+    for (size_t i = 0; i < ins.size(); i++) {
+        std::copy(cts[i].begin(), cts[i].end(), ins[i].begin());
+        std::copy(xs[i % xs.size()].begin(), xs[i % xs.size()].end(), rands[i].begin());
+    }
+    std::vector<ChameleonHash::digest_t> digests(ins.size());
+    std::vector<ChameleonHash::hash_t> oracles(ins.size());
+    ChameleonHash::digest(digests.data(), ins.data(), ins.data() + 1, ins.size() - 1);
+    ChameleonHash::randomOracle(oracles.data(), ins.data(), rands.data(), ins.size());
+    for (size_t i = 0; i + 1 < ins.size(); i++) {
+        ChameleonHash::digest_t d;
+        ChameleonHash::hash_t h;
+        ChameleonHash::digest(d, ins[i], ins[i + 1]);
+        ChameleonHash::randomOracle(h, ins[i], rands[i]);
+        EXPECT_EQ(d, digests[i]) << "failed at index " << i;
+        EXPECT_EQ(h, oracles[i]) << "failed at index " << i;
+    }
+}
+
+TEST_F(AuthenticatorTest, PrfXRMatchesSeparate) {
+    Prf prf(sk, Authenticator::CT_LEN);
+    Node node(cts[0]);
+    do {
+        Prf::out_t x1, r1, x2, r2;
+        prf.getX(x1, node);
+        prf.getR(r1, node);
+        prf.getXR(x2, r2, node);
+        EXPECT_EQ(x1, x2);
+        EXPECT_EQ(r1, r2);
+        EXPECT_NE(x1, r1);
+    } while (node.moveToParent());
+}
+
+TEST_F(AuthenticatorTest, LatencyModeSameTokens) {
+    const int k = 50;
+    const char* path = "treecache-latency-test.bin";
+    TreeCache::create(path, sk, 4, 1);
+    auto cache = std::make_shared<const TreeCache>(path);
+    std::remove(path);
+
+    Authenticator acca(sk);
+    Authenticator accaCached(sk);
+    accaCached.setTreeCache(cache);
+    WorkStealingPool team(3, true);
+
+    for (int i = 0; i < k; i++) {
+        Authenticator::token_t t1, t2, t3, t4;
+        acca.authenticate(t1, cts[i], xs[i]);
+        acca.authenticate(t2, cts[i], xs[i], team);
+        accaCached.authenticate(t3, cts[i], xs[i], team);
+        ChameleonHash::digest_t d;
+        ChameleonHash::digest(d, xs[i]);
+        acca.authenticate(t4, cts[i], d, team);
+
+        EXPECT_EQ(t1.chs, t2.chs) << "failed at index " << i;
+        EXPECT_EQ(t1.rs, t2.rs) << "failed at index " << i;
+        EXPECT_EQ(t1.chs, t3.chs) << "failed at index " << i;
+        EXPECT_EQ(t1.rs, t3.rs) << "failed at index " << i;
+        EXPECT_EQ(t1.chs, t4.chs) << "failed at index " << i;
+        EXPECT_EQ(t1.rs, t4.rs) << "failed at index " << i;
+    }
+}
+
+TEST_F(AuthenticatorTest, ParallelAuthenticateVerifyMatches) {
+    const int k = 50;
+    const Authenticator acca(sk);
+    std::vector<Authenticator::token_t> ts, expected(k);
+    std::vector<Authenticator::ct_t> batchCts(cts.begin(), cts.begin() + k);
+    std::vector<Authenticator::st_t> batchSts(xs.begin(), xs.begin() + k);
+    for (int i = 0; i < k; i++) {
+        acca.authenticate(expected[i], batchCts[i], batchSts[i]);
+    }
+
+    unsigned maxThreads = std::max(std::thread::hardware_concurrency(), 2u);
+    for (unsigned threads = 1; threads <= maxThreads; threads *= 2) {
+        WorkStealingPool pool(threads);
+        acca.authenticateMany(ts, batchCts, batchSts, pool);
+        ASSERT_EQ(k, ts.size());
+        for (int i = 0; i < k; i++) {
+            EXPECT_EQ(expected[i].chs, ts[i].chs) << "failed at index " << i << " with " << threads << " threads";
+            EXPECT_EQ(expected[i].rs, ts[i].rs) << "failed at index " << i << " with " << threads << " threads";
+        }
+        EXPECT_EQ(std::vector<bool>(k, true), acca.verifyMany(ts, batchCts, batchSts, pool));
     }
 }
@@ -0,0 +1,642 @@
+/*
+ * Copyright (c) 2015 Tim Ruffing <tim.ruffing@mmci.uni-saarland.de>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+// Benchmarks the primitives and the authenticator and writes the results as JSON,
+// so that they can be tracked over time.
+//
+// Every benchmark runs a number of warmup operations and then times each operation
+// (or each batch of operations for cheap primitives) separately, which gives the
+// latency distribution in addition to the mean. With --perf, CPU cycles and retired
+// instructions per operation are counted with perf_event_open (Linux only).
+
+#include "../authenticator.h"
+#include "../chameleonhash.h"
+#include "../equivocationstore.h"
+#include "../keyregistry.h"
+#include "../multiproof.h"
+#include "../node.h"
+#include "../prf.h"
+#include "../sha256.h"
+#include "../sha256multi.h"
+#include "../workstealingpool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+using namespace std;
+
+namespace {
+
+struct options_t {
+    size_t warmup = 100;
+    size_t reps = 1000;
+    unsigned maxThreads = max(thread::hardware_concurrency(), 1u);
+    bool perf = false;
+    // only run benchmarks whose name contains this string
+    string filter;
+    string out;
+};
+
+// Counts cycles and instructions of the calling thread.
+class PerfCounters
+{
+public:
+    PerfCounters() : cyclesFd(-1), instructionsFd(-1) {
+#ifdef __linux__
+        cyclesFd = open(PERF_COUNT_HW_CPU_CYCLES, -1);
+        if (cyclesFd >= 0) {
+            instructionsFd = open(PERF_COUNT_HW_INSTRUCTIONS, cyclesFd);
+        }
+#endif
+    }
+    ~PerfCounters() {
+#ifdef __linux__
+        if (instructionsFd >= 0) {
+            close(instructionsFd);
+        }
+        if (cyclesFd >= 0) {
+            close(cyclesFd);
+        }
+#endif
+    }
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    // False if the kernel does not allow counting, e.g., because of perf_event_paranoid.
+    bool available() const {
+        return instructionsFd >= 0;
+    }
+
+    void start() {
+#ifdef __linux__
+        ioctl(cyclesFd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(cyclesFd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#endif
+    }
+
+    void stop(uint64_t& cycles, uint64_t& instructions) {
+        cycles = instructions = 0;
+#ifdef __linux__
+        ioctl(cyclesFd, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+        // PERF_FORMAT_GROUP: number of events, then one value per event
+        uint64_t values[3];
+        if (read(cyclesFd, values, sizeof values) == sizeof values && values[0] == 2) {
+            cycles = values[1];
+            instructions = values[2];
+        }
+#endif
+    }
+
+private:
+    int cyclesFd;
+    int instructionsFd;
+
+#ifdef __linux__
+    static int open(uint64_t config, int groupFd) {
+        perf_event_attr attr;
+        memset(&attr, 0, sizeof attr);
+        attr.size = sizeof attr;
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = config;
+        attr.disabled = groupFd < 0;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP;
+        return syscall(__NR_perf_event_open, &attr, 0, -1, groupFd, 0);
+    }
+#endif
+};
+
+// Writes the results as a JSON object with the arrays "benchmarks" and "scaling".
+class Report
+{
+public:
+    Report(ostream& out, const options_t& opts) : out(out), firstResult(true), firstScaling(true) {
+        out << "{" << endl
+            << "  \"version\": 1," << endl
+            << "  \"timestamp\": " << time(nullptr) << "," << endl
+            << "  \"config\": {\"default_ct_len\": " << Authenticator::CT_LEN
+            << ", \"warmup\": " << opts.warmup
+            << ", \"repetitions\": " << opts.reps
+            << ", \"max_threads\": " << opts.maxThreads
+            << ", \"sha256_accelerated\": " << (Sha256::getAccelerated() ? "true" : "false")
+            << ", \"sha256multi_lanes\": " << Sha256Multi::getKernel() << "}," << endl
+            << "  \"benchmarks\": [";
+    }
+
+    // ctLen is 0 for primitives that do not depend on the context length.
+    void result(const string& name, size_t ctLen, size_t batch, vector<double>& nsPerOp, double cycles, double instructions) {
+        sort(nsPerOp.begin(), nsPerOp.end());
+        double sum = 0;
+        for (double ns : nsPerOp) {
+            sum += ns;
+        }
+        double mean = sum / nsPerOp.size();
+
+        out << (firstResult ? "" : ",") << endl
+            << "    {\"name\": \"" << name << "\", \"ct_len\": " << ctLen
+            << ", \"batch\": " << batch
+            << ", \"samples\": " << nsPerOp.size()
+            << ", \"mean_ns\": " << mean
+            << ", \"p50_ns\": " << percentile(nsPerOp, 0.5)
+            << ", \"p99_ns\": " << percentile(nsPerOp, 0.99)
+            << ", \"p999_ns\": " << percentile(nsPerOp, 0.999)
+            << ", \"ops_per_s\": " << 1e9 / mean;
+        if (cycles >= 0) {
+            out << ", \"cycles_per_op\": " << cycles << ", \"instructions_per_op\": " << instructions;
+        }
+        out << "}";
+        firstResult = false;
+        cerr << name << " (ct_len " << ctLen << "): p50 " << percentile(nsPerOp, 0.5) << " ns" << endl;
+    }
+
+    void scaling(const string& name, size_t ctLen, unsigned threads, double opsPerSecond) {
+        if (firstScaling) {
+            out << endl << "  ]," << endl << "  \"scaling\": [";
+        }
+        out << (firstScaling ? "" : ",") << endl
+            << "    {\"name\": \"" << name << "\", \"ct_len\": " << ctLen
+            << ", \"threads\": " << threads
+            << ", \"ops_per_s\": " << opsPerSecond << "}";
+        firstScaling = false;
+        cerr << name << " (ct_len " << ctLen << ", " << threads << " threads): " << opsPerSecond << " ops/s" << endl;
+    }
+
+    void finish() {
+        if (firstScaling) {
+            out << endl << "  ]," << endl << "  \"scaling\": [";
+        }
+        out << endl << "  ]" << endl << "}" << endl;
+    }
+
+private:
+    ostream& out;
+    bool firstResult;
+    bool firstScaling;
+
+    // nearest-rank percentile of sorted values
+    static double percentile(const vector<double>& sorted, double p) {
+        size_t rank = (size_t) (p * sorted.size() + 0.999999);
+        return sorted[min(max<size_t>(rank, 1), sorted.size()) - 1];
+    }
+};
+
+class Bench
+{
+public:
+    Bench(const options_t& opts, Report& report) : opts(opts), report(report) { }
+
+    bool enabled(const string& name) const {
+        return name.find(opts.filter) != string::npos;
+    }
+
+    // Runs op(i) for i = 0, 1, ..., where every sample times batch consecutive calls.
+    void run(const string& name, size_t ctLen, size_t batch, const function<void(size_t)>& op) {
+        if (!enabled(name)) {
+            return;
+        }
+        size_t i = 0;
+        for (size_t w = 0; w < opts.warmup * batch; w++) {
+            op(i++);
+        }
+
+        vector<double> nsPerOp;
+        nsPerOp.reserve(opts.reps);
+        PerfCounters counters;
+        bool perf = opts.perf && counters.available();
+        if (perf) {
+            counters.start();
+        }
+        for (size_t rep = 0; rep < opts.reps; rep++) {
+            auto begin = chrono::steady_clock::now();
+            for (size_t b = 0; b < batch; b++) {
+                op(i++);
+            }
+            auto end = chrono::steady_clock::now();
+            nsPerOp.push_back(chrono::duration<double, nano>(end - begin).count() / batch);
+        }
+        double cycles = -1, instructions = -1;
+        if (perf) {
+            uint64_t c, in;
+            counters.stop(c, in);
+            cycles = double(c) / (opts.reps * batch);
+            instructions = double(in) / (opts.reps * batch);
+        }
+        report.result(name, ctLen, batch, nsPerOp, cycles, instructions);
+    }
+
+private:
+    const options_t& opts;
+    Report& report;
+};
+
+// random inputs, reused cyclically by the benchmarks
+const size_t INPUTS = 1024;
+
+struct inputs_t {
+    ChameleonHash::sk_t sk;
+    vector<ChameleonHash::digest_t> xs;
+    vector<ChameleonHash::rand_t> rs;
+    vector<ChameleonHash::mesg_t> sts;
+
+    inputs_t() : xs(INPUTS), rs(INPUTS), sts(INPUTS, ChameleonHash::mesg_t(32)) {
+        mt19937_64 gen(1);
+        uniform_int_distribution<int> byte(0, 255);
+        // the top byte keeps the key below the group order
+        sk[0] = 0x7f;
+        generate(sk.begin() + 1, sk.end(), [&]() { return byte(gen); });
+        for (size_t i = 0; i < INPUTS; i++) {
+            generate(xs[i].begin(), xs[i].end(), [&]() { return byte(gen); });
+            // randomness must be below the group order as well
+            generate(rs[i].begin(), rs[i].end(), [&]() { return byte(gen); });
+            rs[i][0] &= 0x7f;
+            generate(sts[i].begin(), sts[i].end(), [&]() { return byte(gen); });
+        }
+    }
+};
+
+void benchPrimitives(Bench& bench, const inputs_t& in)
+{
+    ChameleonHash chSk(in.sk);
+    ChameleonHash::pk_t pk = chSk.getPk(true);
+    ChameleonHash chPk(pk);
+    ChameleonHash chTable(pk, true);
+    ChameleonHash::hash_t res;
+    ChameleonHash::rand_t r;
+
+    // public key path: r*pk + x*G
+    bench.run("ecmult", 0, 1, [&](size_t i) {
+        chPk.ch(res, in.xs[i % INPUTS], in.rs[i % INPUTS]);
+    });
+    bench.run("ecmult_table", 0, 1, [&](size_t i) {
+        chTable.ch(res, in.xs[i % INPUTS], in.rs[i % INPUTS]);
+    });
+    // secret key path: (x + sk*r)*G
+    bench.run("ecmult_gen", 0, 1, [&](size_t i) {
+        chSk.ch(res, in.xs[i % INPUTS], in.rs[i % INPUTS]);
+    });
+    bench.run("collision", 0, 1, [&](size_t i) {
+        chSk.collision(in.xs[i % INPUTS], in.rs[i % INPUTS], in.xs[(i + 1) % INPUTS], r);
+    });
+
+    // serialization of points in Jacobian coordinates, single and batched
+    const size_t SERIALIZE_BATCH = 64;
+    vector<secp256k1_gej_t> points(INPUTS);
+    vector<ChameleonHash::hash_t> hashes(INPUTS);
+    if (bench.enabled("serialize") || bench.enabled("serialize_batch")) {
+        for (size_t i = 0; i < INPUTS; i++) {
+            chSk.chJacobian(points[i], in.xs[i], in.rs[i]);
+        }
+    }
+    bench.run("serialize", 0, 1, [&](size_t i) {
+        ChameleonHash::serialize(&hashes[i % INPUTS], &points[i % INPUTS], 1);
+    });
+    bench.run("serialize_batch", 0, SERIALIZE_BATCH, [&](size_t i) {
+        if (i % SERIALIZE_BATCH == 0) {
+            size_t j = i % (INPUTS / SERIALIZE_BATCH) * SERIALIZE_BATCH;
+            ChameleonHash::serialize(&hashes[j], &points[j], SERIALIZE_BATCH);
+        }
+    });
+
+    // one 64-byte block plus padding
+    ChameleonHash::digest_t digest;
+    bench.run("sha256", 0, 16, [&](size_t i) {
+        Sha256 hash;
+        hash.write(in.xs[i % INPUTS].data(), in.xs[i % INPUTS].size());
+        hash.write(in.rs[i % INPUTS].data(), in.rs[i % INPUTS].size());
+        hash.finalize(digest.data());
+    });
+    // the same without the SHA extensions, compare with sha256
+    if (Sha256::hasShaExtensions() && bench.enabled("sha256_fallback")) {
+        Sha256::setAccelerated(false);
+        bench.run("sha256_fallback", 0, 16, [&](size_t i) {
+            Sha256 hash;
+            hash.write(in.xs[i % INPUTS].data(), in.xs[i % INPUTS].size());
+            hash.write(in.rs[i % INPUTS].data(), in.rs[i % INPUTS].size());
+            hash.finalize(digest.data());
+        });
+        Sha256::setAccelerated(true);
+    }
+    const size_t MULTI_BATCH = 64;
+    vector<unsigned char> out(MULTI_BATCH * Sha256Multi::OUT_LEN);
+    vector<const unsigned char*> msgs(MULTI_BATCH);
+    bench.run("sha256multi", 0, MULTI_BATCH, [&](size_t i) {
+        if (i % MULTI_BATCH == 0) {
+            for (size_t j = 0; j < MULTI_BATCH; j++) {
+                msgs[j] = in.sts[(i + j) % INPUTS].data();
+            }
+            Sha256Multi::hash(out.data(), Sha256Multi::initial(), msgs.data(), 32, MULTI_BATCH);
+        }
+    });
+
+    // leaves of random contexts
+    Prf prf(in.sk, Authenticator::CT_LEN);
+    vector<Node> leaves;
+    mt19937_64 gen(0);
+    for (size_t i = 0; i < INPUTS; i++) {
+        Authenticator::ct_t ct;
+        generate(ct.begin(), ct.end(), [&]() { return gen() & 0xff; });
+        leaves.emplace_back(ct);
+    }
+    Prf::out_t x;
+    bench.run("prf", 0, 16, [&](size_t i) {
+        prf.getXR(x, r, leaves[i % INPUTS]);
+    });
+    const size_t PRF_BATCH = 32;
+    vector<Prf::out_t> prfXs(PRF_BATCH), prfRs(PRF_BATCH);
+    bench.run("prf_batch", 0, PRF_BATCH, [&](size_t i) {
+        if (i % PRF_BATCH == 0) {
+            size_t j = i % (INPUTS / PRF_BATCH) * PRF_BATCH;
+            prf.getXRs(prfXs.data(), prfRs.data(), &leaves[j], PRF_BATCH);
+        }
+    });
+}
+
+template<size_t CtLen>
+void benchAuthenticator(Bench& bench, const inputs_t& in)
+{
+    if (!bench.enabled("authenticate") && !bench.enabled("verify") && !bench.enabled("verify_batch") && !bench.enabled("verify_multi")
+            && !bench.enabled("authenticate_online") && !bench.enabled("authenticate_latency") && !bench.enabled("verify_extended")) {
+        return;
+    }
+    typedef BasicAuthenticator<CtLen> Acca;
+    Acca acca(in.sk);
+    Acca accaPk(acca.getDpk(), true);
+
+    vector<typename Acca::ct_t> cts(INPUTS);
+    mt19937_64 gen(CtLen);
+    for (auto& ct : cts) {
+        generate(ct.begin(), ct.end(), [&]() { return gen() & 0xff; });
+    }
+    vector<typename Acca::token_t> ts(INPUTS);
+    for (size_t i = 0; i < INPUTS; i++) {
+        acca.authenticate(ts[i], cts[i], in.sts[i]);
+    }
+
+    typename Acca::token_t t;
+    bench.run("authenticate", CtLen, 1, [&](size_t i) {
+        acca.authenticate(t, cts[i % INPUTS], in.sts[i % INPUTS]);
+    });
+    // the online part of authenticate with a precomputed handle
+    const size_t HANDLES = 64;
+    vector<typename Acca::handle_t> handles;
+    if (bench.enabled("authenticate_online")) {
+        handles.resize(HANDLES);
+        for (size_t i = 0; i < HANDLES; i++) {
+            acca.precompute(handles[i], cts[i]);
+        }
+    }
+    bench.run("authenticate_online", CtLen, 1, [&](size_t i) {
+        acca.authenticate(t, handles[i % HANDLES], in.sts[i % INPUTS]);
+    });
+    // latency mode with a small pinned team, compare with authenticate
+    if (bench.enabled("authenticate_latency")) {
+        WorkStealingPool team(3, true);
+        bench.run("authenticate_latency", CtLen, 1, [&](size_t i) {
+            acca.authenticate(t, cts[i % INPUTS], in.sts[i % INPUTS], team);
+        });
+    }
+    bench.run("verify", CtLen, 1, [&](size_t i) {
+        if (!accaPk.verify(ts[i % INPUTS], cts[i % INPUTS], in.sts[i % INPUTS])) {
+            throw runtime_error("valid token does not verify");
+        }
+    });
+    // extended tokens, compare with verify
+    const size_t EXTENDED = 64;
+    vector<typename Acca::extended_token_t> exts;
+    if (bench.enabled("verify_extended")) {
+        exts.resize(EXTENDED);
+        for (size_t i = 0; i < EXTENDED; i++) {
+            acca.authenticate(exts[i], cts[i], in.sts[i]);
+        }
+    }
+    bench.run("verify_extended", CtLen, 1, [&](size_t i) {
+        if (!accaPk.verify(exts[i % EXTENDED], cts[i % EXTENDED], in.sts[i % EXTENDED])) {
+            throw runtime_error("valid token does not verify");
+        }
+    });
+
+    const size_t VERIFY_BATCH = 64;
+    vector<typename Acca::token_t> batchTs;
+    vector<typename Acca::ct_t> batchCts;
+    vector<typename Acca::st_t> batchSts;
+    bench.run("verify_batch", CtLen, VERIFY_BATCH, [&](size_t i) {
+        if (i % VERIFY_BATCH == 0) {
+            size_t j = i % (INPUTS / VERIFY_BATCH) * VERIFY_BATCH;
+            batchTs.assign(ts.begin() + j, ts.begin() + j + VERIFY_BATCH);
+            batchCts.assign(cts.begin() + j, cts.begin() + j + VERIFY_BATCH);
+            batchSts.assign(in.sts.begin() + j, in.sts.begin() + j + VERIFY_BATCH);
+            std::vector<bool> valid = accaPk.verifyBatch(batchTs, batchCts, batchSts);
+            if (std::find(valid.begin(), valid.end(), false) != valid.end()) {
+                throw runtime_error("valid token does not verify");
+            }
+        }
+    });
+
+    // a run of sequential contexts in a single multiproof, compare with verify_batch
+    typename Acca::MultiProof proof;
+    vector<typename Acca::ct_t> runCts(VERIFY_BATCH, cts[0]);
+    for (size_t i = 0; i < VERIFY_BATCH; i++) {
+        runCts[i][CtLen - 1] = i;
+    }
+    vector<typename Acca::st_t> runSts(in.sts.begin(), in.sts.begin() + VERIFY_BATCH);
+    if (bench.enabled("verify_multi")) {
+        acca.authenticateMulti(proof, runCts, runSts);
+    }
+    bench.run("verify_multi", CtLen, VERIFY_BATCH, [&](size_t i) {
+        if (i % VERIFY_BATCH == 0 && !accaPk.verifyMulti(proof, runCts, runSts)) {
+            throw runtime_error("valid multiproof does not verify");
+        }
+    });
+}
+
+// Throughput of authenticateMany and verifyMany for 1, 2, 4, ... threads.
+void benchScaling(Bench& bench, Report& report, const options_t& opts, const inputs_t& in)
+{
+    bool authenticate = bench.enabled("authenticate_many");
+    bool verify = bench.enabled("verify_many");
+    if (!authenticate && !verify) {
+        return;
+    }
+    Authenticator acca(in.sk);
+    Authenticator accaPk(acca.getDpk(), true);
+    vector<Authenticator::ct_t> cts(opts.reps);
+    vector<Authenticator::st_t> sts(opts.reps);
+    mt19937_64 gen(0);
+    for (size_t i = 0; i < opts.reps; i++) {
+        generate(cts[i].begin(), cts[i].end(), [&]() { return gen() & 0xff; });
+        sts[i] = in.sts[i % INPUTS];
+    }
+    vector<Authenticator::token_t> ts;
+
+    for (unsigned threads = 1; ; threads = min(2 * threads, opts.maxThreads)) {
+        WorkStealingPool pool(threads);
+        // the tokens are needed for verification anyway
+        auto begin = chrono::steady_clock::now();
+        acca.authenticateMany(ts, cts, sts, pool);
+        auto end = chrono::steady_clock::now();
+        if (authenticate) {
+            report.scaling("authenticate_many", Authenticator::CT_LEN, threads, opts.reps / chrono::duration<double>(end - begin).count());
+        }
+        if (verify) {
+            begin = chrono::steady_clock::now();
+            accaPk.verifyMany(ts, cts, sts, pool);
+            end = chrono::steady_clock::now();
+            report.scaling("verify_many", Authenticator::CT_LEN, threads, opts.reps / chrono::duration<double>(end - begin).count());
+        }
+        if (threads == opts.maxThreads) {
+            break;
+        }
+    }
+}
+
+// Assertions in fresh contexts recorded in an equivocation store, including verification.
+void benchStore(Bench& bench, const options_t& opts, const inputs_t& in)
+{
+    if (!bench.enabled("ingest")) {
+        return;
+    }
+    Authenticator acca(in.sk);
+    Authenticator::dpk_t dpk = acca.getDpk();
+    const size_t n = opts.warmup + opts.reps;
+    vector<Authenticator::ct_t> cts(n);
+    vector<ChameleonHash::digest_t> ds(n);
+    vector<Wire::bytes_t> encs(n);
+    mt19937_64 gen(2);
+    for (size_t i = 0; i < n; i++) {
+        Authenticator::token_t t;
+        generate(cts[i].begin(), cts[i].end(), [&]() { return gen() & 0xff; });
+        acca.authenticate(t, cts[i], in.sts[i % INPUTS]);
+        ChameleonHash::digest(ds[i], in.sts[i % INPUTS]);
+        encs[i] = Wire::encodeToken(t);
+    }
+
+    const string dir = "/tmp/accabench-store-" + to_string(getpid());
+    {
+        KeyRegistry verifiers(KeyRegistry::ENTRY_SIZE);
+        EquivocationStore store(dir, n, verifiers);
+        Authenticator::dsk_t dsk;
+        bench.run("ingest", Authenticator::CT_LEN, 1, [&](size_t i) {
+            if (store.ingest(dsk, dpk, cts[i], ds[i], TokenView(encs[i].data(), encs[i].size()))) {
+                throw runtime_error("unexpected equivocation");
+            }
+        });
+    }
+    for (const char* file : {"/log", "/index", "/bloom"}) {
+        unlink((dir + file).c_str());
+    }
+    rmdir(dir.c_str());
+}
+
+void usage(const char* name)
+{
+    cerr << "Usage: " << name << " [--warmup N] [--reps N] [--threads N] [--perf] [--filter NAME] [--out FILE]" << endl
+         << "Writes the results as JSON to FILE or stdout. --threads is the maximum number" << endl
+         << "of threads for the scaling benchmarks, --filter selects benchmarks by name." << endl;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    options_t opts;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--warmup" && hasValue) {
+            opts.warmup = strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "--reps" && hasValue) {
+            opts.reps = strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "--threads" && hasValue) {
+            opts.maxThreads = strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "--filter" && hasValue) {
+            opts.filter = argv[++i];
+        } else if (arg == "--out" && hasValue) {
+            opts.out = argv[++i];
+        } else if (arg == "--perf") {
+            opts.perf = true;
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (opts.reps == 0 || opts.maxThreads == 0) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    if (opts.perf && !PerfCounters().available()) {
+        cerr << "perf_event_open failed, not counting cycles and instructions" << endl;
+        opts.perf = false;
+    }
+
+    ofstream file;
+    if (!opts.out.empty()) {
+        file.open(opts.out);
+        if (!file) {
+            cerr << "Cannot open " << opts.out << endl;
+            return 1;
+        }
+    }
+    ostream& out = opts.out.empty() ? cout : file;
+
+    try {
+        inputs_t in;
+        Report report(out, opts);
+        Bench bench(opts, report);
+        benchPrimitives(bench, in);
+#define BENCH(n) benchAuthenticator<n>(bench, in);
+        ACCA_FOR_EACH_CT_LEN(BENCH)
+#undef BENCH
+        benchScaling(bench, report, opts, in);
+        benchStore(bench, opts, in);
+        report.finish();
+    } catch (const exception& e) {
+        cerr << "Error: " << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,165 @@
+/*
+ * Copyright (c) 2015 Tim Ruffing <tim.ruffing@mmci.uni-saarland.de>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+// Assertion service daemon. Holds the secret keys given on the command line and
+// serves authenticate, verify and extract requests on a Unix domain socket, see
+// AssertionProtocol in assertionservice.h. The EC tables are initialized once, and
+// verifiers for the public keys seen in requests are cached in a KeyRegistry. Issued
+// tokens are recorded in an EquivocationStore, which must be kept across restarts.
+//
+// SIGUSR1 writes the latency histograms as JSON to stderr, SIGINT and SIGTERM stop
+// the daemon.
+
+#include "../assertionservice.h"
+#include "../authenticator.h"
+#include "../equivocationstore.h"
+#include "../keyregistry.h"
+#include "../treecache.h"
+
+#include <cctype>
+#include <csignal>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <pthread.h>
+
+using namespace std;
+
+namespace {
+
+bool parseHex(Authenticator::dsk_t& dsk, const string& s)
+{
+    string hex;
+    for (char c : s) {
+        if (!isspace(static_cast<unsigned char>(c))) {
+            hex.push_back(c);
+        }
+    }
+    if (hex.size() != 2 * dsk.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < dsk.size(); i++) {
+        string byte = hex.substr(2 * i, 2);
+        if (!isxdigit(static_cast<unsigned char>(byte[0])) || !isxdigit(static_cast<unsigned char>(byte[1]))) {
+            return false;
+        }
+        dsk[i] = strtoul(byte.c_str(), nullptr, 16);
+    }
+    return true;
+}
+
+void usage(const char* name)
+{
+    cerr << "Usage: " << name << " [--workers N] [--registry-mb N] [--issued DIR] SOCKET KEYFILE[:TREECACHE]..." << endl
+         << "Every KEYFILE contains a secret key as 64 hexadecimal digits, optionally followed" << endl
+         << "by a tree cache created with accaprecompute. Keys are numbered from 0 in the" << endl
+         << "order given. Issued tokens are recorded in DIR (default SOCKET.issued)." << endl;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    AssertionServer::config_t config;
+    size_t registryMb = 256;
+    string issuedDir;
+    vector<string> args;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--workers" && hasValue) {
+            config.workers = strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "--registry-mb" && hasValue) {
+            registryMb = strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "--issued" && hasValue) {
+            issuedDir = argv[++i];
+        } else if (arg.compare(0, 2, "--") == 0) {
+            usage(argv[0]);
+            return 2;
+        } else {
+            args.push_back(arg);
+        }
+    }
+    if (args.size() < 2) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    // handle signals synchronously in the main thread, the server threads inherit the mask
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    sigaddset(&signals, SIGUSR1);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+    try {
+        vector<shared_ptr<const Authenticator>> signers;
+        for (size_t i = 1; i < args.size(); i++) {
+            string keyPath = args[i], cachePath;
+            size_t colon = keyPath.find(':');
+            if (colon != string::npos) {
+                cachePath = keyPath.substr(colon + 1);
+                keyPath.resize(colon);
+            }
+            ifstream keyFile(keyPath);
+            Authenticator::dsk_t dsk;
+            if (!keyFile || !parseHex(dsk, string(istreambuf_iterator<char>(keyFile), istreambuf_iterator<char>()))) {
+                cerr << "Cannot read secret key from " << keyPath << endl;
+                return 1;
+            }
+            shared_ptr<Authenticator> signer = make_shared<Authenticator>(dsk);
+            if (!cachePath.empty()) {
+                signer->setTreeCache(make_shared<TreeCache>(cachePath));
+            }
+            signers.push_back(signer);
+        }
+
+        KeyRegistry verifiers(registryMb << 20);
+        EquivocationStore issued(issuedDir.empty() ? args[0] + ".issued" : issuedDir, 1 << 20, verifiers);
+        AssertionServer server(args[0], signers, verifiers, issued, config);
+        cerr << "Serving " << signers.size() << " keys on " << args[0] << endl;
+
+        for (;;) {
+            int sig;
+            sigwait(&signals, &sig);
+            if (sig != SIGUSR1) {
+                break;
+            }
+            cerr << server.getStatsJson() << endl;
+        }
+    } catch (const exception& e) {
+        cerr << "Error: " << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
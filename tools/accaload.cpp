@@ -0,0 +1,263 @@
+/*
+ * Copyright (c) 2015 Tim Ruffing <tim.ruffing@mmci.uni-saarland.de>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+// Load test for the assertion service. Opens a number of connections, each of which
+// keeps a fixed number of requests in flight, and reports throughput and the latency
+// distribution seen by the clients as JSON, together with the server-side histograms.
+//
+// Without --socket, an in-process server with a random key is started on a temporary
+// socket, so the test runs entirely on the local machine.
+
+#include "../assertionservice.h"
+#include "../authenticator.h"
+#include "../equivocationstore.h"
+#include "../keyregistry.h"
+#include "../latencyhistogram.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+struct options_t {
+    string socket;
+    string op = "verify";
+    unsigned connections = 4;
+    unsigned depth = 16;
+    size_t requests = 1000;
+    unsigned workers = 0;
+    uint16_t key = 0;
+};
+
+// the statements and tokens the requests are built from
+struct inputs_t {
+    Authenticator::dpk_t dpk;
+    vector<Authenticator::ct_t> cts;
+    vector<Authenticator::st_t> sts;
+    vector<Authenticator::token_t> ts;
+};
+
+AssertionProtocol::response_t call(AssertionClient& client, const AssertionProtocol::bytes_t& request)
+{
+    AssertionProtocol::response_t response;
+    client.send(request);
+    client.receive(response);
+    if (response.status != AssertionProtocol::OK) {
+        throw runtime_error("request failed with status " + to_string(response.status));
+    }
+    return response;
+}
+
+void prepare(inputs_t& in, const options_t& opts)
+{
+    AssertionClient client(opts.socket);
+    AssertionProtocol::response_t response = call(client, AssertionProtocol::getDpkRequest(0, opts.key));
+    Wire::decodeDpk(in.dpk, response.payload.data(), response.payload.size());
+
+    mt19937_64 gen(42);
+    uniform_int_distribution<> dis(0, 255);
+    for (size_t i = 0; i < 64; i++) {
+        Authenticator::ct_t ct;
+        Authenticator::st_t st(32);
+        for (auto& c : ct) {
+            c = dis(gen);
+        }
+        for (auto& c : st) {
+            c = dis(gen);
+        }
+        response = call(client, AssertionProtocol::authenticateRequest(i, opts.key, ct, st));
+        Authenticator::token_t t;
+        Wire::decodeToken(t, response.payload.data(), response.payload.size());
+        in.cts.push_back(ct);
+        in.sts.push_back(st);
+        in.ts.push_back(t);
+    }
+}
+
+AssertionProtocol::bytes_t request(const inputs_t& in, const options_t& opts, uint32_t id)
+{
+    size_t i = id % in.cts.size();
+    bool authenticate = opts.op == "authenticate" || (opts.op == "mixed" && id % 2);
+    if (authenticate) {
+        return AssertionProtocol::authenticateRequest(id, opts.key, in.cts[i], in.sts[i]);
+    }
+    return AssertionProtocol::verifyRequest(id, in.dpk, in.cts[i], in.ts[i], in.sts[i]);
+}
+
+void runConnection(const inputs_t& in, const options_t& opts, LatencyHistogram& latencies, size_t& failures)
+{
+    typedef chrono::steady_clock clock;
+    AssertionClient client(opts.socket);
+    vector<clock::time_point> sent(opts.requests);
+    AssertionProtocol::response_t response;
+    size_t next = 0;
+    for (size_t received = 0; received < opts.requests; received++) {
+        while (next < opts.requests && next < received + opts.depth) {
+            sent[next] = clock::now();
+            client.send(request(in, opts, next));
+            next++;
+        }
+        client.receive(response);
+        if (response.id >= opts.requests) {
+            throw runtime_error("unexpected response id");
+        }
+        latencies.record(chrono::duration_cast<chrono::nanoseconds>(clock::now() - sent[response.id]).count());
+        bool ok = response.status == AssertionProtocol::OK && (response.payload.size() != 1 || response.payload[0] == 1);
+        failures += !ok;
+    }
+}
+
+void usage(const char* name)
+{
+    cerr << "Usage: " << name << " [--socket PATH] [--key N] [--op verify|authenticate|mixed]" << endl
+         << "       [--connections N] [--depth N] [--requests N] [--workers N]" << endl
+         << "--requests is per connection, --depth is the number of requests in flight per" << endl
+         << "connection. Without --socket, a server with --workers workers is started in-process." << endl;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    options_t opts;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--socket" && hasValue) {
+            opts.socket = argv[++i];
+        } else if (arg == "--op" && hasValue) {
+            opts.op = argv[++i];
+        } else if (arg == "--key" && hasValue) {
+            opts.key = strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "--connections" && hasValue) {
+            opts.connections = strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "--depth" && hasValue) {
+            opts.depth = strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "--requests" && hasValue) {
+            opts.requests = strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "--workers" && hasValue) {
+            opts.workers = strtoul(argv[++i], nullptr, 10);
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (opts.connections == 0 || opts.depth == 0 || opts.requests == 0
+        || (opts.op != "verify" && opts.op != "authenticate" && opts.op != "mixed")) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    // the store of the in-process server, removed at exit
+    string issuedDir;
+    int result = 0;
+    try {
+        unique_ptr<KeyRegistry> verifiers;
+        unique_ptr<EquivocationStore> issued;
+        unique_ptr<AssertionServer> server;
+        if (opts.socket.empty()) {
+            random_device rd;
+            Authenticator::dsk_t dsk;
+            for (auto& c : dsk) {
+                c = rd();
+            }
+            opts.socket = "/tmp/accaload-" + to_string(getpid()) + ".sock";
+            opts.key = 0;
+            AssertionServer::config_t config;
+            config.workers = opts.workers;
+            verifiers.reset(new KeyRegistry(64 << 20));
+            issuedDir = "/tmp/accaload-" + to_string(getpid()) + ".issued";
+            issued.reset(new EquivocationStore(issuedDir, 1 << 16, *verifiers));
+            server.reset(new AssertionServer(opts.socket, { make_shared<Authenticator>(dsk) }, *verifiers, *issued, config));
+        }
+
+        inputs_t in;
+        prepare(in, opts);
+
+        LatencyHistogram latencies;
+        vector<size_t> failures(opts.connections, 0);
+        vector<thread> threads;
+        auto start = chrono::steady_clock::now();
+        for (unsigned c = 0; c < opts.connections; c++) {
+            threads.emplace_back([&, c] {
+                try {
+                    runConnection(in, opts, latencies, failures[c]);
+                } catch (const exception& e) {
+                    cerr << "Connection " << c << ": " << e.what() << endl;
+                    failures[c] = opts.requests;
+                }
+            });
+        }
+        for (auto& t : threads) {
+            t.join();
+        }
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        size_t total = opts.connections * opts.requests, failed = 0;
+        for (size_t f : failures) {
+            failed += f;
+        }
+        AssertionClient client(opts.socket);
+        AssertionProtocol::response_t stats = call(client, AssertionProtocol::statsRequest(0));
+
+        cout << "{\"op\": \"" << opts.op << "\", \"connections\": " << opts.connections
+             << ", \"depth\": " << opts.depth << ", \"requests\": " << total
+             << ", \"failures\": " << failed << ", \"seconds\": " << seconds
+             << ", \"per_second\": " << total / seconds
+             << ", \"p50_ns\": " << latencies.quantile(0.5)
+             << ", \"p90_ns\": " << latencies.quantile(0.9)
+             << ", \"p99_ns\": " << latencies.quantile(0.99)
+             << ", \"p999_ns\": " << latencies.quantile(0.999)
+             << ", \"max_ns\": " << latencies.max()
+             << ", \"server\": " << string(stats.payload.begin(), stats.payload.end()) << "}" << endl;
+        if (failed) {
+            cerr << failed << " requests failed" << endl;
+            result = 1;
+        }
+    } catch (const exception& e) {
+        cerr << "Error: " << e.what() << endl;
+        result = 1;
+    }
+    if (!issuedDir.empty()) {
+        for (const char* file : { "/log", "/index", "/bloom" }) {
+            remove((issuedDir + file).c_str());
+        }
+        remove(issuedDir.c_str());
+    }
+    return result;
+}
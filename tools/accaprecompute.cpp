@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2015 Tim Ruffing <tim.ruffing@mmci.uni-saarland.de>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+// Precomputes the top levels of the tree of a key into a file that can be
+// loaded with TreeCache and shared by all processes signing with the key.
+
+#include "../authenticator.h"
+#include "../treecache.h"
+
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <string>
+
+using namespace std;
+
+static bool parseHex(Authenticator::dsk_t& dsk, const string& s)
+{
+    string hex;
+    for (char c : s) {
+        if (!isspace(static_cast<unsigned char>(c))) {
+            hex.push_back(c);
+        }
+    }
+    if (hex.size() != 2 * dsk.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < dsk.size(); i++) {
+        string byte = hex.substr(2 * i, 2);
+        if (!isxdigit(static_cast<unsigned char>(byte[0])) || !isxdigit(static_cast<unsigned char>(byte[1]))) {
+            return false;
+        }
+        dsk[i] = strtoul(byte.c_str(), nullptr, 16);
+    }
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 4 || argc > 5) {
+        cerr << "Usage: " << argv[0] << " KEYFILE LEVELS OUTFILE [THREADS]" << endl
+             << "KEYFILE contains the secret key as 64 hexadecimal digits." << endl;
+        return 2;
+    }
+
+    ifstream keyFile(argv[1]);
+    Authenticator::dsk_t dsk;
+    if (!keyFile || !parseHex(dsk, string(istreambuf_iterator<char>(keyFile), istreambuf_iterator<char>()))) {
+        cerr << "Cannot read secret key from " << argv[1] << endl;
+        return 1;
+    }
+    size_t levels = strtoul(argv[2], nullptr, 10);
+    unsigned threads = argc > 4 ? strtoul(argv[4], nullptr, 10) : 0;
+
+    try {
+        TreeCache::create(argv[3], dsk, levels, threads);
+        TreeCache cache(argv[3]);
+
+        cout << "Wrote " << cache.getLevels() << " levels to " << argv[3] << endl << "Root digest: ";
+        for (unsigned char c : cache.getRootDigest()) {
+            cout << hex << setw(2) << setfill('0') << (int) c;
+        }
+        cout << endl;
+    } catch (const exception& e) {
+        cerr << "Error: " << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,214 @@
+/*
+ * Copyright (c) 2015 Tim Ruffing <tim.ruffing@mmci.uni-saarland.de>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#include "treecache.h"
+#include "node.h"
+#include "prf.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+template<size_t CtLen>
+const unsigned char BasicTreeCache<CtLen>::MAGIC[8] = {'A', 'C', 'C', 'A', 'T', 'R', 'E', 'E'};
+
+static void writeUint32(unsigned char* out, uint32_t x)
+{
+    for (size_t i = 0; i < 4; i++) {
+        out[i] = (x >> (8 * (3 - i))) & 0xFF;
+    }
+}
+
+static uint32_t readUint32(const unsigned char* in)
+{
+    uint32_t x = 0;
+    for (size_t i = 0; i < 4; i++) {
+        x = (x << 8) | in[i];
+    }
+    return x;
+}
+
+template<size_t CtLen>
+BasicTreeCache<CtLen>::BasicTreeCache(const std::string& path) : file(MappedFile::openReadOnly(path))
+{
+    const unsigned char* header = file.data();
+    if (file.size() < HEADER_LEN || memcmp(header, MAGIC, sizeof MAGIC) != 0) {
+        throw std::invalid_argument("not a tree cache file");
+    }
+    if (readUint32(header + 8) != VERSION) {
+        throw std::invalid_argument("unsupported tree cache version");
+    }
+    if (readUint32(header + 12) != CtLen || readUint32(header + 20) != ChameleonHash::HASH_LEN) {
+        throw std::invalid_argument("tree cache was created for different parameters");
+    }
+    levels = readUint32(header + 16);
+    if (levels < 1 || levels >= BasicAuthenticator<CtLen>::DEPTH || levels > MAX_LEVELS) {
+        throw std::invalid_argument("invalid number of levels in tree cache");
+    }
+    if (file.size() != HEADER_LEN + entryIndex(levels + 1, 0) * ChameleonHash::HASH_LEN) {
+        throw std::invalid_argument("tree cache has wrong size");
+    }
+    std::copy(header + 24, header + 24 + rootDigest.size(), rootDigest.begin());
+
+    // check that the first level matches the root digest
+    ChameleonHash::hash_t left, right;
+    get(left, Node::leftChildOfRoot());
+    get(right, Node::fromPosition(1, 1));
+    ChameleonHash::digest_t digest;
+    ChameleonHash::digest(digest, left, right);
+    if (digest != rootDigest) {
+        throw std::invalid_argument("tree cache is inconsistent with its root digest");
+    }
+}
+
+template<size_t CtLen>
+void BasicTreeCache<CtLen>::create(const std::string& path, const typename BasicAuthenticator<CtLen>::dsk_t& dsk, size_t levels, unsigned threads)
+{
+    if (levels < 1 || levels >= BasicAuthenticator<CtLen>::DEPTH || levels > MAX_LEVELS) {
+        throw std::invalid_argument("invalid number of levels");
+    }
+    if (threads == 0) {
+        threads = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+
+    const size_t count = entryIndex(levels + 1, 0);
+    // Signers may have mapped the file at path, so it must not be truncated in place.
+    const std::string tmp = path + ".tmp";
+    MappedFile file = MappedFile::create(tmp, HEADER_LEN + count * ChameleonHash::HASH_LEN);
+    unsigned char* entries = file.data() + HEADER_LEN;
+
+    // Workers fetch chunks of consecutive entries. Each chunk is computed with
+    // a single call to the bulk chameleon hash evaluation.
+    const size_t CHUNK = 1024;
+    std::atomic<size_t> next(0);
+    std::exception_ptr error;
+    std::mutex errorMutex;
+
+    auto worker = [&]() {
+        try {
+            Prf prf(dsk, CtLen);
+            ChameleonHash ch(dsk);
+            std::vector<ChameleonHash::digest_t> xs(CHUNK);
+            std::vector<ChameleonHash::rand_t> rs(CHUNK);
+            std::vector<ChameleonHash::hash_t> hashes(CHUNK);
+
+            size_t begin;
+            while ((begin = next.fetch_add(CHUNK)) < count) {
+                size_t end = std::min(begin + CHUNK, count);
+                for (size_t i = begin; i < end; i++) {
+                    // entry i is on level l with 2^l - 2 <= i < 2^(l+1) - 2
+                    size_t level = 0;
+                    while (entryIndex(level + 1, 0) <= i) {
+                        level++;
+                    }
+                    Node node = Node::fromPosition(level, i - entryIndex(level, 0));
+                    prf.getXR(xs[i - begin], rs[i - begin], node);
+                }
+                ch.ch(hashes.data(), xs.data(), rs.data(), end - begin);
+                for (size_t i = begin; i < end; i++) {
+                    memcpy(entries + i * ChameleonHash::HASH_LEN, hashes[i - begin].data(), ChameleonHash::HASH_LEN);
+                }
+            }
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(errorMutex);
+            error = std::current_exception();
+            // make the other workers stop
+            next = count;
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (unsigned i = 0; i < threads; i++) {
+        pool.emplace_back(worker);
+    }
+    for (auto& t : pool) {
+        t.join();
+    }
+    if (error) {
+        std::remove(tmp.c_str());
+        std::rethrow_exception(error);
+    }
+
+    // The header is written last, so an interrupted run does not leave a valid file behind.
+    ChameleonHash::hash_t left, right;
+    std::copy(entries, entries + ChameleonHash::HASH_LEN, left.begin());
+    std::copy(entries + ChameleonHash::HASH_LEN, entries + 2 * ChameleonHash::HASH_LEN, right.begin());
+    ChameleonHash::digest_t rootDigest;
+    ChameleonHash::digest(rootDigest, left, right);
+
+    unsigned char* header = file.data();
+    memcpy(header, MAGIC, sizeof MAGIC);
+    writeUint32(header + 8, VERSION);
+    writeUint32(header + 12, CtLen);
+    writeUint32(header + 16, levels);
+    writeUint32(header + 20, ChameleonHash::HASH_LEN);
+    std::copy(rootDigest.begin(), rootDigest.end(), header + 24);
+    try {
+        file.sync();
+    } catch (...) {
+        std::remove(tmp.c_str());
+        throw;
+    }
+
+    if (std::rename(tmp.c_str(), path.c_str()) < 0) {
+        std::string what = std::string("cannot rename tree cache: ") + strerror(errno);
+        std::remove(tmp.c_str());
+        throw std::runtime_error(what);
+    }
+    // make the rename durable
+    size_t slash = path.rfind('/');
+    std::string dir = slash == std::string::npos ? "." : path.substr(0, slash + 1);
+    int fd = open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+    if (fd >= 0) {
+        fsync(fd);
+        close(fd);
+    }
+}
+
+template<size_t CtLen>
+void BasicTreeCache<CtLen>::get(ChameleonHash::hash_t& res, const Node& node) const
+{
+    size_t level = node.getLevel();
+    if (level < 1 || level > levels) {
+        throw std::out_of_range("node is not in tree cache");
+    }
+    const unsigned char* entry = file.data() + HEADER_LEN + entryIndex(level, node.getFromLeft()) * ChameleonHash::HASH_LEN;
+    std::copy(entry, entry + ChameleonHash::HASH_LEN, res.begin());
+}
+
+#define INSTANTIATE(n) template class BasicTreeCache<n>;
+ACCA_FOR_EACH_CT_LEN(INSTANTIATE)
+#undef INSTANTIATE
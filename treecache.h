@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2015 Tim Ruffing <tim.ruffing@mmci.uni-saarland.de>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#ifndef TREECACHE_H
+#define TREECACHE_H
+
+#include "authenticator.h"
+#include "mappedfile.h"
+
+#include <string>
+
+// The chameleon hashes of all nodes on the top levels of the tree of a key,
+// stored in a memory-mapped file. The hashes of the inner nodes do not depend
+// on any statement, so they can be precomputed once and shared by all
+// signing processes of the key.
+//
+// File format (all integers big-endian):
+//  - 64 byte header: magic "ACCATREE", version, CT_LEN, number of levels k,
+//    HASH_LEN (4 bytes each), the root digest of the key, 8 zero bytes
+//  - for each level l = 1, ..., k and each node on level l from left to right:
+//    the compressed chameleon hash of the node (HASH_LEN bytes)
+template<size_t CtLen>
+class BasicTreeCache
+{
+public:
+    typedef BasicNode<CtLen> Node;
+
+    static const unsigned char MAGIC[8];
+    static const uint32_t VERSION = 3;
+    static const size_t HEADER_LEN = 64;
+    static const size_t MAX_LEVELS = 40;
+
+    // Maps an existing file and checks its header. Only the first level is checked against
+    // the root digest: an entry on a lower level is linked to its children by a collision
+    // that is computed when signing, so it cannot be checked without the secret key. A
+    // corrupted entry thus goes unnoticed here, and the tokens that use it do not verify.
+    BasicTreeCache(const std::string& path);
+
+    // Precomputes the top levels of the tree of dsk and writes them to a new file at path,
+    // using the given number of threads (0 means one thread per core). The file is written
+    // to path + ".tmp" and then renamed to path, so processes that have mapped an existing
+    // file at path keep using the old file.
+    static void create(const std::string& path, const typename BasicAuthenticator<CtLen>::dsk_t& dsk, size_t levels, unsigned threads);
+
+    // Number of levels below the root stored in the file.
+    size_t getLevels() const {
+        return levels;
+    }
+    const ChameleonHash::digest_t& getRootDigest() const {
+        return rootDigest;
+    }
+
+    // Returns the chameleon hash of node, which must be on one of the levels 1, ..., getLevels().
+    void get(ChameleonHash::hash_t& res, const Node& node) const;
+
+private:
+    MappedFile file;
+    size_t levels;
+    ChameleonHash::digest_t rootDigest;
+
+    // Position of the entry for a node among all entries.
+    static size_t entryIndex(size_t level, uint64_t fromLeft) {
+        return ((size_t) 1 << level) - 2 + fromLeft;
+    }
+};
+
+typedef BasicTreeCache<ACCA_CT_LEN> TreeCache;
+
+#endif // TREECACHE_H
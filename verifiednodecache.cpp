@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2015 Tim Ruffing <tim.ruffing@mmci.uni-saarland.de>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#include "verifiednodecache.h"
+#include "sha256.h"
+
+template<size_t CtLen>
+BasicVerifiedNodeCache<CtLen>::BasicVerifiedNodeCache(const ChameleonHash::digest_t& rootDigest, size_t maxEntries)
+    : rootDigest(rootDigest), cache(maxEntries) { }
+
+template<size_t CtLen>
+bool BasicVerifiedNodeCache<CtLen>::contains(const token_t& t, size_t level, const Node& node, const ChameleonHash::digest_t& x)
+{
+    entry_t entry;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        entry_t* cached = cache.get(node);
+        if (!cached || cached->x != x) {
+            return false;
+        }
+        entry = *cached;
+    }
+
+    ChameleonHash::digest_t tail = {};
+    for (size_t i = DEPTH; i-- > level; ) {
+        tailStep(tail, t, i);
+    }
+    return tail == entry.tail;
+}
+
+template<size_t CtLen>
+void BasicVerifiedNodeCache<CtLen>::insert(const token_t& t, const ct_t& ct, const std::array<ChameleonHash::digest_t, DEPTH>& xs)
+{
+    std::array<entry_t, DEPTH> entries;
+    ChameleonHash::digest_t tail = {};
+    for (size_t i = DEPTH; i-- > 0; ) {
+        tailStep(tail, t, i);
+        entries[i].x = xs[i];
+        entries[i].tail = tail;
+    }
+
+    Node node(ct);
+    std::lock_guard<std::mutex> lock(mutex);
+    for (size_t i = 0; i < DEPTH; i++) {
+        cache.put(node, entries[i], 1);
+        node.moveToParent();
+    }
+}
+
+template<size_t CtLen>
+typename BasicVerifiedNodeCache<CtLen>::stats_t BasicVerifiedNodeCache<CtLen>::getStats()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return cache.getStats();
+}
+
+template<size_t CtLen>
+void BasicVerifiedNodeCache<CtLen>::tailStep(ChameleonHash::digest_t& tail, const token_t& t, size_t level)
+{
+    Sha256 hash;
+    hash.write(t.rs[level].data(), t.rs[level].size());
+    hash.write(t.chs[level].data(), t.chs[level].size());
+    hash.write(tail.data(), tail.size());
+    hash.finalize(tail.data());
+}
+
+#define INSTANTIATE(n) template class BasicVerifiedNodeCache<n>;
+ACCA_FOR_EACH_CT_LEN(INSTANTIATE)
+#undef INSTANTIATE
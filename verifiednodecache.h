@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2015 Tim Ruffing <tim.ruffing@mmci.uni-saarland.de>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#ifndef VERIFIEDNODECACHE_H
+#define VERIFIEDNODECACHE_H
+
+#include "authenticator.h"
+#include "lrucache.h"
+#include "node.h"
+
+#include <mutex>
+
+// Remembers the digests of nodes on the paths of tokens that have been verified
+// successfully. If verification of another token reaches such a node with the same
+// digest and the remaining part of the token is the same as in the verified token,
+// the token is valid and verification can stop early. Tokens for nearby contexts
+// share the whole upper part of their paths, so this saves most of the work.
+//
+// A cache belongs to a single key. This class is thread-safe.
+template<size_t CtLen>
+class BasicVerifiedNodeCache
+{
+public:
+    typedef LruCacheStats stats_t;
+    typedef BasicNode<CtLen> Node;
+    typedef typename BasicAuthenticator<CtLen>::token_t token_t;
+    typedef typename BasicAuthenticator<CtLen>::ct_t ct_t;
+    static const size_t DEPTH = BasicAuthenticator<CtLen>::DEPTH;
+
+    BasicVerifiedNodeCache(const ChameleonHash::digest_t& rootDigest, size_t maxEntries);
+
+    const ChameleonHash::digest_t& getRootDigest() const {
+        return rootDigest;
+    }
+
+    // Returns true if the token t is known to be valid from level on, where node is
+    // the node on that level (counted from the leaf) and x is its digest.
+    bool contains(const token_t& t, size_t level, const Node& node, const ChameleonHash::digest_t& x);
+
+    // Remembers the nodes on the path of the valid token t for context ct,
+    // where xs are the digests of the nodes on the path.
+    void insert(const token_t& t, const ct_t& ct, const std::array<ChameleonHash::digest_t, DEPTH>& xs);
+
+    stats_t getStats();
+
+private:
+    struct entry_t {
+        ChameleonHash::digest_t x;
+        // commitment to the part of the token from the level of the node on
+        ChameleonHash::digest_t tail;
+    };
+
+    ChameleonHash::digest_t rootDigest;
+    std::mutex mutex;
+    LruCache<Node, entry_t> cache;
+
+    // tail = H(t.rs[level] || t.chs[level] || tail'), where tail' is the tail of the next level
+    // and the tail above the top level consists of zeros
+    static void tailStep(ChameleonHash::digest_t& tail, const token_t& t, size_t level);
+};
+
+typedef BasicVerifiedNodeCache<ACCA_CT_LEN> VerifiedNodeCache;
+
+#endif // VERIFIEDNODECACHE_H
@@ -0,0 +1,319 @@
+/*
+ * Copyright (c) 2015 Tim Ruffing <tim.ruffing@mmci.uni-saarland.de>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#include "wire.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+template<size_t CtLen> const uint8_t BasicWire<CtLen>::VERSION;
+template<size_t CtLen> const size_t BasicWire<CtLen>::HEADER_LEN;
+template<size_t CtLen> const size_t BasicWire<CtLen>::PARITY_LEN;
+template<size_t CtLen> const size_t BasicWire<CtLen>::X_LEN;
+template<size_t CtLen> const size_t BasicWire<CtLen>::LEVEL_LEN;
+template<size_t CtLen> const size_t BasicWire<CtLen>::TOKEN_LEN;
+template<size_t CtLen> const size_t BasicWire<CtLen>::EXTENDED_LEVEL_LEN;
+template<size_t CtLen> const size_t BasicWire<CtLen>::EXTENDED_TOKEN_LEN;
+template<size_t CtLen> const size_t BasicWire<CtLen>::DPK_LEN;
+
+namespace {
+const char TOKEN_MAGIC[] = "ACTK";
+const char EXTENDED_TOKEN_MAGIC[] = "ACXT";
+const char DPK_MAGIC[] = "ACPK";
+const char MULTIPROOF_MAGIC[] = "ACMP";
+
+void putU32(unsigned char* out, uint32_t v)
+{
+    out[0] = v >> 24;
+    out[1] = v >> 16;
+    out[2] = v >> 8;
+    out[3] = v;
+}
+
+uint32_t getU32(const unsigned char* in)
+{
+    return ((uint32_t) in[0] << 24) | ((uint32_t) in[1] << 16) | ((uint32_t) in[2] << 8) | in[3];
+}
+}
+
+template<size_t CtLen>
+void BasicWire<CtLen>::writeHeader(unsigned char* out, const char* magic, size_t ctLen)
+{
+    if (ctLen == 0 || ctLen > 0xFF) {
+        throw std::invalid_argument("unsupported context length");
+    }
+    memcpy(out, magic, 4);
+    out[4] = VERSION;
+    out[5] = ctLen;
+    out[6] = 0;
+    out[7] = 0;
+}
+
+template<size_t CtLen>
+void BasicWire<CtLen>::checkHeader(const unsigned char* in, size_t len, const char* magic)
+{
+    if (len < HEADER_LEN || memcmp(in, magic, 4) != 0) {
+        throw std::invalid_argument("not an encoded token or key");
+    }
+    if (in[4] != VERSION) {
+        throw std::invalid_argument("unsupported encoding version");
+    }
+    if (in[6] != 0 || in[7] != 0) {
+        throw std::invalid_argument("malformed encoding");
+    }
+}
+
+template<size_t CtLen>
+void BasicWire<CtLen>::checkTokenHeader(const unsigned char* in, size_t len)
+{
+    checkHeader(in, len, TOKEN_MAGIC);
+    if (in[5] != CtLen) {
+        throw std::invalid_argument("encoding is for a different context length");
+    }
+}
+
+template<size_t CtLen>
+void BasicWire<CtLen>::encodeToken(unsigned char* out, const token_t& t)
+{
+    static_assert(DEPTH % 8 == 0, "depth must be a multiple of 8");
+    writeHeader(out, TOKEN_MAGIC, CtLen);
+    unsigned char* parity = out + HEADER_LEN;
+    std::fill_n(parity, PARITY_LEN, 0);
+    unsigned char* level = parity + PARITY_LEN;
+    for (size_t i = 0; i < DEPTH; i++) {
+        const ChameleonHash::hash_t& ch = t.chs[i];
+        if (ch[0] != 0x02 && ch[0] != 0x03) {
+            throw std::invalid_argument("sibling hash is not a compressed point");
+        }
+        parity[i / 8] |= (ch[0] & 1) << (i % 8);
+        level = std::copy(t.rs[i].begin(), t.rs[i].end(), level);
+        level = std::copy(ch.begin() + 1, ch.end(), level);
+    }
+}
+
+template<size_t CtLen>
+typename BasicWire<CtLen>::bytes_t BasicWire<CtLen>::encodeToken(const token_t& t)
+{
+    bytes_t res(TOKEN_LEN);
+    encodeToken(res.data(), t);
+    return res;
+}
+
+template<size_t CtLen>
+void BasicWire<CtLen>::decodeToken(token_t& t, const unsigned char* in, size_t len)
+{
+    BasicTokenView<CtLen>(in, len).toToken(t);
+}
+
+template<size_t CtLen>
+typename BasicWire<CtLen>::bytes_t BasicWire<CtLen>::encodeExtendedToken(const extended_token_t& t)
+{
+    bytes_t res(EXTENDED_TOKEN_LEN);
+    writeHeader(res.data(), EXTENDED_TOKEN_MAGIC, CtLen);
+    unsigned char* parity = res.data() + HEADER_LEN;
+    unsigned char* pathParity = parity + PARITY_LEN;
+    unsigned char* level = pathParity + PARITY_LEN;
+    for (size_t i = 0; i < DEPTH; i++) {
+        const ChameleonHash::hash_t& ch = t.token.chs[i];
+        const ChameleonHash::hash_t& pathCh = t.pathChs[i];
+        if (ch[0] != 0x02 && ch[0] != 0x03) {
+            throw std::invalid_argument("sibling hash is not a compressed point");
+        }
+        if (pathCh[0] != 0x02 && pathCh[0] != 0x03) {
+            throw std::invalid_argument("path hash is not a compressed point");
+        }
+        parity[i / 8] |= (ch[0] & 1) << (i % 8);
+        pathParity[i / 8] |= (pathCh[0] & 1) << (i % 8);
+        level = std::copy(t.token.rs[i].begin(), t.token.rs[i].end(), level);
+        level = std::copy(ch.begin() + 1, ch.end(), level);
+        level = std::copy(pathCh.begin() + 1, pathCh.end(), level);
+    }
+    return res;
+}
+
+template<size_t CtLen>
+void BasicWire<CtLen>::decodeExtendedToken(extended_token_t& t, const unsigned char* in, size_t len)
+{
+    checkHeader(in, len, EXTENDED_TOKEN_MAGIC);
+    if (in[5] != CtLen) {
+        throw std::invalid_argument("encoding is for a different context length");
+    }
+    if (len != EXTENDED_TOKEN_LEN) {
+        throw std::invalid_argument("malformed encoding");
+    }
+    const unsigned char* parity = in + HEADER_LEN;
+    const unsigned char* pathParity = parity + PARITY_LEN;
+    in = pathParity + PARITY_LEN;
+    for (size_t i = 0; i < DEPTH; i++) {
+        ChameleonHash::hash_t& ch = t.token.chs[i];
+        ChameleonHash::hash_t& pathCh = t.pathChs[i];
+        std::copy(in, in + ChameleonHash::RAND_LEN, t.token.rs[i].begin());
+        in += ChameleonHash::RAND_LEN;
+        ch[0] = 0x02 | ((parity[i / 8] >> (i % 8)) & 1);
+        std::copy(in, in + X_LEN, ch.begin() + 1);
+        in += X_LEN;
+        pathCh[0] = 0x02 | ((pathParity[i / 8] >> (i % 8)) & 1);
+        std::copy(in, in + X_LEN, pathCh.begin() + 1);
+        in += X_LEN;
+    }
+}
+
+template<size_t CtLen>
+typename BasicWire<CtLen>::bytes_t BasicWire<CtLen>::encodeDpk(const dpk_t& dpk)
+{
+    const ChameleonHash::pk_t& pk = dpk.chpk;
+    bytes_t res(DPK_LEN);
+    writeHeader(res.data(), DPK_MAGIC, dpk.ctLen);
+    unsigned char* out = res.data() + HEADER_LEN;
+    if (pk.size() == 33 && (pk[0] == 0x02 || pk[0] == 0x03)) {
+        std::copy(pk.begin(), pk.end(), out);
+    } else if (pk.size() == 65 && pk[0] == 0x04) {
+        // the parity of y is the lowest bit of its last byte
+        out[0] = 0x02 | (pk[64] & 1);
+        std::copy(pk.begin() + 1, pk.begin() + 33, out + 1);
+    } else {
+        throw std::invalid_argument("malformed public key");
+    }
+    std::copy(dpk.rootDigest.begin(), dpk.rootDigest.end(), out + ChameleonHash::HASH_LEN);
+    return res;
+}
+
+template<size_t CtLen>
+void BasicWire<CtLen>::decodeDpk(dpk_t& dpk, const unsigned char* in, size_t len)
+{
+    checkHeader(in, len, DPK_MAGIC);
+    if (in[5] == 0 || len != DPK_LEN) {
+        throw std::invalid_argument("malformed encoding");
+    }
+    dpk.ctLen = in[5];
+    in += HEADER_LEN;
+    if (in[0] != 0x02 && in[0] != 0x03) {
+        throw std::invalid_argument("malformed public key");
+    }
+    dpk.chpk.assign(in, in + ChameleonHash::HASH_LEN);
+    in += ChameleonHash::HASH_LEN;
+    std::copy(in, in + ChameleonHash::MESG_LEN, dpk.rootDigest.begin());
+}
+
+template<size_t CtLen>
+typename BasicWire<CtLen>::bytes_t BasicWire<CtLen>::encodeMultiProof(const multiproof_t& proof)
+{
+    const size_t nrs = proof.rs.size(), nchs = proof.chs.size();
+    if (nrs > UINT32_MAX || nchs > UINT32_MAX) {
+        throw std::invalid_argument("multiproof too large");
+    }
+    bytes_t res(HEADER_LEN + 8 + (nchs + 7) / 8 + nrs * ChameleonHash::RAND_LEN + nchs * X_LEN);
+    writeHeader(res.data(), MULTIPROOF_MAGIC, CtLen);
+    putU32(res.data() + HEADER_LEN, nrs);
+    putU32(res.data() + HEADER_LEN + 4, nchs);
+    unsigned char* parity = res.data() + HEADER_LEN + 8;
+    unsigned char* out = parity + (nchs + 7) / 8;
+    for (const ChameleonHash::rand_t& r : proof.rs) {
+        out = std::copy(r.begin(), r.end(), out);
+    }
+    for (size_t i = 0; i < nchs; i++) {
+        const ChameleonHash::hash_t& ch = proof.chs[i];
+        if (ch[0] != 0x02 && ch[0] != 0x03) {
+            throw std::invalid_argument("sibling hash is not a compressed point");
+        }
+        parity[i / 8] |= (ch[0] & 1) << (i % 8);
+        out = std::copy(ch.begin() + 1, ch.end(), out);
+    }
+    return res;
+}
+
+template<size_t CtLen>
+void BasicWire<CtLen>::decodeMultiProof(multiproof_t& proof, const unsigned char* in, size_t len)
+{
+    checkHeader(in, len, MULTIPROOF_MAGIC);
+    if (in[5] != CtLen) {
+        throw std::invalid_argument("encoding is for a different context length");
+    }
+    if (len < HEADER_LEN + 8) {
+        throw std::invalid_argument("malformed encoding");
+    }
+    // 64-bit arithmetic avoids overflows for any count
+    const uint64_t nrs = getU32(in + HEADER_LEN), nchs = getU32(in + HEADER_LEN + 4);
+    if (len != HEADER_LEN + 8 + (nchs + 7) / 8 + nrs * ChameleonHash::RAND_LEN + nchs * X_LEN) {
+        throw std::invalid_argument("malformed encoding");
+    }
+    const unsigned char* parity = in + HEADER_LEN + 8;
+    in = parity + (nchs + 7) / 8;
+    proof.rs.resize(nrs);
+    for (ChameleonHash::rand_t& r : proof.rs) {
+        std::copy(in, in + ChameleonHash::RAND_LEN, r.begin());
+        in += ChameleonHash::RAND_LEN;
+    }
+    proof.chs.resize(nchs);
+    for (size_t i = 0; i < nchs; i++) {
+        ChameleonHash::hash_t& ch = proof.chs[i];
+        ch[0] = 0x02 | ((parity[i / 8] >> (i % 8)) & 1);
+        std::copy(in, in + X_LEN, ch.begin() + 1);
+        in += X_LEN;
+    }
+}
+
+template<size_t CtLen>
+BasicTokenView<CtLen>::BasicTokenView(const unsigned char* data, size_t len) : bytes(data)
+{
+    BasicWire<CtLen>::checkTokenHeader(data, len);
+    if (len != BasicWire<CtLen>::TOKEN_LEN) {
+        throw std::invalid_argument("malformed encoding");
+    }
+}
+
+template<size_t CtLen>
+void BasicTokenView<CtLen>::getR(ChameleonHash::rand_t& r, size_t level) const
+{
+    const unsigned char* in = bytes + BasicWire<CtLen>::HEADER_LEN + BasicWire<CtLen>::PARITY_LEN + level * BasicWire<CtLen>::LEVEL_LEN;
+    std::copy(in, in + ChameleonHash::RAND_LEN, r.begin());
+}
+
+template<size_t CtLen>
+void BasicTokenView<CtLen>::getCh(ChameleonHash::hash_t& ch, size_t level) const
+{
+    const unsigned char* parity = bytes + BasicWire<CtLen>::HEADER_LEN;
+    const unsigned char* in = parity + BasicWire<CtLen>::PARITY_LEN + level * BasicWire<CtLen>::LEVEL_LEN + ChameleonHash::RAND_LEN;
+    ch[0] = 0x02 | ((parity[level / 8] >> (level % 8)) & 1);
+    std::copy(in, in + BasicWire<CtLen>::X_LEN, ch.begin() + 1);
+}
+
+template<size_t CtLen>
+void BasicTokenView<CtLen>::toToken(token_t& t) const
+{
+    for (size_t i = 0; i < BasicAuthenticator<CtLen>::DEPTH; i++) {
+        getR(t.rs[i], i);
+        getCh(t.chs[i], i);
+    }
+}
+
+#define INSTANTIATE(n) \
+    template class BasicWire<n>; \
+    template class BasicTokenView<n>;
+ACCA_FOR_EACH_CT_LEN(INSTANTIATE)
+#undef INSTANTIATE
@@ -0,0 +1,136 @@
+/*
+ * Copyright (c) 2015 Tim Ruffing <tim.ruffing@mmci.uni-saarland.de>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#ifndef WIRE_H
+#define WIRE_H
+
+#include "authenticator.h"
+#include "multiproof.h"
+
+#include <cstdint>
+
+// Canonical binary encoding of tokens and public keys.
+//
+// Token, version 1:
+//  - 8 byte header: magic "ACTK", version, CT_LEN, two zero bytes,
+//  - DEPTH/8 bytes: the parities of the sibling hashes as bit vector, where bit i
+//    (bit i % 8 of byte i / 8) is set iff chs[i] starts with 0x03,
+//  - for every level i = 0, ..., DEPTH-1: rs[i] followed by the x coordinate of chs[i].
+// The levels are interleaved, so verification reads the buffer front to back.
+//
+// Extended token, version 1:
+//  - 8 byte header: magic "ACXT", version, CT_LEN, two zero bytes,
+//  - the parities of the sibling hashes as in a token, then the ones of the path hashes,
+//  - for every level i: rs[i] followed by the x coordinates of chs[i] and pathChs[i].
+//
+// Public key, version 1:
+//  - 8 byte header: magic "ACPK", version, ctLen of the key, two zero bytes,
+//  - the compressed chameleon hash key (33 bytes),
+//  - rootDigest (32 bytes).
+// Keys are encoded in the same way for all context lengths.
+//
+// Multiproof, version 1:
+//  - 8 byte header: magic "ACMP", version, CT_LEN, two zero bytes,
+//  - the number of rs and the number of chs, 4 bytes each (big-endian),
+//  - the parities of the chs as bit vector as in a token,
+//  - the rs, followed by the x coordinates of the chs.
+template<size_t CtLen>
+class BasicWire
+{
+public:
+    typedef typename BasicAuthenticator<CtLen>::token_t token_t;
+    typedef typename BasicAuthenticator<CtLen>::extended_token_t extended_token_t;
+    typedef typename BasicAuthenticator<CtLen>::dpk_t dpk_t;
+    typedef BasicMultiProof<CtLen> multiproof_t;
+    static const size_t DEPTH = BasicAuthenticator<CtLen>::DEPTH;
+
+    static const uint8_t VERSION = 1;
+    static const size_t HEADER_LEN = 8;
+    static const size_t PARITY_LEN = DEPTH / 8;
+    static const size_t X_LEN = ChameleonHash::HASH_LEN - 1;
+    static const size_t LEVEL_LEN = ChameleonHash::RAND_LEN + X_LEN;
+    static const size_t TOKEN_LEN = HEADER_LEN + PARITY_LEN + DEPTH * LEVEL_LEN;
+    static const size_t EXTENDED_LEVEL_LEN = LEVEL_LEN + X_LEN;
+    static const size_t EXTENDED_TOKEN_LEN = HEADER_LEN + 2 * PARITY_LEN + DEPTH * EXTENDED_LEVEL_LEN;
+    static const size_t DPK_LEN = HEADER_LEN + ChameleonHash::HASH_LEN + ChameleonHash::MESG_LEN;
+
+    typedef std::vector<unsigned char> bytes_t;
+
+    // out must have room for TOKEN_LEN bytes.
+    static void encodeToken(unsigned char* out, const token_t& t);
+    static bytes_t encodeToken(const token_t& t);
+    // The decode functions throw std::invalid_argument if the input is not a valid encoding.
+    static void decodeToken(token_t& t, const unsigned char* in, size_t len);
+
+    static bytes_t encodeExtendedToken(const extended_token_t& t);
+    static void decodeExtendedToken(extended_token_t& t, const unsigned char* in, size_t len);
+
+    // Uncompressed keys are encoded in compressed form.
+    static bytes_t encodeDpk(const dpk_t& dpk);
+    static void decodeDpk(dpk_t& dpk, const unsigned char* in, size_t len);
+
+    static bytes_t encodeMultiProof(const multiproof_t& proof);
+    static void decodeMultiProof(multiproof_t& proof, const unsigned char* in, size_t len);
+    // Checks the header of an encoded token for contexts of CtLen bytes, but not its length.
+    static void checkTokenHeader(const unsigned char* in, size_t len);
+
+private:
+    // Checks everything but the context length and the total length.
+    static void checkHeader(const unsigned char* in, size_t len, const char* magic);
+    static void writeHeader(unsigned char* out, const char* magic, size_t ctLen);
+};
+
+typedef BasicWire<ACCA_CT_LEN> Wire;
+
+// Read-only view of an encoded token in a buffer owned by someone else, e.g.,
+// a network buffer or a MappedFile. Authenticator can verify and extract from
+// views directly, without copying the whole token into a token_t.
+template<size_t CtLen>
+class BasicTokenView
+{
+public:
+    typedef typename BasicAuthenticator<CtLen>::token_t token_t;
+
+    // The buffer must outlive the view. Throws std::invalid_argument if the buffer
+    // does not hold a valid encoding of a token for contexts of CtLen bytes.
+    BasicTokenView(const unsigned char* data, size_t len);
+
+    void getR(ChameleonHash::rand_t& r, size_t level) const;
+    void getCh(ChameleonHash::hash_t& ch, size_t level) const;
+    void toToken(token_t& t) const;
+
+    const unsigned char* data() const {
+        return bytes;
+    }
+
+private:
+    const unsigned char* bytes;
+};
+
+typedef BasicTokenView<ACCA_CT_LEN> TokenView;
+
+#endif // WIRE_H
@@ -0,0 +1,180 @@
+/*
+ * Copyright (c) 2015 Tim Ruffing <tim.ruffing@mmci.uni-saarland.de>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#include "workstealingpool.h"
+
+#include <algorithm>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+WorkStealingPool::WorkStealingPool(unsigned threads) : WorkStealingPool(threads, false) { }
+
+WorkStealingPool::WorkStealingPool(unsigned threads, bool pinThreads) : job(nullptr), generation(0), busy(0), stopping(false)
+{
+    if (threads == 0) {
+        threads = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+    for (unsigned i = 0; i < threads; i++) {
+        ranges.emplace_back(new range_t());
+    }
+    for (unsigned i = 0; i < threads; i++) {
+        workers.emplace_back(&WorkStealingPool::workerLoop, this, i);
+    }
+
+#ifdef __linux__
+    if (pinThreads) {
+        unsigned cores = std::max(std::thread::hardware_concurrency(), 1u);
+        for (unsigned i = 0; i < threads; i++) {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(i % cores, &set);
+            // pinning is an optimization, so we ignore errors
+            pthread_setaffinity_np(workers[i].native_handle(), sizeof set, &set);
+        }
+    }
+#endif
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wakeup.notify_all();
+    for (auto& t : workers) {
+        t.join();
+    }
+}
+
+void WorkStealingPool::parallelFor(size_t n, const std::function<void(size_t)>& f)
+{
+    std::lock_guard<std::mutex> jobLock(jobMutex);
+
+    // distribute the iterations evenly
+    size_t threads = workers.size();
+    for (size_t id = 0; id < threads; id++) {
+        std::lock_guard<std::mutex> lock(ranges[id]->mutex);
+        ranges[id]->begin = n * id / threads;
+        ranges[id]->end = n * (id + 1) / threads;
+    }
+
+    std::exception_ptr e;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        job = &f;
+        error = nullptr;
+        busy = threads;
+        generation++;
+        wakeup.notify_all();
+        finished.wait(lock, [this]() { return busy == 0; });
+        job = nullptr;
+        e = error;
+    }
+    if (e) {
+        std::rethrow_exception(e);
+    }
+}
+
+void WorkStealingPool::workerLoop(unsigned id)
+{
+    unsigned long seen = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wakeup.wait(lock, [&]() { return stopping || generation != seen; });
+            if (stopping) {
+                return;
+            }
+            seen = generation;
+        }
+
+        work(id);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--busy == 0) {
+            finished.notify_one();
+        }
+    }
+}
+
+void WorkStealingPool::work(unsigned id)
+{
+    const std::function<void(size_t)>& f = *job;
+    size_t i;
+    do {
+        while (pop(id, i)) {
+            try {
+                f(i);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!error) {
+                    error = std::current_exception();
+                }
+            }
+        }
+    } while (steal(id));
+}
+
+bool WorkStealingPool::pop(unsigned id, size_t& i)
+{
+    range_t& own = *ranges[id];
+    std::lock_guard<std::mutex> lock(own.mutex);
+    if (own.begin == own.end) {
+        return false;
+    }
+    i = own.begin++;
+    return true;
+}
+
+bool WorkStealingPool::steal(unsigned id)
+{
+    size_t threads = ranges.size();
+    for (size_t k = 1; k < threads; k++) {
+        range_t& victim = *ranges[(id + k) % threads];
+        size_t begin, end;
+        {
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (victim.begin == victim.end) {
+                continue;
+            }
+            // take the upper half, rounded up
+            end = victim.end;
+            begin = victim.begin + (victim.end - victim.begin) / 2;
+            victim.end = begin;
+        }
+        range_t& own = *ranges[id];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        own.begin = begin;
+        own.end = end;
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2015 Tim Ruffing <tim.ruffing@mmci.uni-saarland.de>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#ifndef WORKSTEALINGPOOL_H
+#define WORKSTEALINGPOOL_H
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed set of worker threads that process the iterations of a loop.
+// Each worker starts with an equal share of the iterations. Workers that run
+// out of work steal half of the remaining iterations of another worker,
+// so uneven running times of iterations are balanced automatically.
+class WorkStealingPool
+{
+public:
+    // Starts the given number of threads (0 means one thread per core).
+    WorkStealingPool(unsigned threads);
+    // If pinThreads is set, thread i is bound to core i (modulo the number of cores),
+    // which avoids migrations in latency-sensitive use. Pinning is only supported on Linux.
+    WorkStealingPool(unsigned threads, bool pinThreads);
+    ~WorkStealingPool();
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    unsigned size() const {
+        return workers.size();
+    }
+
+    // Calls f(i) for all i in [0, n) and waits until all calls have returned.
+    // If some calls throw, one of the exceptions is rethrown after all other calls have
+    // completed. Concurrent calls of parallelFor are serialized.
+    void parallelFor(size_t n, const std::function<void(size_t)>& f);
+
+private:
+    // the iterations [begin, end) not yet started by a worker
+    struct range_t {
+        std::mutex mutex;
+        size_t begin;
+        size_t end;
+    };
+
+    std::vector<std::thread> workers;
+    std::vector<std::unique_ptr<range_t>> ranges;
+
+    // serializes calls of parallelFor
+    std::mutex jobMutex;
+
+    // protects the following members
+    std::mutex mutex;
+    std::condition_variable wakeup;
+    std::condition_variable finished;
+    const std::function<void(size_t)>* job;
+    unsigned long generation;
+    unsigned busy;
+    bool stopping;
+    std::exception_ptr error;
+
+    void workerLoop(unsigned id);
+    void work(unsigned id);
+    bool pop(unsigned id, size_t& i);
+    bool steal(unsigned id);
+};
+
+#endif // WORKSTEALINGPOOL_H